@@ -0,0 +1,42 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "batch.hpp"
+
+// 64 copies of the invaders boot for 100k cycles each, about 880k machine steps in total
+TEST_CASE("Batch against scalar instances") {
+    constexpr size_t LANES = 64;
+    constexpr uint64_t CYCLES = 100'000;
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+
+    // Both sides copy the machines inside the measurement
+    const std::vector<Cpu> machines(LANES, boot);
+    BENCHMARK_ADVANCED("64 scalar Cpus")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            std::vector<Cpu> cpus = machines;
+            uint64_t steps = 0;
+            for (Cpu& cpu : cpus) {
+                while (cpu.getCycles() < CYCLES) {
+                    cpu.decode();
+                    steps++;
+                }
+            }
+            return steps;
+        });
+    };
+
+    for (batch::Isa isa : {batch::Isa::SCALAR, batch::Isa::SSE, batch::Isa::AVX2}) {
+        if (!Batch::available(isa)) {
+            continue;
+        }
+        const char* names[] = {"batch, scalar kernels", "batch, SSE kernels", "batch, AVX2 kernels"};
+        BENCHMARK_ADVANCED(names[int(isa)])(Catch::Benchmark::Chronometer meter) {
+            meter.measure([&] {
+                Batch batch(machines, isa);
+                batch.run(CYCLES);
+                return batch.getStats().lockstepSteps;
+            });
+        };
+    }
+}
@@ -0,0 +1,92 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+
+extern const recompiled::Rom recompiledInvaders; // generated at build time, see tools/CMakeLists.txt
+
+// Every run starts from a freshly loaded invaders ROM and executes this many instructions of its boot code,
+// which stays clear of the I/O ports the core does not implement yet.
+constexpr uint64_t INSTRUCTIONS = 30'000;
+
+TEST_CASE("Dispatch engines") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+
+    BENCHMARK_ADVANCED("switch, 30k instructions")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            uint64_t cycles = 0;
+            for (uint64_t i = 0; i < INSTRUCTIONS; i++) {
+                cycles += cpu.decodeSwitch();
+            }
+            return cycles;
+        });
+    };
+
+    BENCHMARK_ADVANCED("table, 30k instructions")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            uint64_t cycles = 0;
+            for (uint64_t i = 0; i < INSTRUCTIONS; i++) {
+                cycles += cpu.decodeTable();
+            }
+            return cycles;
+        });
+    };
+
+    BENCHMARK_ADVANCED("threaded, 30k instructions")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            return cpu.decodeThreaded(INSTRUCTIONS);
+        });
+    };
+
+    BENCHMARK_ADVANCED("run, 60k cycles")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            return cpu.run(60'000);
+        });
+    };
+
+    // The block cache and the JIT start cold, so these include translating the boot code
+    BENCHMARK_ADVANCED("table, 200k cycles")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            uint64_t cycles = 0;
+            while (cycles < 200'000) {
+                cycles += cpu.decodeTable();
+            }
+            return cycles;
+        });
+    };
+
+    BENCHMARK_ADVANCED("blocks, 200k cycles")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            uint64_t cycles = 0;
+            while (cycles < 200'000) {
+                cycles += cpu.decodeBlock();
+            }
+            return cycles;
+        });
+    };
+
+    BENCHMARK_ADVANCED("jit, 200k cycles")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            uint64_t cycles = 0;
+            while (cycles < 200'000) {
+                cycles += cpu.decodeJit();
+            }
+            return cycles;
+        });
+    };
+
+    BENCHMARK_ADVANCED("recompiled, 200k cycles")(Catch::Benchmark::Chronometer meter) {
+        meter.measure([&] {
+            Cpu cpu = boot;
+            return cpu.runRecompiled(recompiledInvaders, 200'000);
+        });
+    };
+}
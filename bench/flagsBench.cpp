@@ -0,0 +1,136 @@
+#include <bit>
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "state.hpp"
+
+// The branchy flag code the lookup tables replaced, to compare against.
+// Out of line like it was in state.cpp, the table path inlines into the opcode handlers.
+class BranchyRegisters : public Registers {
+    public:
+        [[gnu::noinline]] void setFlags(uint16_t result, bool enableZero = 1, bool enableSign = 1, bool enableParity = 1, bool enableCarry = 1) {
+            if ((uint8_t)result == 0x0 && enableZero) {
+                F |= 0b01000000;
+            } else {
+                F &= ~0b01000000;
+            }
+            if ((result & 0b10000000) && enableSign) {
+                F |= 0b10000000;
+            } else {
+                F &= ~0b10000000;
+            }
+            if (std::popcount((uint8_t)result) % 2 == 0 && enableParity) {
+                F |= 0b00000100;
+            } else {
+                F &= ~0b00000100;
+            }
+            if (result > UINT8_MAX && enableCarry) {
+                F |= 0b00000001;
+            } else {
+                F &= ~0b00000001;
+            }
+        }
+
+        [[gnu::noinline]] void setFlagsADD(uint16_t result, uint8_t a, uint8_t b, bool carry = 0) {
+            setFlags(result);
+            if (((a & 0x0F) + (b & 0x0F) + 0b1*carry) > 0xF) {
+                F |= 0b00010000;
+            } else {
+                F &= ~0b00010000;
+            }
+        }
+
+        [[gnu::noinline]] void setFlagsSUB(uint16_t result, uint8_t a, uint8_t b, bool borrow = 0) {
+            setFlags(result);
+            if ((a & 0x0F) < ((b & 0x0F) + 0b1 * borrow)) {
+                F |= 0b00010000;
+            } else {
+                F &= ~0b00010000;
+            }
+        }
+
+        uint8_t getF() { return F; }
+};
+
+// The table path, reading F in place like the branchy one
+class TableRegisters : public Registers {
+    public:
+        uint8_t getF() { resolveFlags(0xFF); return F; }
+};
+
+// Every benchmark goes over all 256x256 operand pairs and sums F, so the flags can't be optimized away
+TEST_CASE("Flag computation") {
+    TableRegisters table;
+    BranchyRegisters branchy;
+
+    BENCHMARK("ADD, table") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                table.setFlagsADD(a + b, a, b);
+                sum += table.getF();
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("ADD, branchy") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                branchy.setFlagsADD(a + b, a, b);
+                sum += branchy.getF();
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("SUB, table") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                table.setFlagsSUB((uint16_t)(a - b), a, b);
+                sum += table.getF();
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("SUB, branchy") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                branchy.setFlagsSUB((uint16_t)(a - b), a, b);
+                sum += branchy.getF();
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("ANA, table") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                table.setFlagsLogic(a & b, (a | b) & 0b00001000);
+                sum += table.getF();
+            }
+        }
+        return sum;
+    };
+
+    BENCHMARK("ANA, branchy") {
+        uint32_t sum = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                branchy.setFlags(a & b, 1, 1, 1, 0);
+                if ((a | b) & 0b00001000) {
+                    branchy.setAuxCarry();
+                } else {
+                    branchy.clearAuxCarry();
+                }
+                sum += branchy.getF();
+            }
+        }
+        return sum;
+    };
+}
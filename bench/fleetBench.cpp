@@ -0,0 +1,22 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <algorithm>
+#include <thread>
+
+#include "fleet.hpp"
+
+// Four frames of the invaders boot on each of 32 instances, the time should drop with every core added
+TEST_CASE("Fleet scaling") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+
+    for (unsigned workers = 1; workers <= std::max(1u, std::thread::hardware_concurrency()); workers *= 2) {
+        BENCHMARK_ADVANCED("32 instances, " + std::to_string(workers) + " workers")(Catch::Benchmark::Chronometer meter) {
+            meter.measure([&] {
+                Fleet fleet(boot, 32);
+                fleet.run(4, workers);
+                return fleet.emulatedMHz();
+            });
+        };
+    }
+}
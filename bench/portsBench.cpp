@@ -0,0 +1,69 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+
+namespace {
+    // The same shift register behind a vtable, what the bus avoids
+    struct Device {
+        virtual ~Device() = default;
+        virtual uint8_t read(uint8_t port) = 0;
+        virtual void write(uint8_t port, uint8_t value) = 0;
+    };
+
+    struct VirtualShifter : Device {
+        invaders::Shifter shifter;
+        uint8_t read(uint8_t port) override { return shifter.read(port); }
+        void write(uint8_t port, uint8_t value) override { shifter.write(port, value); }
+    };
+
+    // What the invaders sprite code does per byte: shift in, set the offset, read the result
+    template<typename Write, typename Read> uint32_t shiftBytes(Write write, Read read) {
+        uint32_t sum = 0;
+        for (uint32_t i = 0; i < 1000; i++) {
+            write(invaders::SHIFT_DATA, i);
+            write(invaders::SHIFT_OFFSET, i);
+            sum += read(invaders::SHIFT_RESULT);
+        }
+        return sum;
+    }
+}
+
+TEST_CASE("Shift register access") {
+    invaders::Shifter shifter;
+    Ports ports;
+    shifter.attach(ports);
+    VirtualShifter concrete;
+    Device* volatile device = &concrete; // so the compiler cannot see through the vtable
+
+    BENCHMARK("1000 shifts, direct") {
+        return shiftBytes([&](uint8_t port, uint8_t value) { shifter.write(port, value); },
+                          [&](uint8_t port) { return shifter.read(port); });
+    };
+
+    BENCHMARK("1000 shifts, through the bus") {
+        return shiftBytes([&](uint8_t port, uint8_t value) { ports.out(port, value); },
+                          [&](uint8_t port) { return ports.in(port); });
+    };
+
+    BENCHMARK("1000 shifts, virtual") {
+        return shiftBytes([&](uint8_t port, uint8_t value) { device->write(port, value); },
+                          [&](uint8_t port) { return device->read(port); });
+    };
+
+    // The same as guest code, with the loop around it
+    Cpu cpu;
+    shifter.attach(cpu.getPorts());
+    const uint8_t program[] = {
+        0xD3, 0x04, // OUT 4
+        0x3C,       // INR A
+        0xD3, 0x02, // OUT 2
+        0xDB, 0x03, // IN 3
+        0xC3, 0x00, 0x00, // JMP 0
+    };
+    cpu.getMemory().load(program, sizeof(program));
+    BENCHMARK("1000 shifts, as IN and OUT") {
+        return cpu.run(1000 * (10 + 5 + 10 + 10 + 10));
+    };
+}
@@ -0,0 +1,42 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <vector>
+
+#include "invaders.hpp"
+#include "pacer.hpp"
+#include "replay.hpp"
+
+// The eight frames of the invaders boot played live and replayed from a log with its per frame hash checks,
+// both uncapped. The boot reads no ports, so the log holds the interrupts and frames only.
+TEST_CASE("Input replay speed") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu boot;
+    invaders::map(boot.getMemory(), rom);
+
+    std::vector<uint8_t> log;
+    Cpu cpu = boot;
+    {
+        SaveWriter out(log);
+        InputRecorder recorder(out, cpu);
+        for (int frame = 0; frame < 8; frame++) {
+            cpu.run(Pacer::CYCLES_PER_FRAME);
+            recorder.frame();
+        }
+    }
+
+    BENCHMARK("8 frames, live") {
+        cpu = boot;
+        for (int frame = 0; frame < 8; frame++) {
+            cpu.run(Pacer::CYCLES_PER_FRAME);
+        }
+        return cpu.getCycles();
+    };
+
+    BENCHMARK("8 frames, replayed") {
+        cpu = boot;
+        SaveReader in(log.data(), log.size());
+        InputReplay replay(in, cpu);
+        return replay.run();
+    };
+}
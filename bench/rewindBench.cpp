@@ -0,0 +1,46 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "invaders.hpp"
+#include "pacer.hpp"
+#include "rewind.hpp"
+
+// The eight frames of the invaders boot, with and without recording ten seconds of rewind after each
+TEST_CASE("Rewind overhead") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu boot;
+    invaders::map(boot.getMemory(), rom);
+
+    Cpu cpu = boot;
+    Rewind rewind(cpu, 10 * Pacer::FRAME_HZ);
+
+    BENCHMARK("8 frames") {
+        cpu = boot;
+        rewind.clear();
+        for (int frame = 0; frame < 8; frame++) {
+            cpu.run(Pacer::CYCLES_PER_FRAME);
+        }
+        return cpu.getCycles();
+    };
+
+    BENCHMARK("8 frames, recorded") {
+        cpu = boot;
+        rewind.clear();
+        for (int frame = 0; frame < 8; frame++) {
+            cpu.run(Pacer::CYCLES_PER_FRAME);
+            rewind.record();
+        }
+        return cpu.getCycles();
+    };
+
+    BENCHMARK("rewind 8 frames") {
+        cpu = boot;
+        rewind.clear();
+        for (int frame = 0; frame < 8; frame++) {
+            cpu.run(Pacer::CYCLES_PER_FRAME);
+            rewind.record();
+        }
+        return rewind.rewind(8);
+    };
+}
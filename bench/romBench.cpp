@@ -0,0 +1,25 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+#include <fstream>
+
+#include "cpu.hpp"
+
+// Time to load the invaders ROM into one instance, as paid for every instance a fleet starts
+TEST_CASE("ROM loading") {
+    Cpu cpu;
+
+    BENCHMARK("stream") {
+        std::ifstream rom(ROM_PATH, std::ios::binary);
+        return cpu.loadRom(rom);
+    };
+
+    BENCHMARK("path") {
+        return cpu.loadRom(ROM_PATH);
+    };
+
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    BENCHMARK("shared image") {
+        return cpu.loadRom(rom);
+    };
+}
@@ -0,0 +1,50 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "pacer.hpp"
+
+// Checkpoints of the invaders board one frame apart, full and as deltas against the frame before
+TEST_CASE("Savestates") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    cpu.run(4 * Pacer::CYCLES_PER_FRAME);
+    auto base = cpu.snapshot();
+    cpu.run(Pacer::CYCLES_PER_FRAME);
+
+    std::vector<uint8_t> full, delta;
+    SaveWriter fullOut(full), deltaOut(delta);
+    cpu.save(fullOut);
+    cpu.save(deltaOut, base.get());
+    std::cout << "checkpoint size: full " << full.size() << " bytes, delta " << delta.size() << " bytes\n";
+
+    std::vector<uint8_t> buffer;
+    buffer.reserve(full.size());
+    BENCHMARK("save full") {
+        buffer.clear();
+        SaveWriter out(buffer);
+        cpu.save(out);
+        return buffer.size();
+    };
+
+    BENCHMARK("save delta") {
+        buffer.clear();
+        SaveWriter out(buffer);
+        cpu.save(out, base.get());
+        return buffer.size();
+    };
+
+    Cpu loaded = cpu;
+    BENCHMARK("load full") {
+        SaveReader in(full.data(), full.size());
+        return loaded.load(in);
+    };
+
+    BENCHMARK("load delta") {
+        SaveReader in(delta.data(), delta.size());
+        return loaded.load(in, base);
+    };
+}
@@ -0,0 +1,56 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+
+namespace {
+    Cpu boot(const RomImage& rom) {
+        Cpu cpu;
+        invaders::map(cpu.getMemory(), rom);
+        return cpu;
+    }
+}
+
+// A second of the attract mode with the screen interrupts from the scheduler,
+// against checking the next interrupt after every instruction
+TEST_CASE("Screen interrupts") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    constexpr uint64_t SECOND = 60 * Pacer::CYCLES_PER_FRAME;
+
+    BENCHMARK_ADVANCED("1 second, scheduled")(Catch::Benchmark::Chronometer meter) {
+        Cpu cpu = boot(rom);
+        invaders::Shifter shifter;
+        shifter.attach(cpu.getPorts());
+        invaders::Screen screen(cpu);
+        meter.measure([&] { return cpu.run(SECOND); });
+    };
+
+    BENCHMARK_ADVANCED("1 second, scheduled without idle fast-forward")(Catch::Benchmark::Chronometer meter) {
+        Cpu cpu = boot(rom);
+        invaders::Shifter shifter;
+        shifter.attach(cpu.getPorts());
+        invaders::Screen screen(cpu);
+        cpu.setFastForward(false);
+        meter.measure([&] { return cpu.run(SECOND); });
+    };
+
+    BENCHMARK_ADVANCED("1 second, polled per instruction")(Catch::Benchmark::Chronometer meter) {
+        Cpu cpu = boot(rom);
+        invaders::Shifter shifter;
+        shifter.attach(cpu.getPorts());
+        meter.measure([&] {
+            uint64_t deadline = invaders::Screen::next(cpu.getCycles());
+            const uint64_t end = cpu.getCycles() + SECOND;
+            while (cpu.getCycles() < end) {
+                cpu.run(1);
+                if (cpu.getCycles() >= deadline) {
+                    cpu.interrupt(deadline % Pacer::CYCLES_PER_FRAME == invaders::Screen::MIDDLE ? 1 : 2);
+                    deadline = invaders::Screen::next(deadline);
+                }
+            }
+            return cpu.getCycles();
+        });
+    };
+}
@@ -0,0 +1,51 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+
+// Going back to the start after a guest touched 16 pages, the way a fuzzer resets between runs
+TEST_CASE("Reset") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+    boot.run(100'000);
+
+    auto touch = [](Cpu& cpu) {
+        for (uint32_t page = 0x20; page < 0x30; page++) {
+            cpu.getMemory().write(page << 8, page);
+        }
+    };
+
+    Cpu cpu = boot;
+    BENCHMARK("copy the whole Cpu") {
+        touch(cpu);
+        cpu = boot;
+        return cpu.getCycles();
+    };
+
+    auto start = cpu.snapshot();
+    BENCHMARK("restore the dirty pages") {
+        touch(cpu);
+        cpu.reset();
+        return cpu.getCycles();
+    };
+}
+
+// Telling whether two states differ, by comparing their memory or their hashes
+TEST_CASE("State comparison") {
+    Cpu cpu;
+    REQUIRE(cpu.loadRom(ROM_PATH) == 0);
+    cpu.run(100'000);
+    Cpu other = cpu;
+
+    BENCHMARK("compare 64 KiB") {
+        bool same = true;
+        for (uint32_t address = 0; address < 0x10000; address++) {
+            same &= cpu.getMemory().read(address) == other.getMemory().read(address);
+        }
+        return same;
+    };
+
+    BENCHMARK("compare state hashes") {
+        return cpu.stateHash() == other.stateHash();
+    };
+}
@@ -0,0 +1,76 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/benchmark/catch_benchmark.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "video.hpp"
+
+// Conversion of a frame of the attract mode alone, frames per second is one over the mean
+TEST_CASE("Video conversion") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    cpu.run(120 * Pacer::CYCLES_PER_FRAME);
+
+    std::vector<uint32_t> image(video::WIDTH * video::HEIGHT);
+    std::vector<uint8_t> gray(video::WIDTH * video::HEIGHT);
+    const char* const names[] = {"scalar", "SSE2", "AVX2"};
+    for (const video::Isa isa : {video::Isa::SCALAR, video::Isa::SSE, video::Isa::AVX2}) {
+        if (!Video::available(isa)) {
+            continue;
+        }
+        const Video video(video::OVERLAY, isa);
+        BENCHMARK(std::string("RGBA frame, ") + names[int(isa)]) {
+            video.rgba(cpu.getMemory(), image.data());
+            return image[0];
+        };
+        BENCHMARK(std::string("gray frame, ") + names[int(isa)]) {
+            video.gray(cpu.getMemory(), gray.data());
+            return gray[0];
+        };
+    }
+}
+
+// A frame of the attract mode then its conversion, in full or of the columns written. The attract mode skips
+// most of its cycles idle, so the conversion is a good part of it.
+TEST_CASE("Video updates") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    cpu.run(120 * Pacer::CYCLES_PER_FRAME);
+
+    const Video video;
+    std::vector<uint32_t> image(video::WIDTH * video::HEIGHT);
+    Cpu watched = cpu;
+    Video::watch(watched.getMemory());
+    video.update(watched.getMemory(), image.data());
+
+    uint64_t columns = 0;
+    Cpu sample = watched;
+    for (int frame = 0; frame < 600; frame++) {
+        sample.run(Pacer::CYCLES_PER_FRAME);
+        for (const video::Rect& rect : video.update(sample.getMemory(), image.data())) {
+            columns += rect.width;
+        }
+    }
+    std::cout << "columns written per frame: " << columns / 600.0 << " of " << video::WIDTH << '\n';
+
+    BENCHMARK("frame, full conversion") {
+        cpu.run(Pacer::CYCLES_PER_FRAME);
+        video.rgba(cpu.getMemory(), image.data());
+        return image[0];
+    };
+
+    BENCHMARK("frame, written columns") {
+        watched.run(Pacer::CYCLES_PER_FRAME);
+        return video.update(watched.getMemory(), image.data()).size();
+    };
+}
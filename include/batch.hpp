@@ -0,0 +1,93 @@
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu.hpp"
+
+namespace batch {
+    // Registers of every lane, one array per register. The kernels run a whole opcode across them.
+    struct Lanes {
+        uint8_t* r[8]; // B C D E H L, the M or immediate operand, A
+        uint8_t* F;
+        const uint8_t* mask; // 0xFF for the lanes that execute, the others keep their registers
+        size_t count; // a multiple of WIDTH
+    };
+
+    constexpr size_t WIDTH = 32; // lanes per AVX2 register, arrays are padded to it
+
+    enum class Isa { SCALAR, SSE, AVX2, BEST };
+
+    // Opcodes the kernels run: register moves, ALU, INR/DCR, INX/DCX of BC DE HL, and the one byte
+    // flag and accumulator ops. M and d8 operands are gathered into r[6] before, and M scattered after.
+    constexpr bool vectorized(uint8_t opcode) {
+        return (opcode & 0b11000111) == 0b00000000 // NOP and its aliases
+            || (opcode >= 0x40 && opcode <= 0xBF && opcode != 0x76) // MOV, ALU
+            || (opcode & 0b11000111) == 0b00000110 // MVI
+            || (opcode & 0b11000111) == 0b11000110 // ALU immediate
+            || (opcode & 0b11000110) == 0b00000100 // INR, DCR
+            || ((opcode & 0b11000111) == 0b00000011 && opcode >> 4 != 3) // INX, DCX
+            || opcode == 0x2F || opcode == 0x37 || opcode == 0x3F || opcode == 0xEB; // CMA, STC, CMC, XCHG
+    }
+
+    // One kernel per instruction set, the ones the build or the host lacks are null
+    using Kernel = void (*)(uint8_t opcode, const Lanes& lanes);
+    extern const Kernel scalar;
+    extern const Kernel sse;
+    extern const Kernel avx2;
+}
+
+// Runs many copies of a machine in lockstep. Lanes at the same PC execute each opcode together with
+// SIMD kernels when there is one, and one by one on their own Cpu otherwise. When lanes split up at a branch,
+// the ones with the lowest PC go first so that they meet again.
+class Batch {
+    protected:
+        size_t count; // lanes
+        size_t padded; // count rounded up to batch::WIDTH
+        std::vector<Cpu> cpus; // the memory of each lane, and its scalar engine
+
+        std::array<std::vector<uint8_t>, 8> r; // B C D E H L, operand, A
+        std::vector<uint8_t> F;
+        std::vector<uint16_t> PC, SP;
+        std::vector<uint64_t> cycles;
+        std::vector<uint8_t> mask;
+
+        // Code pages that hold the same bytes in every lane, so that opcodes and operands are fetched once per step.
+        // Found when the code first runs there, and watched in every lane from then on.
+        enum class Page : uint8_t { UNKNOWN, SHARED, PRIVATE };
+        std::array<Page, 0x100> pages{};
+        bool shared(uint16_t address, uint8_t length); // all bytes of the instruction at address
+        void checkWrites(size_t lane); // a write to a shared page makes it private
+
+        batch::Kernel kernel;
+        batch::Isa instructionSet;
+        uint64_t lockstepSteps = 0, scalarSteps = 0; // lane instructions
+
+        void load(size_t lane); // SoA registers into the lane's Cpu
+        void save(size_t lane); // and back
+        void execute(uint8_t opcode, uint16_t address, const Memory* code); // the lanes in mask, code when it is shared
+        void fireEvents(size_t lane); // the events due in the lane, through its Cpu
+
+    public:
+        // One lane per machine, copied
+        explicit Batch(const std::vector<Cpu>& machines, batch::Isa wanted = batch::Isa::BEST);
+        Batch(const Cpu& boot, size_t count, batch::Isa wanted = batch::Isa::BEST);
+
+        static bool available(batch::Isa wanted); // compiled in and supported by the host
+        batch::Isa getIsa() const { return instructionSet; }
+
+        // Every lane until it ran at least budget more cycles, stopping at the first instruction boundary past it.
+        // Each lane fires the events of its Cpu's scheduler; idle loops are not skipped.
+        void run(uint64_t budget);
+
+        size_t size() const { return count; }
+        const Cpu& lane(size_t index); // the lane as a Cpu, registers and cycles brought up to date
+
+        struct Stats {
+            uint64_t lockstepSteps; // lane instructions run together, by the kernels or the batch's own jumps and LXI
+            uint64_t scalarSteps; // by the Cpu of the lane
+        };
+        Stats getStats() const { return {lockstepSteps, scalarSteps}; }
+};
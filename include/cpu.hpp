@@ -1,10 +1,20 @@
 #pragma once
 
+#include <array>
 #include <cassert>
 #include <catch2/catch_test_macros.hpp>
 #include <fstream>
 #include <iostream>
+#include <memory>
+#include <unordered_map>
+#include <vector>
 
+#include "jit.hpp"
+#include "ports.hpp"
+#include "recompiled.hpp"
+#include "romImage.hpp"
+#include "savestate.hpp"
+#include "scheduler.hpp"
 #include "state.hpp"
 
 class CpuTestWrapper;
@@ -14,16 +24,220 @@ class Cpu {
         Registers regs;
         Memory memory;
 
+        uint64_t cycles = 0; // T-states executed since power on, counted by decode, run and runUntil
+
+        Ports ports; // what IN and OUT reach
+        Scheduler scheduler; // device events, fired between instructions by run
+
+        // Runs slice(budget) up to the next deadline and fires the events due there, until budget cycles ran.
+        // slice adds the cycles it ran to cycles.
+        template<typename Slice> uint64_t runEvents(uint64_t budget, Slice slice);
+        uint64_t runEngine(uint64_t budget); // the configured engine, without events
+        void fireEvents() { // the ones due by now, between two instructions
+            if (cycles >= scheduler.next()) {
+                scheduler.run(*this, cycles);
+            }
+        }
+
+        // IDLE FAST-FORWARD, between events a CPU in HLT or in a spin loop repeats itself, so runEvents skips ahead
+        // to the last repetition before the deadline instead of running them. Memory and ports are assumed to change
+        // only when events fire, which holds for everything scheduled.
+        static constexpr uint64_t IDLE_CHECK = 2048; // cycles run between looks for an idle CPU
+        static constexpr uint32_t MAX_SPIN = 8; // instructions in a spin loop
+        bool fastForward = true;
+        uint64_t skippedCycles = 0;
+
+        static bool idle(uint8_t opcode); // changes registers only, reading memory and ports at most
+        // Whether address is in a loop of idle instructions, straight line code from head up to a jump back to head
+        // ending at end. Jumps out of it are fine.
+        bool spinLoop(uint16_t address, uint16_t& head, uint16_t& end) const;
+        // Runs to the head of the spin loop at PC and once around it, never past deadline. Returns the cycles it took
+        // to come back to the same state, 0 when there is no such loop.
+        uint64_t spinPeriod(uint64_t deadline);
+        void skipIdle(uint64_t deadline); // advances cycles by whole repetitions that would end before deadline
+
         void UnimplementedInstruction(uint16_t PC);
 
         uint16_t read16atPC(); // read next two bytes and increment PC twice
 
+        int step(); // one instruction with the switch or table engine, without counting its cycles
+
+        // Engines count a slice in a local and add it to cycles at the end. IN and OUT let devices read the clock, so
+        // these run with what the slice executed so far added in for the call.
+        template<typename Run> int atCycle(uint64_t executed, Run run) {
+            cycles += executed;
+            const int taken = run();
+            cycles -= executed;
+            return taken;
+        }
+
+        // One handler per opcode, called with PC already past the opcode byte. Returns the T-states it took.
+        template<uint8_t opcode> int execute();
+        template<uint8_t opcode> static int dispatch(Cpu& cpu) { return cpu.execute<opcode>(); }
+        template<uint8_t opcode> void instruction(); // opcodes outside the families below
+
+        // Opcode families, parameterized on the register (B C D E H L M A) or register pair (BC DE HL SP) encoding
+        template<uint8_t r> uint8_t load();
+        template<uint8_t r> void store(uint8_t value);
+        template<uint8_t rp> uint16_t loadPair();
+        template<uint8_t rp> void storePair(uint16_t value);
+
+        template<uint8_t dst, uint8_t src> void mov();
+        template<uint8_t r> void mvi();
+        template<uint8_t rp> void lxi();
+        template<uint8_t op, uint8_t src> void alu();
+        template<uint8_t r> void inr();
+        template<uint8_t r> void dcr();
+        template<uint8_t rp> void inx();
+        template<uint8_t rp> void dcx();
+        template<uint8_t rp> void dad();
+        template<uint8_t rp> void push();
+        template<uint8_t rp> void pop();
+
+        // Branches, parameterized on the condition encoding (NZ Z NC C PO PE P M). CALL and RET return whether they were taken.
+        template<uint8_t cc> bool condition();
+        template<uint8_t cc> void jump();
+        template<uint8_t cc> bool call();
+        template<uint8_t cc> bool ret();
+        template<uint8_t n> void rst();
+
+        using Handler = int (*)(Cpu&);
+        static const std::array<Handler, 0x100> handlers;
+
+        // Computed goto loop, stops after limit instructions, or once limit cycles ran when budgeted
+        template<bool budgeted> uint64_t threaded(uint64_t limit);
+
+        // BASIC BLOCK CACHE, straight line code up to and including a branch, keyed by its start address
+        struct Block {
+            std::vector<Handler> handlers; // one per instruction or superinstruction, operands are still read from memory
+            uint32_t instructions = 0;
+            uint32_t runs = 0; // counted by the JIT to find hot blocks
+            bool io = false; // has an IN or OUT, which needs the cycle it runs at
+        };
+        static constexpr size_t MAX_BLOCK = 64; // instructions
+        std::unordered_map<uint16_t, Block> blocks;
+        std::array<std::vector<uint16_t>, 0x100> pageBlocks; // start addresses of the blocks with code in each page
+        uint64_t blockHits = 0, blockMisses = 0, blockInvalidations = 0, blockFusions = 0;
+
+        // Superinstructions, a mined opcode sequence behind a single handler. Only the last opcode may branch or write memory.
+        template<uint8_t first, uint8_t... rest> static int fused(Cpu& cpu);
+        struct Superinstruction {
+            std::array<uint8_t, 3> opcodes;
+            uint8_t length;
+            Handler handler;
+        };
+        template<uint8_t... opcodes> static Superinstruction superinstruction();
+        static const std::vector<Superinstruction> superinstructions; // see superinstructions.inc
+
+        const Block& translate(uint16_t address);
+        void invalidateCode(); // drop the blocks in the code pages written since the last call
+
+        // JIT, native code for the hot blocks
+        Jit jit;
+        uint64_t nativeRuns = 0;
+
+        void compile(uint16_t address, const Block& block);
+        static uint32_t jitStep(Cpu* cpu, Handler handler); // called by native code for the instructions it does not translate
+
     public:
         int loadRom(std::istream &rom);
         int loadRom(const char* rom);
+        int loadRom(const RomImage& rom); // copies the image, which can be shared by any number of Cpus
+
+        // Execute one instruction with the engine picked by CPU_DISPATCH at build time. Fires no events, it is the single
+        // step the reference tests compare the engines with; run, runUntil and trace fire them.
         int decode();
-    
+
+        int decodeSwitch(); // reference engine, one big switch over the opcode
+        int decodeTable(); // indexes the handler table
+        uint64_t decodeThreaded(uint64_t count); // computed goto between handlers, executes count instructions
+        // Executes the cached basic block at PC, translating it first on a miss. Stops early once budget cycles ran.
+        uint64_t decodeBlock(uint64_t budget = UINT64_MAX);
+
+        // Runs the native code of the block at PC, or interprets it with decodeBlock while it is cold.
+        // Native blocks always run to their end, whatever the budget.
+        uint64_t decodeJit(uint64_t budget = UINT64_MAX);
+
+        struct BlockStats {
+            uint64_t hits;
+            uint64_t misses;
+            uint64_t invalidations; // blocks dropped because their code was written
+            uint64_t compiled; // blocks with native code
+            uint64_t nativeRuns;
+            uint64_t fusions; // superinstructions in the translated blocks
+        };
+        BlockStats getBlockStats() const { return {blockHits, blockMisses, blockInvalidations, jit.compiled(), nativeRuns, blockFusions}; }
+
+        // Executes instructions until at least budget cycles ran, firing the scheduled events on the way.
+        // Returns how far the last instruction overshot it.
+        uint64_t run(uint64_t budget);
+        // Executes instructions until done() holds, checked before every instruction once the events due there fired.
+        // Returns the cycles it took.
+        template<typename Predicate> uint64_t runUntil(Predicate done) {
+            const uint64_t start = cycles;
+            fireEvents();
+            while (!done()) {
+                decode();
+                fireEvents();
+            }
+            return cycles - start;
+        }
+
+        // run on code from the static recompiler: its block at PC if there is one, the interpreter otherwise
+        uint64_t runRecompiled(const recompiled::Rom& rom, uint64_t budget);
+
+        // Like run, calling visit(address, opcode) before every instruction, for profiling tools. Events fire at the
+        // same instruction boundaries as in run, idle loops are not skipped.
+        template<typename Visitor> uint64_t trace(uint64_t budget, Visitor visit) {
+            const uint64_t target = cycles + budget;
+            fireEvents();
+            while (cycles < target) {
+                visit(regs.PC, memory.read(regs.PC));
+                decode();
+                fireEvents();
+            }
+            return cycles - target;
+        }
+
+        uint64_t getCycles() const { return cycles; } // inside run, the count when it was called
+        // Idle fast-forward, on by default. The cycles skipped count as run, the state ends up the same either way.
+        void setFastForward(bool enabled) { fastForward = enabled; }
+        uint64_t getSkippedCycles() const { return skippedCycles; }
+        Ports& getPorts() { return ports; }
+        Scheduler& getScheduler() { return scheduler; }
+
+        // Executes RST vector when the guest enabled interrupts, which disables them, and wakes it from HLT.
+        // Returns false when the interrupt was ignored.
+        bool interrupt(uint8_t vector);
+        // Hash of the registers, the memory and the event deadlines, O(1) in the memory size. Equal states with the same
+        // memory map and events hash the same.
+        uint64_t stateHash();
+        Memory& getMemory() { return memory; }
+        const Memory& getMemory() const { return memory; }
+
+        // A saved machine state. Taking or restoring one makes it the reset point, from then on the memory pages
+        // written are tracked, so going back costs what the guest touched rather than 64 KiB.
+        struct Snapshot {
+            Registers regs;
+            Memory memory;
+            uint64_t cycles;
+            std::vector<uint64_t> deadlines; // of the scheduled events
+        };
+        std::shared_ptr<const Snapshot> snapshot();
+        void restore(const std::shared_ptr<const Snapshot>& snapshot); // any snapshot of a Cpu with the same memory map
+        void reset(); // back to the reset point, or to the state after construction when there is none
+
+        // Savestates, see savestate.hpp. Without a base the state is saved in full, with one only the pages that differ
+        // from it. Loading a delta needs the same base, and makes it the reset point. On failure the state is undefined.
+        void save(SaveWriter& out, const Snapshot* base = nullptr);
+        int load(SaveReader& in, const std::shared_ptr<const Snapshot>& base = nullptr);
+
+    protected:
+        std::shared_ptr<const Snapshot> resetPoint; // the memory differs from it in the dirty pages only
+
     friend class CpuTestWrapper;
+    friend class Batch; // runs the opcodes its kernels lack on the Cpu of the lane
+    friend class Rewind; // records and restores the registers
 };
 
 class CpuTestWrapper {
@@ -42,6 +256,9 @@ class CpuTestWrapper {
                     return 0;  // Keep the compiler happy about return paths
             }
         }
+        static Registers& getRegs(Cpu& cpu) { return cpu.regs; }
+        static void compile(Cpu& cpu, uint16_t address) { cpu.compile(address, cpu.translate(address)); }
+        static Memory& getMemory(Cpu& cpu) { return cpu.memory; }
         static uint16_t getRegPairValue(int rp, Cpu& cpu) {
             switch (rp) {
                 case 0b00: return cpu.regs.readBC();
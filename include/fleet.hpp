@@ -0,0 +1,61 @@
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "cpu.hpp"
+
+// Hosts many independent Cpus in one process. Workers run them in frame sized slices,
+// each from its own queue, stealing from the others once it runs dry.
+class Fleet {
+    protected:
+        struct Instance {
+            Cpu cpu;
+            uint64_t overshoot = 0; // taken off the next frame, as in main
+            uint64_t frames = 0;
+            uint64_t target = 0; // frames to reach in this run
+        };
+        std::vector<std::unique_ptr<Instance>> instances;
+
+        struct Worker {
+            std::mutex lock;
+            std::deque<size_t> queue; // instances, the owner works at the back and thieves take from the front
+            uint64_t steals = 0;
+        };
+
+        std::chrono::steady_clock::duration elapsed{0}; // of the last run
+        uint64_t runCycles = 0;
+        uint64_t runSteals = 0;
+
+        static void pin(unsigned core);
+        void work(std::vector<std::unique_ptr<Worker>>& workers, size_t self, std::atomic<size_t>& remaining);
+
+    public:
+        // count copies of boot, which usually has just loaded a ROM. Their ports reach the devices of boot until they
+        // rebind them, see Ports::rebind.
+        Fleet(const Cpu& boot, size_t count);
+
+        // Runs every instance for frames more frames on workers threads, pinned to one core each when pin is set
+        void run(uint64_t frames, unsigned workers, bool pin = true);
+
+        size_t size() const { return instances.size(); }
+        Cpu& instance(size_t index) { return instances[index]->cpu; }
+
+        struct Progress {
+            uint64_t frames;
+            uint64_t cycles;
+        };
+        Progress progress(size_t index) const { return {instances[index]->frames, instances[index]->cpu.getCycles()}; }
+
+        // Statistics of the last run
+        double seconds() const;
+        double emulatedMHz() const; // all instances together
+        uint64_t steals() const { return runSteals; }
+        void report(std::ostream& out, bool perInstance = false) const;
+};
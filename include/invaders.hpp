@@ -0,0 +1,62 @@
+#pragma once
+
+#include <cstdint>
+
+#include "cpu.hpp"
+#include "pacer.hpp"
+#include "ports.hpp"
+#include "romImage.hpp"
+#include "state.hpp"
+
+// The Space Invaders board
+namespace invaders {
+    constexpr uint16_t ROM = 0x0000;
+    constexpr uint32_t ROM_SIZE = 0x2000;
+    constexpr uint16_t RAM = 0x2000; // work RAM, the stack grows down from its top
+    constexpr uint32_t RAM_SIZE = 0x0400;
+    constexpr uint16_t VRAM = 0x2400; // 1 bit per pixel, 256x224 rotated
+    constexpr uint32_t VRAM_SIZE = 0x1C00;
+    constexpr uint16_t MIRROR = 0x4000; // the address decoding ignores A14 and A15
+
+    // Write protected ROM read in place from rom, shared by every copy of memory, then RAM, VRAM and their mirrors
+    void map(Memory& memory, const RomImage& rom);
+
+    constexpr uint8_t SHIFT_OFFSET = 2; // out
+    constexpr uint8_t SHIFT_RESULT = 3; // in
+    constexpr uint8_t SHIFT_DATA = 4; // out
+
+    // The dedicated shift register the 8080 lacks: every byte written to SHIFT_DATA shifts in from the left of a 16 bit
+    // register, SHIFT_RESULT reads 8 bits of it, SHIFT_OFFSET bits from the top
+    class Shifter : public PortDevice<Shifter> {
+        protected:
+            uint16_t value = 0;
+            uint8_t offset = 0;
+
+        public:
+            uint8_t read(uint8_t) const { return value >> (8 - offset); }
+            void write(uint8_t port, uint8_t data) {
+                if (port == SHIFT_DATA) {
+                    value = data << 8 | value >> 8;
+                } else {
+                    offset = data & 0b111;
+                }
+            }
+            void attach(Ports& ports) { PortDevice::attach(ports, {SHIFT_RESULT}, {SHIFT_OFFSET, SHIFT_DATA}); }
+    };
+
+    // The video hardware interrupts twice a frame: RST 1 when the beam is half way down the screen, RST 2 at vblank.
+    // An event of the Cpu it is attached to and of every copy of it. It keeps no state, the vector follows from the
+    // deadline, so snapshots, savestates and rewind time it right.
+    class Screen {
+        protected:
+            Scheduler::Event event;
+            static uint64_t interrupt(void* context, Cpu& cpu, uint64_t cycle);
+
+        public:
+            static constexpr uint64_t MIDDLE = Pacer::CYCLES_PER_FRAME / 2;
+            static uint64_t next(uint64_t cycle); // the first interrupt after cycle
+
+            explicit Screen(Cpu& cpu);
+            Scheduler::Event getEvent() const { return event; }
+    };
+}
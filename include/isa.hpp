@@ -0,0 +1,353 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+#include "state.hpp"
+
+// Static description of every opcode, shared by the engines, the timing and the disassembler.
+namespace isa {
+    struct Opcode {
+        const char* mnemonic; // operands d8, d16 and a16 stand for the bytes after the opcode, * marks undocumented aliases
+        uint8_t length; // in bytes, opcode included
+        uint8_t cycles; // T-states, for a conditional CALL or RET when it is not taken
+        uint8_t takenCycles; // extra T-states when a conditional CALL or RET is taken
+        uint8_t flags; // flags it can change
+    };
+
+    constexpr uint8_t S = Registers::SIGN_FLAG;
+    constexpr uint8_t Z = Registers::ZERO_FLAG;
+    constexpr uint8_t AC = Registers::AUX_CARRY_FLAG;
+    constexpr uint8_t P = Registers::PARITY_FLAG;
+    constexpr uint8_t CY = Registers::CARRY_FLAG;
+    constexpr uint8_t ALL = S | Z | AC | P | CY;
+    constexpr uint8_t NONE = 0;
+
+    constexpr std::array<Opcode, 0x100> opcodes = {{
+    // 0x00
+    { "NOP", 1, 4, 0, NONE },
+    { "LXI B,d16", 3, 10, 0, NONE },
+    { "STAX B", 1, 7, 0, NONE },
+    { "INX B", 1, 5, 0, NONE },
+    { "INR B", 1, 5, 0, S | Z | AC | P },
+    { "DCR B", 1, 5, 0, S | Z | AC | P },
+    { "MVI B,d8", 2, 7, 0, NONE },
+    { "RLC", 1, 4, 0, CY },
+    // 0x08
+    { "*NOP", 1, 4, 0, NONE },
+    { "DAD B", 1, 10, 0, CY },
+    { "LDAX B", 1, 7, 0, NONE },
+    { "DCX B", 1, 5, 0, NONE },
+    { "INR C", 1, 5, 0, S | Z | AC | P },
+    { "DCR C", 1, 5, 0, S | Z | AC | P },
+    { "MVI C,d8", 2, 7, 0, NONE },
+    { "RRC", 1, 4, 0, CY },
+    // 0x10
+    { "*NOP", 1, 4, 0, NONE },
+    { "LXI D,d16", 3, 10, 0, NONE },
+    { "STAX D", 1, 7, 0, NONE },
+    { "INX D", 1, 5, 0, NONE },
+    { "INR D", 1, 5, 0, S | Z | AC | P },
+    { "DCR D", 1, 5, 0, S | Z | AC | P },
+    { "MVI D,d8", 2, 7, 0, NONE },
+    { "RAL", 1, 4, 0, CY },
+    // 0x18
+    { "*NOP", 1, 4, 0, NONE },
+    { "DAD D", 1, 10, 0, CY },
+    { "LDAX D", 1, 7, 0, NONE },
+    { "DCX D", 1, 5, 0, NONE },
+    { "INR E", 1, 5, 0, S | Z | AC | P },
+    { "DCR E", 1, 5, 0, S | Z | AC | P },
+    { "MVI E,d8", 2, 7, 0, NONE },
+    { "RAR", 1, 4, 0, CY },
+    // 0x20
+    { "*NOP", 1, 4, 0, NONE },
+    { "LXI H,d16", 3, 10, 0, NONE },
+    { "SHLD a16", 3, 16, 0, NONE },
+    { "INX H", 1, 5, 0, NONE },
+    { "INR H", 1, 5, 0, S | Z | AC | P },
+    { "DCR H", 1, 5, 0, S | Z | AC | P },
+    { "MVI H,d8", 2, 7, 0, NONE },
+    { "DAA", 1, 4, 0, ALL },
+    // 0x28
+    { "*NOP", 1, 4, 0, NONE },
+    { "DAD H", 1, 10, 0, CY },
+    { "LHLD a16", 3, 16, 0, NONE },
+    { "DCX H", 1, 5, 0, NONE },
+    { "INR L", 1, 5, 0, S | Z | AC | P },
+    { "DCR L", 1, 5, 0, S | Z | AC | P },
+    { "MVI L,d8", 2, 7, 0, NONE },
+    { "CMA", 1, 4, 0, NONE },
+    // 0x30
+    { "*NOP", 1, 4, 0, NONE },
+    { "LXI SP,d16", 3, 10, 0, NONE },
+    { "STA a16", 3, 13, 0, NONE },
+    { "INX SP", 1, 5, 0, NONE },
+    { "INR M", 1, 10, 0, S | Z | AC | P },
+    { "DCR M", 1, 10, 0, S | Z | AC | P },
+    { "MVI M,d8", 2, 10, 0, NONE },
+    { "STC", 1, 4, 0, CY },
+    // 0x38
+    { "*NOP", 1, 4, 0, NONE },
+    { "DAD SP", 1, 10, 0, CY },
+    { "LDA a16", 3, 13, 0, NONE },
+    { "DCX SP", 1, 5, 0, NONE },
+    { "INR A", 1, 5, 0, S | Z | AC | P },
+    { "DCR A", 1, 5, 0, S | Z | AC | P },
+    { "MVI A,d8", 2, 7, 0, NONE },
+    { "CMC", 1, 4, 0, CY },
+    // 0x40
+    { "MOV B,B", 1, 5, 0, NONE },
+    { "MOV B,C", 1, 5, 0, NONE },
+    { "MOV B,D", 1, 5, 0, NONE },
+    { "MOV B,E", 1, 5, 0, NONE },
+    { "MOV B,H", 1, 5, 0, NONE },
+    { "MOV B,L", 1, 5, 0, NONE },
+    { "MOV B,M", 1, 7, 0, NONE },
+    { "MOV B,A", 1, 5, 0, NONE },
+    // 0x48
+    { "MOV C,B", 1, 5, 0, NONE },
+    { "MOV C,C", 1, 5, 0, NONE },
+    { "MOV C,D", 1, 5, 0, NONE },
+    { "MOV C,E", 1, 5, 0, NONE },
+    { "MOV C,H", 1, 5, 0, NONE },
+    { "MOV C,L", 1, 5, 0, NONE },
+    { "MOV C,M", 1, 7, 0, NONE },
+    { "MOV C,A", 1, 5, 0, NONE },
+    // 0x50
+    { "MOV D,B", 1, 5, 0, NONE },
+    { "MOV D,C", 1, 5, 0, NONE },
+    { "MOV D,D", 1, 5, 0, NONE },
+    { "MOV D,E", 1, 5, 0, NONE },
+    { "MOV D,H", 1, 5, 0, NONE },
+    { "MOV D,L", 1, 5, 0, NONE },
+    { "MOV D,M", 1, 7, 0, NONE },
+    { "MOV D,A", 1, 5, 0, NONE },
+    // 0x58
+    { "MOV E,B", 1, 5, 0, NONE },
+    { "MOV E,C", 1, 5, 0, NONE },
+    { "MOV E,D", 1, 5, 0, NONE },
+    { "MOV E,E", 1, 5, 0, NONE },
+    { "MOV E,H", 1, 5, 0, NONE },
+    { "MOV E,L", 1, 5, 0, NONE },
+    { "MOV E,M", 1, 7, 0, NONE },
+    { "MOV E,A", 1, 5, 0, NONE },
+    // 0x60
+    { "MOV H,B", 1, 5, 0, NONE },
+    { "MOV H,C", 1, 5, 0, NONE },
+    { "MOV H,D", 1, 5, 0, NONE },
+    { "MOV H,E", 1, 5, 0, NONE },
+    { "MOV H,H", 1, 5, 0, NONE },
+    { "MOV H,L", 1, 5, 0, NONE },
+    { "MOV H,M", 1, 7, 0, NONE },
+    { "MOV H,A", 1, 5, 0, NONE },
+    // 0x68
+    { "MOV L,B", 1, 5, 0, NONE },
+    { "MOV L,C", 1, 5, 0, NONE },
+    { "MOV L,D", 1, 5, 0, NONE },
+    { "MOV L,E", 1, 5, 0, NONE },
+    { "MOV L,H", 1, 5, 0, NONE },
+    { "MOV L,L", 1, 5, 0, NONE },
+    { "MOV L,M", 1, 7, 0, NONE },
+    { "MOV L,A", 1, 5, 0, NONE },
+    // 0x70
+    { "MOV M,B", 1, 7, 0, NONE },
+    { "MOV M,C", 1, 7, 0, NONE },
+    { "MOV M,D", 1, 7, 0, NONE },
+    { "MOV M,E", 1, 7, 0, NONE },
+    { "MOV M,H", 1, 7, 0, NONE },
+    { "MOV M,L", 1, 7, 0, NONE },
+    { "HLT", 1, 7, 0, NONE },
+    { "MOV M,A", 1, 7, 0, NONE },
+    // 0x78
+    { "MOV A,B", 1, 5, 0, NONE },
+    { "MOV A,C", 1, 5, 0, NONE },
+    { "MOV A,D", 1, 5, 0, NONE },
+    { "MOV A,E", 1, 5, 0, NONE },
+    { "MOV A,H", 1, 5, 0, NONE },
+    { "MOV A,L", 1, 5, 0, NONE },
+    { "MOV A,M", 1, 7, 0, NONE },
+    { "MOV A,A", 1, 5, 0, NONE },
+    // 0x80
+    { "ADD B", 1, 4, 0, ALL },
+    { "ADD C", 1, 4, 0, ALL },
+    { "ADD D", 1, 4, 0, ALL },
+    { "ADD E", 1, 4, 0, ALL },
+    { "ADD H", 1, 4, 0, ALL },
+    { "ADD L", 1, 4, 0, ALL },
+    { "ADD M", 1, 7, 0, ALL },
+    { "ADD A", 1, 4, 0, ALL },
+    // 0x88
+    { "ADC B", 1, 4, 0, ALL },
+    { "ADC C", 1, 4, 0, ALL },
+    { "ADC D", 1, 4, 0, ALL },
+    { "ADC E", 1, 4, 0, ALL },
+    { "ADC H", 1, 4, 0, ALL },
+    { "ADC L", 1, 4, 0, ALL },
+    { "ADC M", 1, 7, 0, ALL },
+    { "ADC A", 1, 4, 0, ALL },
+    // 0x90
+    { "SUB B", 1, 4, 0, ALL },
+    { "SUB C", 1, 4, 0, ALL },
+    { "SUB D", 1, 4, 0, ALL },
+    { "SUB E", 1, 4, 0, ALL },
+    { "SUB H", 1, 4, 0, ALL },
+    { "SUB L", 1, 4, 0, ALL },
+    { "SUB M", 1, 7, 0, ALL },
+    { "SUB A", 1, 4, 0, ALL },
+    // 0x98
+    { "SBB B", 1, 4, 0, ALL },
+    { "SBB C", 1, 4, 0, ALL },
+    { "SBB D", 1, 4, 0, ALL },
+    { "SBB E", 1, 4, 0, ALL },
+    { "SBB H", 1, 4, 0, ALL },
+    { "SBB L", 1, 4, 0, ALL },
+    { "SBB M", 1, 7, 0, ALL },
+    { "SBB A", 1, 4, 0, ALL },
+    // 0xA0
+    { "ANA B", 1, 4, 0, ALL },
+    { "ANA C", 1, 4, 0, ALL },
+    { "ANA D", 1, 4, 0, ALL },
+    { "ANA E", 1, 4, 0, ALL },
+    { "ANA H", 1, 4, 0, ALL },
+    { "ANA L", 1, 4, 0, ALL },
+    { "ANA M", 1, 7, 0, ALL },
+    { "ANA A", 1, 4, 0, ALL },
+    // 0xA8
+    { "XRA B", 1, 4, 0, ALL },
+    { "XRA C", 1, 4, 0, ALL },
+    { "XRA D", 1, 4, 0, ALL },
+    { "XRA E", 1, 4, 0, ALL },
+    { "XRA H", 1, 4, 0, ALL },
+    { "XRA L", 1, 4, 0, ALL },
+    { "XRA M", 1, 7, 0, ALL },
+    { "XRA A", 1, 4, 0, ALL },
+    // 0xB0
+    { "ORA B", 1, 4, 0, ALL },
+    { "ORA C", 1, 4, 0, ALL },
+    { "ORA D", 1, 4, 0, ALL },
+    { "ORA E", 1, 4, 0, ALL },
+    { "ORA H", 1, 4, 0, ALL },
+    { "ORA L", 1, 4, 0, ALL },
+    { "ORA M", 1, 7, 0, ALL },
+    { "ORA A", 1, 4, 0, ALL },
+    // 0xB8
+    { "CMP B", 1, 4, 0, ALL },
+    { "CMP C", 1, 4, 0, ALL },
+    { "CMP D", 1, 4, 0, ALL },
+    { "CMP E", 1, 4, 0, ALL },
+    { "CMP H", 1, 4, 0, ALL },
+    { "CMP L", 1, 4, 0, ALL },
+    { "CMP M", 1, 7, 0, ALL },
+    { "CMP A", 1, 4, 0, ALL },
+    // 0xC0
+    { "RNZ", 1, 5, 6, NONE },
+    { "POP B", 1, 10, 0, NONE },
+    { "JNZ a16", 3, 10, 0, NONE },
+    { "JMP a16", 3, 10, 0, NONE },
+    { "CNZ a16", 3, 11, 6, NONE },
+    { "PUSH B", 1, 11, 0, NONE },
+    { "ADI d8", 2, 7, 0, ALL },
+    { "RST 0", 1, 11, 0, NONE },
+    // 0xC8
+    { "RZ", 1, 5, 6, NONE },
+    { "RET", 1, 10, 0, NONE },
+    { "JZ a16", 3, 10, 0, NONE },
+    { "*JMP a16", 3, 10, 0, NONE },
+    { "CZ a16", 3, 11, 6, NONE },
+    { "CALL a16", 3, 17, 0, NONE },
+    { "ACI d8", 2, 7, 0, ALL },
+    { "RST 1", 1, 11, 0, NONE },
+    // 0xD0
+    { "RNC", 1, 5, 6, NONE },
+    { "POP D", 1, 10, 0, NONE },
+    { "JNC a16", 3, 10, 0, NONE },
+    { "OUT d8", 2, 10, 0, NONE },
+    { "CNC a16", 3, 11, 6, NONE },
+    { "PUSH D", 1, 11, 0, NONE },
+    { "SUI d8", 2, 7, 0, ALL },
+    { "RST 2", 1, 11, 0, NONE },
+    // 0xD8
+    { "RC", 1, 5, 6, NONE },
+    { "*RET", 1, 10, 0, NONE },
+    { "JC a16", 3, 10, 0, NONE },
+    { "IN d8", 2, 10, 0, NONE },
+    { "CC a16", 3, 11, 6, NONE },
+    { "*CALL a16", 3, 17, 0, NONE },
+    { "SBI d8", 2, 7, 0, ALL },
+    { "RST 3", 1, 11, 0, NONE },
+    // 0xE0
+    { "RPO", 1, 5, 6, NONE },
+    { "POP H", 1, 10, 0, NONE },
+    { "JPO a16", 3, 10, 0, NONE },
+    { "XTHL", 1, 18, 0, NONE },
+    { "CPO a16", 3, 11, 6, NONE },
+    { "PUSH H", 1, 11, 0, NONE },
+    { "ANI d8", 2, 7, 0, ALL },
+    { "RST 4", 1, 11, 0, NONE },
+    // 0xE8
+    { "RPE", 1, 5, 6, NONE },
+    { "PCHL", 1, 5, 0, NONE },
+    { "JPE a16", 3, 10, 0, NONE },
+    { "XCHG", 1, 4, 0, NONE },
+    { "CPE a16", 3, 11, 6, NONE },
+    { "*CALL a16", 3, 17, 0, NONE },
+    { "XRI d8", 2, 7, 0, ALL },
+    { "RST 5", 1, 11, 0, NONE },
+    // 0xF0
+    { "RP", 1, 5, 6, NONE },
+    { "POP PSW", 1, 10, 0, ALL },
+    { "JP a16", 3, 10, 0, NONE },
+    { "DI", 1, 4, 0, NONE },
+    { "CP a16", 3, 11, 6, NONE },
+    { "PUSH PSW", 1, 11, 0, NONE },
+    { "ORI d8", 2, 7, 0, ALL },
+    { "RST 6", 1, 11, 0, NONE },
+    // 0xF8
+    { "RM", 1, 5, 6, NONE },
+    { "SPHL", 1, 5, 0, NONE },
+    { "JM a16", 3, 10, 0, NONE },
+    { "EI", 1, 4, 0, NONE },
+    { "CM a16", 3, 11, 6, NONE },
+    { "*CALL a16", 3, 17, 0, NONE },
+    { "CPI d8", 2, 7, 0, ALL },
+    { "RST 7", 1, 11, 0, NONE },
+    }};
+
+    // Opcodes that can load PC: jumps, calls, returns, RST and PCHL
+    constexpr bool branches(uint8_t opcode) {
+        return (opcode & 0b11000111) == 0b11000010 // Jcc
+            || (opcode & 0b11000111) == 0b11000100 // Ccc
+            || (opcode & 0b11000111) == 0b11000000 // Rcc
+            || (opcode & 0b11000111) == 0b11000111 // RST
+            || (opcode & 0b11110111) == 0b11000011 // JMP
+            || (opcode & 0b11001111) == 0b11001101 // CALL
+            || (opcode & 0b11101111) == 0b11001001 // RET
+            || opcode == 0xE9; // PCHL
+    }
+
+    // Opcodes that can write memory: stores to M and direct addresses, and everything that pushes
+    constexpr bool writesMemory(uint8_t opcode) {
+        return (opcode >= 0x70 && opcode <= 0x77 && opcode != 0x76) // MOV M, r
+            || opcode == 0x36 || opcode == 0x34 || opcode == 0x35 // MVI M, INR M, DCR M
+            || opcode == 0x02 || opcode == 0x12 || opcode == 0x32 || opcode == 0x22 // STAX, STA, SHLD
+            || (opcode & 0b11001111) == 0b11000101 // PUSH
+            || (opcode & 0b11000111) == 0b11000100 // Ccc
+            || (opcode & 0b11001111) == 0b11001101 // CALL
+            || (opcode & 0b11000111) == 0b11000111 // RST
+            || opcode == 0xE3; // XTHL
+    }
+
+    // Opcodes a superinstruction can run ahead of others: they fall through and leave the code alone
+    constexpr bool fusable(uint8_t opcode) {
+        return !branches(opcode) && !writesMemory(opcode) && opcode != 0x76; // 0x76 is HLT
+    }
+
+    // IN and OUT, the only opcodes devices see, so the only ones that need the cycle count up to date
+    constexpr bool io(uint8_t opcode) {
+        return opcode == 0xDB || opcode == 0xD3;
+    }
+
+    std::string disassemble(const Memory &memory, uint16_t address); // the instruction at address, operands filled in
+}
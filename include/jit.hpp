@@ -0,0 +1,46 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+class Cpu;
+
+// Native x86-64 code for hot basic blocks, kept in one executable buffer.
+// Only a cache: a copy starts empty and the owner recompiles what it needs.
+class Jit {
+    public:
+        using Native = uint32_t (*)(Cpu* cpu); // runs a block, returns the T-states it took
+
+    protected:
+        uint8_t* buffer = nullptr;
+        size_t used = 0;
+        std::unordered_map<uint16_t, Native> code; // by block start address
+        std::unordered_map<uint16_t, uint8_t> rewrites; // times the code of a block was written, self-modifying code stays interpreted
+
+    public:
+        static constexpr size_t BUFFER_SIZE = 1 << 20;
+        static constexpr uint32_t HOT = 16; // block runs before it is compiled
+        static constexpr uint8_t MAX_REWRITES = 2;
+
+        Jit() = default;
+        ~Jit();
+        Jit(const Jit&) : Jit() {}
+        Jit& operator=(const Jit&) { flush(); return *this; }
+
+        static bool available(); // false when not on x86-64 or the buffer cannot be mapped
+
+        Native find(uint16_t address) const {
+            auto found = code.find(address);
+            return found == code.end() ? nullptr : found->second;
+        }
+        bool compilable(uint16_t address) const;
+
+        // Copies the position independent code of a block into the buffer, flushing it when full
+        Native install(uint16_t address, const std::vector<uint8_t>& bytes);
+        void drop(uint16_t address); // the code of the block was written
+        void flush(); // forget all compiled code
+
+        size_t compiled() const { return code.size(); }
+};
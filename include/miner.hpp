@@ -0,0 +1,28 @@
+#pragma once
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <vector>
+
+// Counts the opcode sequences in an execution trace that a superinstruction could run with one dispatch,
+// and writes the best ones out as superinstructions.inc
+class SequenceMiner {
+    protected:
+        std::map<uint32_t, uint64_t> counts; // by sequence, its length in the top byte and the opcodes below, first opcode highest
+        std::vector<uint8_t> window; // the last opcodes, as long as they are fusable
+
+    public:
+        static constexpr size_t MAX_LENGTH = 3;
+
+        struct Candidate {
+            std::vector<uint8_t> opcodes;
+            uint64_t count;
+            uint64_t saved() const { return count * (opcodes.size() - 1); } // dispatches a superinstruction saves
+        };
+
+        void record(uint8_t opcode); // the next executed opcode
+        // The sequences seen at least minimum times, by dispatches saved, most first
+        std::vector<Candidate> candidates(size_t limit, uint64_t minimum = 1) const;
+        static void write(std::ostream& out, const std::vector<Candidate>& candidates);
+};
@@ -0,0 +1,39 @@
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <iostream>
+
+// Keeps the emulation at the speed of the real machine: the CPU runs a frame's worth of cycles,
+// then the pacer sleeps until that frame is due.
+class Pacer {
+    protected:
+        using Clock = std::chrono::steady_clock;
+
+        unsigned turbo;
+
+        Clock::time_point epoch; // deadlines are counted from here, so rounding never adds up
+        uint64_t frames = 0;
+        Clock::time_point frameStart;
+
+        // Statistics since the last report
+        Clock::time_point windowStart;
+        Clock::duration busy{0};
+        uint64_t cycles = 0;
+
+    public:
+        static constexpr uint64_t CLOCK_HZ = 2'000'000;
+        static constexpr uint64_t FRAME_HZ = 60;
+        static constexpr uint64_t CYCLES_PER_FRAME = CLOCK_HZ / FRAME_HZ;
+
+        // turbo runs that many frames in the time of one, 0 runs uncapped
+        explicit Pacer(unsigned turbo = 1);
+
+        // Call after every frame with the cycles it executed. Sleeps until the next frame is due,
+        // returns true once a second when there are statistics to report.
+        bool frame(uint64_t executed);
+
+        double emulatedMHz() const;
+        double hostUtilization() const; // share of the wall time spent emulating rather than sleeping, 1 is a full core
+        void report(std::ostream &out); // print the statistics and start a new window
+};
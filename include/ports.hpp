@@ -0,0 +1,74 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <initializer_list>
+
+// The 256 input and 256 output ports IN and OUT address. Devices attach to the ports they decode when the machine
+// is put together, which fills in a table of handlers by port, so an access costs one indirect call.
+// Unattached ports read 0 and ignore writes.
+class Ports {
+    public:
+        // Handlers of a port, context is handed back to them as is, also by copies of the Cpu until they rebind
+        struct Input {
+            uint8_t (*read)(void* context, uint8_t port);
+            void* context;
+        };
+        struct Output {
+            void (*write)(void* context, uint8_t port, uint8_t value);
+            void* context;
+        };
+
+    protected:
+        std::array<Input, 0x100> inputs;
+        std::array<Output, 0x100> outputs;
+
+        static uint8_t unattached(void*, uint8_t) { return 0; }
+        static void ignore(void*, uint8_t, uint8_t) {}
+
+    public:
+        Ports() {
+            inputs.fill({unattached, nullptr});
+            outputs.fill({ignore, nullptr});
+        }
+
+        uint8_t in(uint8_t port) const { return inputs[port].read(inputs[port].context, port); }
+        void out(uint8_t port, uint8_t value) const { outputs[port].write(outputs[port].context, port, value); }
+
+        Input input(uint8_t port) const { return inputs[port]; }
+        Output output(uint8_t port) const { return outputs[port]; }
+        void attach(uint8_t port, Input input) { inputs[port] = input; }
+        void attach(uint8_t port, Output output) { outputs[port] = output; }
+        void detach(uint8_t port) { attach(port, Input{unattached, nullptr}); attach(port, Output{ignore, nullptr}); }
+        // Hands the ports of the device at from to the one at to, so a copy of a Cpu gets a copy of its devices
+        void rebind(const void* from, void* to) {
+            for (Input& input : inputs) {
+                if (input.context == from) {
+                    input.context = to;
+                }
+            }
+            for (Output& output : outputs) {
+                if (output.context == from) {
+                    output.context = to;
+                }
+            }
+        }
+};
+
+// Base of the port devices, Derived defines read(port) and write(port, value). The bus calls them through handlers made
+// for Derived, where they are direct calls the compiler inlines, rather than going through a vtable.
+template<typename Derived> class PortDevice {
+    public:
+        static uint8_t readPort(void* context, uint8_t port) { return static_cast<Derived*>(context)->read(port); }
+        static void writePort(void* context, uint8_t port, uint8_t value) { static_cast<Derived*>(context)->write(port, value); }
+
+        void attach(Ports& ports, std::initializer_list<uint8_t> inputs, std::initializer_list<uint8_t> outputs) {
+            Derived* self = static_cast<Derived*>(this);
+            for (const uint8_t port : inputs) {
+                ports.attach(port, Ports::Input{readPort, self});
+            }
+            for (const uint8_t port : outputs) {
+                ports.attach(port, Ports::Output{writePort, self});
+            }
+        }
+};
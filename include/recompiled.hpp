@@ -0,0 +1,145 @@
+#pragma once
+
+#include <cstdint>
+
+#include "state.hpp"
+
+// Runtime of the C++ written by the static recompiler, see recompiler.hpp.
+// The helpers mirror the opcode families in opcodes.cpp on the public Registers and Memory interface.
+
+namespace recompiled {
+    // A recompiled basic block. Leaves PC at the next instruction to run and returns the T-states it took.
+    using Block = uint32_t (*)(Registers& regs, Memory& memory);
+
+    // Recompiled blocks by start address, null where the interpreter has to run the code
+    struct Rom {
+        const Block* blocks;
+        uint32_t size;
+    };
+
+    inline void push(Registers& regs, Memory& memory, uint16_t value) {
+        memory.write(regs.SP-1, value >> 8);
+        memory.write(regs.SP-2, value & 0xFF);
+        regs.SP -= 2;
+    }
+
+    inline uint16_t pop(Registers& regs, Memory& memory) {
+        const uint16_t value = memory.read16(regs.SP);
+        regs.SP += 2;
+        return value;
+    }
+
+    inline uint16_t psw(Registers& regs) {
+        return regs.A << 8 | regs.getF() | 0b00000010;
+    }
+
+    inline void setPsw(Registers& regs, uint16_t value) {
+        regs.A = value >> 8;
+        regs.setF(value & 0b11010101);
+    }
+
+    // op is the ALU operation in bits 3-5: ADD ADC SUB SBB ANA XRA ORA CMP
+    template<uint8_t op> inline void alu(Registers& regs, uint8_t value) {
+        uint16_t result;
+        if constexpr (op == 0) {
+            result = regs.A + value;
+            regs.setFlagsADD(result, regs.A, value);
+        } else if constexpr (op == 1) {
+            result = regs.A + value + regs.getCarry();
+            regs.setFlagsADD(result, regs.A, value);
+        } else if constexpr (op == 2 || op == 7) {
+            result = regs.A - value;
+            regs.setFlagsSUB(result, regs.A, value);
+        } else if constexpr (op == 3) {
+            result = regs.A - value - regs.getCarry();
+            regs.setFlagsSUB(result, regs.A, value);
+        } else if constexpr (op == 4) {
+            result = regs.A & value;
+            regs.setFlagsLogic(result, (regs.A | value) & 0b00001000);
+        } else {
+            result = op == 5 ? regs.A ^ value : regs.A | value;
+            regs.setFlagsLogic(result, 0);
+        }
+
+        if constexpr (op != 7) {
+            regs.A = result;
+        }
+    }
+
+    inline uint8_t inr(Registers& regs, uint8_t value) {
+        const uint16_t result = value + 1;
+        regs.setFlagsADD(result, value, 1, Registers::KEEP_CARRY);
+        return result;
+    }
+
+    inline uint8_t dcr(Registers& regs, uint8_t value) {
+        const uint16_t result = value - 1;
+        regs.setFlagsSUB(result, value, 1, Registers::KEEP_CARRY);
+        return result;
+    }
+
+    inline void dad(Registers& regs, uint16_t value) {
+        const uint32_t result = regs.readHL() + value;
+        if (result > UINT16_MAX) {
+            regs.setCarry();
+        } else {
+            regs.clearCarry();
+        }
+        regs.setHL(result);
+    }
+
+    inline void daa(Registers& regs) {
+        uint8_t correction = 0;
+        if ((regs.A & 0x0F) > 9 || regs.getAuxCarry() == 1) {
+            correction += 6;
+        }
+        if ((regs.A + correction) >> 4 > 9 || regs.getCarry() == 1) {
+            correction += 6 << 4;
+        }
+        const uint16_t result = regs.A + correction;
+        regs.setFlagsADD(result, regs.A, correction);
+        if (correction >> 4) { // CY stays set once the high digit was corrected
+            regs.setCarry();
+        }
+        regs.A = result;
+    }
+
+    inline void setCarry(Registers& regs, bool carry) {
+        if (carry) {
+            regs.setCarry();
+        } else {
+            regs.clearCarry();
+        }
+    }
+
+    inline void rlc(Registers& regs) {
+        const uint8_t bit = regs.A >> 7;
+        setCarry(regs, bit);
+        regs.A = regs.A << 1 | bit;
+    }
+
+    inline void rrc(Registers& regs) {
+        const uint8_t bit = regs.A & 0b1;
+        setCarry(regs, bit);
+        regs.A = regs.A >> 1 | bit << 7;
+    }
+
+    inline void ral(Registers& regs) {
+        const uint8_t bit = regs.A >> 7;
+        regs.A = regs.A << 1 | regs.getCarry();
+        setCarry(regs, bit);
+    }
+
+    inline void rar(Registers& regs) {
+        const uint8_t bit = regs.A & 0b1;
+        regs.A = regs.A >> 1 | regs.getCarry() << 7;
+        setCarry(regs, bit);
+    }
+
+    inline void xthl(Registers& regs, Memory& memory) {
+        const uint16_t value = memory.read16(regs.SP);
+        memory.write(regs.SP, regs.L);
+        memory.write(regs.SP+1, regs.H);
+        regs.setHL(value);
+    }
+}
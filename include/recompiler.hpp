@@ -0,0 +1,36 @@
+#pragma once
+
+#include <cstdint>
+#include <ostream>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "state.hpp"
+
+// Static recompiler: finds the code in a ROM by following the control flow from the reset and RST vectors,
+// and writes it out as C++ with one function per basic block, see recompiled.hpp for the runtime.
+// The ROM is assumed never to be written. PCHL targets and code that is not reached statically are left to the interpreter.
+class Recompiler {
+    protected:
+        const Memory& rom;
+        uint32_t size; // bytes of ROM from address 0
+
+        std::set<uint16_t> leaders; // block start addresses
+        std::vector<bool> reached; // addresses reached as an opcode
+
+        static bool interpreted(uint8_t opcode); // opcodes the generated code hands back to the interpreter
+        bool inRom(uint32_t address) const { return address < size; }
+        void analyze(const std::vector<uint16_t>& entries);
+        void emitInstruction(std::ostream& out, uint16_t address) const;
+        void emitBlock(std::ostream& out, uint16_t address) const;
+
+    public:
+        Recompiler(const Memory& rom, uint32_t size);
+
+        const std::set<uint16_t>& blocks() const { return leaders; }
+        bool isCode(uint16_t address) const { return inRom(address) && reached[address]; }
+
+        // Source defining const recompiled::Rom symbol
+        void emit(std::ostream& out, const std::string& symbol) const;
+};
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <deque>
+
+#include "cpu.hpp"
+#include "savestate.hpp"
+
+// Deterministic record and replay of everything from outside a run depends on: the values IN reads and the points
+// interrupts arrive at, plus a state hash at the end of every frame to check the replay against.
+// Events are keyed by Cpu::getCycles, so the machine has to call run only between frames and interrupts.
+// Port handlers see the cycle their IN runs at in every engine, so a PORT event is keyed by it like the others and
+// the replay checks each read comes from the same port at the same cycle, however the recording sliced its runs.
+//
+// Log format: magic "8080INPT", version u16, the cycle the recording started at u64, then events of a kind u8 and
+// the cycles since the event before as LEB128, followed by port u8 and value u8 for PORT, vector u8 for INTERRUPT,
+// the state hash u64 for FRAME, nothing for END.
+namespace replay {
+    constexpr char MAGIC[8] = {'8', '0', '8', '0', 'I', 'N', 'P', 'T'};
+    constexpr uint16_t VERSION = 1;
+    enum class Kind : uint8_t { PORT, INTERRUPT, FRAME, END };
+
+    struct Event {
+        Kind kind;
+        uint64_t cycle;
+        uint8_t port; // or the vector of an interrupt
+        uint8_t value;
+        uint64_t hash;
+    };
+}
+
+// Logs a run as it happens. While it records, the input ports of cpu go through the recorder to the devices attached.
+class InputRecorder {
+    protected:
+        SaveWriter& out;
+        Cpu& cpu;
+        std::array<Ports::Input, 0x100> live;
+        uint64_t last = 0; // cycle of the last event
+        bool finished = false;
+
+        void event(replay::Kind kind);
+        static uint8_t read(void* context, uint8_t port);
+
+    public:
+        InputRecorder(SaveWriter& out, Cpu& cpu);
+        ~InputRecorder() { finish(); }
+
+        void interrupt(uint8_t vector); // delivers it to the Cpu too
+        void frame();
+        void finish(); // ends the log and attaches the devices again
+};
+
+// Drives a Cpu from a log as fast as it runs, with no clock involved
+class InputReplay {
+    protected:
+        SaveReader& in;
+        Cpu& cpu;
+        uint64_t last = 0;
+        std::deque<replay::Event> reads; // the PORT events up to the next interrupt or frame
+        bool diverged = false;
+
+        replay::Event next();
+        static uint8_t read(void* context, uint8_t port);
+
+    public:
+        InputReplay(SaveReader& in, Cpu& cpu) : in(in), cpu(cpu) {}
+
+        // Replays the whole log from the state the recording started at. Returns the frames whose hash matched,
+        // or -1 when the log is malformed or the run diverges from it.
+        int64_t run();
+};
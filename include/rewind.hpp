@@ -0,0 +1,48 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cpu.hpp"
+
+// Steps a Cpu back through its last frames. record() after every frame stores the registers and the XOR of every
+// page written during the frame with its previous contents, see savestate::encode, in a ring of bytes allocated up front.
+// An XOR delta undoes itself, so rewind(n) applies the newest n deltas to the memory and costs O(n) frames.
+// Loading a savestate or restoring a snapshot on the Cpu invalidates what was recorded, clear() starts over.
+class Rewind {
+    protected:
+        struct Frame {
+            size_t offset; // into ring
+            size_t size;
+        };
+
+        Cpu& cpu;
+        std::vector<uint8_t> ring;
+        std::vector<Frame> frames; // a ring too, of capacity entries
+        size_t oldest = 0;
+        size_t count = 0;
+        std::vector<uint8_t> scratch; // the frame being recorded, up to every page
+
+        std::vector<uint8_t> previous; // the memory at the last record
+        Registers regs; // the registers at the last record
+        uint64_t cycles = 0;
+        std::vector<uint64_t> deadlines; // of the events
+        uint32_t recorded = 0; // memory checkpoint of the last record
+
+        size_t allocate(size_t size); // evicts the oldest frames until size bytes fit after the newest
+        void capture(); // the current state as the last record
+
+    public:
+        static constexpr size_t FRAME_BYTES = 2048; // average delta size the default ring is sized for
+
+        // Keeps up to capacity frames in bytes of deltas, fewer when the frames write a lot
+        Rewind(Cpu& cpu, size_t capacity, size_t bytes = 0);
+
+        void record();
+        size_t available() const { return count; } // frames rewind can go back
+        bool rewind(size_t frames); // false, and no change, when fewer frames are available
+        void clear();
+
+        size_t used() const; // bytes of the ring holding frames
+};
@@ -0,0 +1,29 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+// A ROM file, mapped read-only into the address space where the platform allows it and read into a buffer otherwise.
+// Load one image and hand it to every Cpu: they all copy from the same physical pages of the file.
+class RomImage {
+    protected:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+        bool isMapped = false;
+        std::vector<uint8_t> buffer; // the fallback copy when mapping fails
+
+        void release();
+
+    public:
+        RomImage() = default;
+        ~RomImage() { release(); }
+        RomImage(const RomImage&) = delete;
+        RomImage& operator=(const RomImage&) = delete;
+
+        int open(const char* path); // 0, or -1 when the file cannot be read
+
+        const uint8_t* data() const { return bytes; }
+        size_t size() const { return length; }
+        bool mapped() const { return isMapped; }
+};
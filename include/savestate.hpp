@@ -0,0 +1,68 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+// Savestate format, little endian:
+//   magic "8080SAVE", version u16, kind u8 (FULL or DELTA), base cycles u64 (0 for FULL)
+//   A F B C D E H L u8, PC SP u16, interrupt state u8 (bit 0 INTE, bit 1 halted), cycles u64
+//   event count u16, then the deadline of every scheduled event u64, Scheduler::NEVER when unscheduled
+//   page count u16, then per page: page number u8, encoded length u16, encoded bytes
+// A page is encoded as the XOR with the same page of the base, all zero for FULL, in runs:
+// a control byte c < 0x80 stands for c + 1 zero bytes, c >= 0x80 is followed by c - 0x7F literal bytes.
+// Pages equal to the base are left out. See Cpu::save and Cpu::load.
+// Version 1 had no interrupt state and no events, it loads with interrupts disabled and the events as they are.
+namespace savestate {
+    constexpr char MAGIC[8] = {'8', '0', '8', '0', 'S', 'A', 'V', 'E'};
+    constexpr uint16_t VERSION = 2;
+    enum class Kind : uint8_t { FULL, DELTA };
+
+    // XOR run-length encoding of page against base, returns the encoded length. out holds at least MAX_ENCODED bytes.
+    constexpr size_t MAX_ENCODED = 0x100 + 2; // all literals, in runs of 128
+    size_t encode(const uint8_t* page, const uint8_t* base, uint8_t* out);
+    // Applies encoded to page in place, false when it is malformed
+    bool decode(const uint8_t* encoded, size_t length, uint8_t* page);
+}
+
+// Appends a savestate to a buffer in memory or to a stream as it is encoded
+class SaveWriter {
+    protected:
+        std::vector<uint8_t>* buffer = nullptr;
+        std::ostream* stream = nullptr;
+        size_t written = 0;
+
+    public:
+        explicit SaveWriter(std::vector<uint8_t>& buffer) : buffer(&buffer) {}
+        explicit SaveWriter(std::ostream& stream) : stream(&stream) {}
+
+        void put(const uint8_t* bytes, size_t size);
+        void put8(uint8_t value) { put(&value, 1); }
+        void put16(uint16_t value);
+        void put64(uint64_t value);
+
+        size_t size() const { return written; } // bytes written so far
+        bool good() const { return stream == nullptr || stream->good(); }
+};
+
+// Reads a savestate from memory or from a stream. A short read sets failed, and every read after it returns zeros.
+class SaveReader {
+    protected:
+        const uint8_t* bytes = nullptr;
+        size_t length = 0;
+        size_t position = 0;
+        std::istream* stream = nullptr;
+        bool failed = false;
+
+    public:
+        SaveReader(const uint8_t* bytes, size_t length) : bytes(bytes), length(length) {}
+        explicit SaveReader(std::istream& stream) : stream(&stream) {}
+
+        bool get(uint8_t* out, size_t size);
+        uint8_t get8();
+        uint16_t get16();
+        uint64_t get64();
+
+        bool good() const { return !failed; }
+};
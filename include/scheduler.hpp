@@ -0,0 +1,57 @@
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+class Cpu;
+
+// Device events keyed by the absolute cycle they are due at, in a binary min-heap. Cpu::run runs the engine flat out
+// up to the earliest deadline and fires what is due there, so a device costs nothing between its events.
+// Every event knows its place in the heap, so rescheduling and cancelling are O(log n) like adding.
+// The deadlines are part of the machine state: snapshots, savestates and rewind keep them.
+class Scheduler {
+    public:
+        static constexpr uint64_t NEVER = UINT64_MAX;
+        using Event = uint32_t;
+        // Called at the first instruction boundary at or past cycle, the deadline it was due at.
+        // Returns its next deadline, NEVER to leave it unscheduled. context is handed back as is, also by copies of the Cpu.
+        using Callback = uint64_t (*)(void* context, Cpu& cpu, uint64_t cycle);
+
+    protected:
+        struct Entry {
+            Callback callback;
+            void* context;
+            uint64_t cycle; // NEVER while unscheduled
+            uint32_t position; // in heap
+        };
+        std::vector<Entry> events;
+        std::vector<Event> heap; // earliest first, ties in the order the events were added so runs are repeatable
+
+        bool before(Event a, Event b) const {
+            return events[a].cycle < events[b].cycle || (events[a].cycle == events[b].cycle && a < b);
+        }
+        void place(uint32_t position, Event event) {
+            heap[position] = event;
+            events[event].position = position;
+        }
+        void siftUp(uint32_t position);
+        void siftDown(uint32_t position);
+
+    public:
+        Event add(Callback callback, void* context = nullptr); // unscheduled
+        void schedule(Event event, uint64_t cycle); // moves it when it is scheduled already
+        void cancel(Event event);
+
+        bool scheduled(Event event) const { return events[event].cycle != NEVER; }
+        uint64_t deadline(Event event) const { return events[event].cycle; }
+        uint32_t size() const { return events.size(); } // events added, scheduled or not
+        uint64_t next() const { return heap.empty() ? NEVER : events[heap.front()].cycle; }
+
+        // Every deadline by event, for snapshots and savestates. Setting them leaves the events beyond the list alone.
+        std::vector<uint64_t> deadlines() const;
+        void deadlines(std::vector<uint64_t>& cycles) const; // into cycles, which keeps its capacity
+        void setDeadlines(const std::vector<uint64_t>& cycles);
+
+        // Fires every event due at now or before, the earliest first, including those the callbacks make due
+        void run(Cpu& cpu, uint64_t now);
+};
@@ -1,35 +1,206 @@
 #pragma once
 
+#include <array>
+#include <bit>
+#include <cstddef>
 #include <cstdint>
 #include <iostream>
+#include <vector>
 
+// 64 KiB address space behind a table of 256 byte pages. A page reads and writes backing storage through
+// two pointers, or calls the handlers of a memory mapped device. Every page starts as RAM at its own address.
 class Memory {
+    public:
+        static constexpr uint32_t PAGE_SIZE = 0x100;
+        static constexpr uint32_t PAGES = 0x100;
+        static constexpr uint32_t LINE_SIZE = 32; // granularity of watchLines, a scanline of the invaders VRAM
+
+        // A memory mapped device, context is handed back to the handlers as is, also by copies of the Memory
+        struct Io {
+            uint8_t (*read)(void* context, uint16_t address);
+            void (*write)(void* context, uint16_t address, uint8_t value);
+            void* context;
+        };
+
     protected:
-        uint8_t data[0x10000] = {0};
+        static constexpr uint32_t DISCARDED = 0x10000;
+        uint8_t data[DISCARDED + PAGE_SIZE] = {0}; // storage of the RAM and ROM pages, each at its own address, then the page writes to ROM land in
+        uint8_t* discarded() { return data + DISCARDED; }
+        const uint8_t* discarded() const { return data + DISCARDED; }
+
+        struct Page {
+            const uint8_t* read; // null for I/O
+            uint8_t* write; // discarded() for ROM, null for I/O
+        };
+        std::array<Page, PAGES> pages;
+        std::array<Io, PAGES> devices{};
+
+        // Every write stamps its page with the epoch, so any number of observers can tell what changed since their checkpoint
+        std::array<uint32_t, PAGES> writtenAt{};
+        uint32_t epoch = 1;
+        uint32_t clean = 0; // checkpoint of the last restore or clearDirty
+        void markDirty(uint8_t page) { writtenAt[page] = epoch; }
+
+        // Every storage page keeps the sum of BYTE_HASHES[byte] * weight(address) over its bytes, and root the sum of all of them.
+        // A write adds the change of a single byte to both, so neither is ever computed from scratch. The weights are odd,
+        // so a single byte that differs always changes the hash. Discarded writes are taken back out in hash().
+        std::array<uint64_t, PAGES + 1> pageHashes{};
+        uint64_t root = 0;
+        static constexpr std::array<uint64_t, 0x100> BYTE_HASHES = [] {
+            std::array<uint64_t, 0x100> table{}; // zero stays 0, so blank memory hashes to 0
+            uint64_t state = 0;
+            for (int value = 1; value < 0x100; value++) {
+                uint64_t x = state += 0x9E3779B97F4A7C15; // splitmix64
+                x = (x ^ x >> 30) * 0xBF58476D1CE4E5B9;
+                x = (x ^ x >> 27) * 0x94D049BB133111EB;
+                table[value] = x ^ x >> 31;
+            }
+            return table;
+        }();
+        static uint64_t weight(uint32_t address) { return (uint64_t(address) << 1 | 1) * 0x9E3779B97F4A7C15; }
+        void store(uint8_t* byte, uint8_t value) {
+            const uint32_t address = byte - data;
+            const uint64_t change = (BYTE_HASHES[value] - BYTE_HASHES[*byte]) * weight(address);
+            *byte = value;
+            pageHashes[address >> 8] += change;
+            root += change;
+        }
+        void rehash(uint8_t page); // of a storage page after a bulk copy into it
+
+        // Pages whose writes take the slow path to be seen: CODE the block cache translated code from, a write to one is
+        // queued until the cache drops its blocks, and LINES in a range given to watchLines
+        static constexpr uint8_t CODE = 1, LINES = 2;
+        std::array<uint8_t, PAGES> watched{};
+        std::vector<uint8_t> writtenCodePages;
+
+        // A bit per line of the storage pages watched, set by every write to it
+        std::array<uint64_t, DISCARDED / LINE_SIZE / 64> writtenLines{};
+        void linesWritten(uint32_t address, uint32_t size); // of storage
+
+        [[gnu::cold]] uint8_t readIo(uint16_t address) const;
+        [[gnu::cold]] void writeSlow(uint16_t address, uint8_t value);
+        void codeWritten(uint8_t page); // queues the page and every mirror of it
+        void copyMap(const Memory& other); // pages that point into other point into this instead
+
     public:
-        void write(uint16_t address, uint8_t value);
-        uint8_t read(uint16_t address) const;
+        Memory();
+        Memory(const Memory& other);
+        Memory& operator=(const Memory& other);
+
+        // The map, in whole pages
+        void mapRam(uint16_t address, uint32_t size);
+        void mapRom(uint16_t address, uint32_t size); // write protects the bytes already there
+        void mapRom(uint16_t address, const uint8_t* bytes, uint32_t size); // reads bytes in place, they must outlive every copy
+        void mirror(uint16_t address, uint32_t size, uint16_t target); // the pages at target show up at address too
+        void mapIo(uint16_t address, uint32_t size, Io device);
+        const uint8_t* page(uint8_t page) const { return pages[page].read; } // its 256 bytes in place, null for I/O
+        uint8_t storage(uint8_t page) const; // the page whose storage it uses, itself unless it is a mirror
+        bool writable(uint16_t address) const { return pages[address >> 8].write != nullptr && pages[address >> 8].write != discarded(); }
+
+        // One lookup in the page table, I/O and watched code take the slow path
+        uint8_t read(uint16_t address) const {
+            const Page& page = pages[address >> 8];
+            if (page.read == nullptr) [[unlikely]] {
+                return readIo(address);
+            }
+            return page.read[address & 0xFF];
+        }
+        void write(uint16_t address, uint8_t value) {
+            const Page& page = pages[address >> 8];
+            if (page.write == nullptr || watched[address >> 8]) [[unlikely]] {
+                writeSlow(address, value);
+            } else {
+                store(page.write + (address & 0xFF), value);
+                markDirty(address >> 8);
+            }
+        }
         uint16_t read16(uint16_t address) const;
+        void watchCode(uint16_t address); // ROM never changes, only RAM pages are watched
+        std::vector<uint8_t>& codeWrites() { return writtenCodePages; } // cleared by the block cache
+
+        // Lines of LINE_SIZE bytes written since they were last cleared, in the RAM pages given to watchLines and every
+        // mirror of them. Writes to these pages take the slow path, all others cost the same as before.
+        // Watching starts with every line marked written. Loads and restores mark the lines they copy.
+        void watchLines(uint16_t address, uint32_t size);
+        bool lineWritten(uint16_t address) const {
+            const uint32_t line = (storage(address >> 8) * PAGE_SIZE + (address & 0xFF)) / LINE_SIZE;
+            return writtenLines[line / 64] >> line % 64 & 1;
+        }
+        void clearLines(uint16_t address, uint32_t size);
+
+        // Pages written after checkpoint() returned, seen through the address they were written at
+        uint32_t checkpoint() { return epoch++; }
+        bool writtenSince(uint8_t page, uint32_t checkpoint) const { return writtenAt[page] > checkpoint; }
+
+        // Hash of the memory contents in O(1), equal for memories with the same map and bytes
+        uint64_t hash() const { return root - pageHashes[PAGES]; }
+        uint64_t pageHash(uint8_t page) const { return pageHashes[storage(page)]; } // of the storage behind page
+
+        // Dirty pages, what a restore has to copy back
+        bool dirty(uint8_t page) const { return writtenSince(page, clean); }
+        std::vector<uint8_t> dirtyPages() const;
+        void clearDirty() { clean = checkpoint(); }
+        // Copies the dirty pages back from snapshot, or every page when all, and clears them.
+        // snapshot must have the same map and agree with this memory on every clean page unless all is set.
+        void restore(const Memory& snapshot, bool all = false);
+
+        // Bulk write into the storage behind the map, ROM included, cut off at the top of memory. Skips I/O and shared ROM.
+        void load(const uint8_t* bytes, size_t size, uint16_t address = 0);
 };
 
 class Registers {
+    friend class Cpu; // the JIT tests F in place when the flags are eager
+
     protected:
         uint16_t readPair(uint8_t high, uint8_t low);
         void setPair(uint8_t *high, uint8_t *low, uint16_t value);
 
+        uint8_t F; // Flag register, 5 bits: zero, carry, sign, parity and auxiliary carry
+
+        enum class FlagOp : uint8_t { FLAGS, ADD, SUB, LOGIC };
+        template<FlagOp op> static uint8_t flagsOf(uint16_t result, uint8_t a, uint8_t b); // all 5 flags, from the tables
+        static uint8_t enableMask(bool enableZero, bool enableSign, bool enableParity, bool enableCarry, bool enableAuxCarry);
+        template<FlagOp op> void apply(uint8_t mask, uint16_t result, uint8_t a, uint8_t b); // set the flags in mask
+
+#if defined(LAZY_FLAGS)
+        // apply() only records the last operation, F is brought up to date when one of its flags is read or changed
+        FlagOp lazyOp;
+        uint8_t lazyMask; // flags set by the recorded operation that are not in F yet
+        uint16_t lazyResult;
+        uint8_t lazyA, lazyB;
+
+        void resolveFlags();
+        void resolveFlags(uint8_t flags) { if (lazyMask & flags) resolveFlags(); }
+#else
+        void resolveFlags(uint8_t) {}
+#endif
 
     public:
         Registers();
 
         uint8_t B, C, D, E, H, L; // addressable in pairs B,C; D,E; H,L
         uint8_t A; // Accumulator
-        uint8_t F; // Flag register, 5 bits: zero, carry, sign, parity and auxiliary carry
 
+        static constexpr uint8_t SIGN_FLAG = 0b10000000;
+        static constexpr uint8_t ZERO_FLAG = 0b01000000;
+        static constexpr uint8_t AUX_CARRY_FLAG = 0b00010000;
+        static constexpr uint8_t PARITY_FLAG = 0b00000100;
+        static constexpr uint8_t CARRY_FLAG = 0b00000001;
+
+        // The flags an arithmetic operation sets. A type of its own, so the bools that used to follow b do not convert.
+        struct FlagMask { uint8_t flags; };
+        static constexpr FlagMask ALL_FLAGS{SIGN_FLAG | ZERO_FLAG | AUX_CARRY_FLAG | PARITY_FLAG | CARRY_FLAG};
+        static constexpr FlagMask KEEP_CARRY{SIGN_FLAG | ZERO_FLAG | AUX_CARRY_FLAG | PARITY_FLAG}; // INR and DCR
+
+        uint8_t getF(); // packed flags, as pushed by PUSH PSW
+        void setF(uint8_t value);
+
+        // Flags with a disabled enable argument or outside mask keep their value. The carry or borrow going in is part
+        // of result.
         void setFlags(uint16_t result, bool enableZero = 1, bool enableSign = 1, bool enableParity = 1, bool enableCarry = 1);
-        void setFlagsADD(uint16_t result, uint8_t a, uint8_t b, bool carry = 0,
-                         bool enableZero = 1, bool enableSign = 1, bool enableParity = 1, bool enableCarry = 1, bool enableAuxCarry = 1);
-        void setFlagsSUB(uint16_t result, uint8_t a, uint8_t b, bool borrow = 0,
-                         bool enableZero = 1, bool enableSign = 1, bool enableParity = 1, bool enableCarry = 1, bool enableAuxCarry = 1);
+        void setFlagsADD(uint16_t result, uint8_t a, uint8_t b, FlagMask mask = ALL_FLAGS);
+        void setFlagsSUB(uint16_t result, uint8_t a, uint8_t b, FlagMask mask = ALL_FLAGS);
+        void setFlagsLogic(uint8_t result, bool auxCarry); // ANA, XRA, ORA and friends: zero, sign, parity, CY unset
 
         uint8_t getZero();
         void setZero();
@@ -54,6 +225,15 @@ class Registers {
 
         uint16_t PC, SP; // Program counter, stack pointer
 
+        // Interrupt state, outside the register file proper
+        bool interruptsEnabled; // INTE, set by EI, cleared by DI and by taking an interrupt
+        bool halted; // in HLT, waiting for an interrupt
+        uint8_t interruptState() const { return interruptsEnabled | halted << 1; } // as saved
+        void setInterruptState(uint8_t value) {
+            interruptsEnabled = value & 1;
+            halted = value >> 1 & 1;
+        }
+
         uint16_t readBC() { return readPair(B, C); };
         void setBC(uint16_t value) { setPair(&B, &C, value); }
 
@@ -64,3 +244,77 @@ class Registers {
         void setHL(uint16_t value) { setPair(&H, &L, value); }
 };
 
+// FLAGS, inline so the lookups end up in the opcode handlers
+
+namespace flagTables {
+    // Zero, sign and parity flag of every 8 bit result
+    inline constexpr std::array<uint8_t, 0x100> ZSP = [] {
+        std::array<uint8_t, 0x100> table{};
+        for (int value = 0; value < 0x100; value++) {
+            table[value] = (value == 0 ? Registers::ZERO_FLAG : 0)
+                         | (value & Registers::SIGN_FLAG)
+                         | (std::popcount((uint8_t)value) % 2 == 0 ? Registers::PARITY_FLAG : 0);
+        }
+        return table;
+    }();
+
+    /* AuxCarry flag, the carry out of (or borrow into) bit 3. Bit 3 of the result is bit 3 of both operands plus the carry
+       that came up from the lower bits, so bit 3 of a, b and the result tell if the lower nibble overflowed or borrowed. */
+    inline constexpr uint8_t AC = Registers::AUX_CARRY_FLAG;
+    inline constexpr uint8_t HALF_CARRY_ADD[8] = {0, 0, AC, 0, AC, 0, AC, AC};
+    inline constexpr uint8_t HALF_BORROW_SUB[8] = {0, AC, AC, AC, 0, 0, 0, AC};
+
+    constexpr uint8_t halfIndex(uint8_t a, uint8_t b, uint16_t result) {
+        return (a & 0x08) >> 1 | (b & 0x08) >> 2 | (result & 0x08) >> 3;
+    }
+}
+
+template<Registers::FlagOp op> inline uint8_t Registers::flagsOf(uint16_t result, uint8_t a, uint8_t b) {
+    using namespace flagTables;
+    /* The carry is bit 8 for addition and subtraction. If the addition overflows the 8 bit value it lands in bit 8,
+       and if the subtraction borrows it underflows the 16 bit int, setting all of the upper bits. */
+    const uint8_t flags = ZSP[(uint8_t)result] | ((result >> 8) & CARRY_FLAG);
+    if constexpr (op == FlagOp::ADD) {
+        return flags | HALF_CARRY_ADD[halfIndex(a, b, result)];
+    } else if constexpr (op == FlagOp::SUB) {
+        return flags | HALF_BORROW_SUB[halfIndex(a, b, result)];
+    } else if constexpr (op == FlagOp::LOGIC) {
+        return ZSP[(uint8_t)result] | a; // a holds AC, CY is unset
+    } else {
+        return flags;
+    }
+}
+
+inline uint8_t Registers::enableMask(bool enableZero, bool enableSign, bool enableParity, bool enableCarry, bool enableAuxCarry) {
+    return enableZero * ZERO_FLAG | enableSign * SIGN_FLAG | enableParity * PARITY_FLAG
+         | enableCarry * CARRY_FLAG | enableAuxCarry * AUX_CARRY_FLAG;
+}
+
+template<Registers::FlagOp op> inline void Registers::apply(uint8_t mask, uint16_t result, uint8_t a, uint8_t b) {
+#if defined(LAZY_FLAGS)
+    resolveFlags(lazyMask & ~mask); // flags the new operation keeps have to come from the recorded one first
+    lazyOp = op;
+    lazyMask = mask;
+    lazyResult = result;
+    lazyA = a;
+    lazyB = b;
+#else
+    F = (F & ~mask) | (flagsOf<op>(result, a, b) & mask);
+#endif
+}
+
+inline void Registers::setFlags(uint16_t result, bool enableZero, bool enableSign, bool enableParity, bool enableCarry) {
+    apply<FlagOp::FLAGS>(enableMask(enableZero, enableSign, enableParity, enableCarry, 0), result, 0, 0);
+}
+
+inline void Registers::setFlagsADD(uint16_t result, uint8_t a, uint8_t b, FlagMask mask) {
+    apply<FlagOp::ADD>(mask.flags, result, a, b);
+}
+
+inline void Registers::setFlagsSUB(uint16_t result, uint8_t a, uint8_t b, FlagMask mask) {
+    apply<FlagOp::SUB>(mask.flags, result, a, b);
+}
+
+inline void Registers::setFlagsLogic(uint8_t result, bool auxCarry) {
+    apply<FlagOp::LOGIC>(SIGN_FLAG | ZERO_FLAG | AUX_CARRY_FLAG | PARITY_FLAG | CARRY_FLAG, result, auxCarry * AUX_CARRY_FLAG, 0);
+}
@@ -0,0 +1,102 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "invaders.hpp"
+#include "state.hpp"
+
+// The invaders monitor is turned 90 degrees in the cabinet: VRAM holds 224 lines of 256 pixels, bit 0 of each byte first,
+// drawn bottom to top and left to right. The image here is upright, rows top to bottom.
+namespace video {
+    constexpr uint32_t WIDTH = 224;
+    constexpr uint32_t HEIGHT = 256;
+    constexpr uint32_t LINE = HEIGHT / 8; // bytes of VRAM per column of the image
+    static_assert(WIDTH * LINE == invaders::VRAM_SIZE);
+
+    // A pixel of an RGBA image, the bytes R G B A in memory order on the little endian hosts this runs on
+    constexpr uint32_t rgba(uint8_t r, uint8_t g, uint8_t b, uint8_t a = 0xFF) {
+        return r | g << 8 | b << 16 | uint32_t(a) << 24;
+    }
+    constexpr uint32_t BLACK = rgba(0, 0, 0);
+    constexpr uint32_t WHITE = rgba(0xFF, 0xFF, 0xFF);
+
+    // Rows [top, bottom) and columns [left, right) of the image that show lit pixels in color
+    struct Band {
+        uint16_t top, bottom, left, right;
+        uint32_t color; // opaque
+    };
+
+    // The strips of cellophane on the cabinet's screen: red over the saucer, green over the shields, the cannon
+    // and the lives
+    inline const std::vector<Band> OVERLAY = {
+        {32, 64, 0, WIDTH, rgba(0xFF, 0x20, 0x20)},
+        {184, 240, 0, WIDTH, rgba(0x20, 0xFF, 0x20)},
+        {240, HEIGHT, 16, 134, rgba(0x20, 0xFF, 0x20)},
+    };
+
+    // Colors of lit pixels, unlit ones are black. The distinct rows of the overlay are stored once.
+    struct Palette {
+        const uint32_t* colors;
+        const uint8_t* grays; // luma of colors
+        const uint32_t* rows; // offset of each image row in colors and grays
+    };
+
+    // Columns are converted in blocks of BLOCK, bit i of a block mask stands for columns from i * BLOCK
+    constexpr uint32_t BLOCK = 16;
+    constexpr uint32_t ALL_BLOCKS = (1 << WIDTH / BLOCK) - 1;
+
+    // One pair of kernels per instruction set, the ones the build or the host lacks are null.
+    // vram is VRAM_SIZE bytes, out WIDTH * HEIGHT pixels of which the columns in blocks are written.
+    struct Kernels {
+        void (*rgba)(const uint8_t* vram, uint32_t* out, const Palette& palette, uint32_t blocks);
+        void (*gray)(const uint8_t* vram, uint8_t* out, const Palette& palette, uint32_t blocks);
+    };
+    extern const Kernels* const scalar;
+    extern const Kernels* const sse;
+    extern const Kernels* const avx2;
+
+    enum class Isa { SCALAR, SSE, AVX2, BEST };
+
+    // Part of the image that changed
+    struct Rect {
+        uint16_t x, y, width, height;
+        bool operator==(const Rect&) const = default;
+    };
+}
+
+// Expands and rotates the invaders VRAM into an image the caller owns, with the overlay colors in the same pass
+class Video {
+    protected:
+        std::vector<uint32_t> colors;
+        std::vector<uint8_t> grays;
+        std::array<uint32_t, video::HEIGHT> rows;
+
+        const video::Kernels* kernels;
+        video::Isa instructionSet;
+
+        video::Palette palette() const { return {colors.data(), grays.data(), rows.data()}; }
+        static const uint8_t* vram(const Memory& memory, uint8_t* copy); // in place when the pages are contiguous
+        // The columns written since the last call as rectangles, and the blocks they are in. Clears them.
+        static std::vector<video::Rect> written(Memory& memory, uint32_t& blocks);
+
+    public:
+        explicit Video(const std::vector<video::Band>& overlay = video::OVERLAY, video::Isa wanted = video::Isa::BEST);
+
+        static bool available(video::Isa wanted); // compiled in and supported by the host
+        video::Isa getIsa() const { return instructionSet; }
+
+        // WIDTH * HEIGHT pixels, row by row
+        void rgba(const Memory& memory, uint32_t* out) const;
+        void gray(const Memory& memory, uint8_t* out) const;
+        void rgba(const uint8_t* vram, uint32_t* out) const { kernels->rgba(vram, out, palette(), video::ALL_BLOCKS); }
+        void gray(const uint8_t* vram, uint8_t* out) const { kernels->gray(vram, out, palette(), video::ALL_BLOCKS); }
+
+        // Dirty tracking: once memory watches the VRAM lines, update converts only the columns of the image whose line
+        // was written since the update before, clears them, and returns the changed columns as rectangles, left to
+        // right. out has to hold what that update left there. The first update after watch converts everything.
+        static void watch(Memory& memory) { memory.watchLines(invaders::VRAM, invaders::VRAM_SIZE); }
+        std::vector<video::Rect> update(Memory& memory, uint32_t* out) const;
+        std::vector<video::Rect> update(Memory& memory, uint8_t* out) const;
+};
@@ -0,0 +1,231 @@
+#include "batch.hpp"
+#include "isa.hpp"
+
+namespace {
+    constexpr uint8_t OPERAND = 6; // where the M and d8 operands go, the register encoding of M
+
+    size_t roundUp(size_t lanes) {
+        return (lanes + batch::WIDTH - 1) / batch::WIDTH * batch::WIDTH;
+    }
+}
+
+Batch::Batch(const std::vector<Cpu>& machines, batch::Isa wanted)
+    : count(machines.size()), padded(roundUp(machines.size())), cpus(machines),
+      F(padded), PC(padded), SP(padded), cycles(padded), mask(padded) {
+    for (std::vector<uint8_t>& lanes : r) {
+        lanes.resize(padded);
+    }
+    for (size_t i = 0; i < count; i++) {
+        save(i);
+        cycles[i] = cpus[i].cycles;
+    }
+
+    if (wanted == batch::Isa::BEST) {
+        wanted = available(batch::Isa::AVX2) ? batch::Isa::AVX2 : available(batch::Isa::SSE) ? batch::Isa::SSE : batch::Isa::SCALAR;
+    } else if (!available(wanted)) {
+        wanted = batch::Isa::SCALAR;
+    }
+    instructionSet = wanted;
+    kernel = wanted == batch::Isa::AVX2 ? batch::avx2 : wanted == batch::Isa::SSE ? batch::sse : batch::scalar;
+}
+
+Batch::Batch(const Cpu& boot, size_t count, batch::Isa wanted) : Batch(std::vector<Cpu>(count, boot), wanted) {}
+
+bool Batch::available(batch::Isa wanted) {
+    switch (wanted) {
+#if defined(__x86_64__) || defined(__i386__)
+        case batch::Isa::SSE: return batch::sse != nullptr && __builtin_cpu_supports("ssse3");
+        case batch::Isa::AVX2: return batch::avx2 != nullptr && __builtin_cpu_supports("avx2");
+#else
+        case batch::Isa::SSE:
+        case batch::Isa::AVX2: return false;
+#endif
+        default: return true;
+    }
+}
+
+void Batch::load(size_t lane) {
+    Registers& regs = cpus[lane].regs;
+    regs.B = r[0][lane];
+    regs.C = r[1][lane];
+    regs.D = r[2][lane];
+    regs.E = r[3][lane];
+    regs.H = r[4][lane];
+    regs.L = r[5][lane];
+    regs.A = r[7][lane];
+    regs.setF(F[lane]);
+    regs.PC = PC[lane];
+    regs.SP = SP[lane];
+}
+
+void Batch::save(size_t lane) {
+    Registers& regs = cpus[lane].regs;
+    r[0][lane] = regs.B;
+    r[1][lane] = regs.C;
+    r[2][lane] = regs.D;
+    r[3][lane] = regs.E;
+    r[4][lane] = regs.H;
+    r[5][lane] = regs.L;
+    r[7][lane] = regs.A;
+    F[lane] = regs.getF();
+    PC[lane] = regs.PC;
+    SP[lane] = regs.SP;
+}
+
+const Cpu& Batch::lane(size_t index) {
+    load(index);
+    cpus[index].cycles = cycles[index];
+    return cpus[index];
+}
+
+bool Batch::shared(uint16_t address, uint8_t length) {
+    for (uint16_t page : {address >> 8, uint16_t(address + length - 1) >> 8}) {
+        if (pages[page] == Page::UNKNOWN) {
+            pages[page] = Page::SHARED;
+            for (size_t i = 0; i < count; i++) {
+                cpus[i].memory.watchCode(page << 8);
+                for (uint32_t byte = page << 8; byte < (page + 1u) << 8 && pages[page] == Page::SHARED; byte++) {
+                    if (cpus[i].memory.read(byte) != cpus[0].memory.read(byte)) {
+                        pages[page] = Page::PRIVATE;
+                    }
+                }
+            }
+        }
+        if (pages[page] == Page::PRIVATE) {
+            return false;
+        }
+    }
+    return true;
+}
+
+void Batch::checkWrites(size_t lane) {
+    std::vector<uint8_t>& written = cpus[lane].memory.codeWrites();
+    for (uint8_t page : written) {
+        pages[page] = Page::PRIVATE;
+    }
+    written.clear();
+}
+
+void Batch::run(uint64_t budget) {
+    std::vector<uint64_t> target(count);
+    for (size_t i = 0; i < count; i++) {
+        target[i] = cycles[i] + budget;
+    }
+
+    while (true) {
+        // The lowest PC of the lanes still running goes next, lanes behind a branch catch up with the others.
+        // Events due in a lane fire first, at the same instruction boundaries as in Cpu::run.
+        uint32_t leader = UINT32_MAX;
+        size_t first = 0;
+        for (size_t i = 0; i < count; i++) {
+            if (cycles[i] >= cpus[i].scheduler.next()) {
+                fireEvents(i);
+            }
+            if (cycles[i] < target[i] && PC[i] < leader) {
+                leader = PC[i];
+                first = i;
+            }
+        }
+        if (leader == UINT32_MAX) {
+            break;
+        }
+
+        // Lanes whose memory holds other code there wait for another turn
+        const uint8_t opcode = cpus[first].memory.read(leader);
+        const bool same = shared(leader, isa::opcodes[opcode].length);
+        for (size_t i = 0; i < count; i++) {
+            mask[i] = cycles[i] < target[i] && PC[i] == leader && (same || cpus[i].memory.read(leader) == opcode) ? 0xFF : 0;
+        }
+        execute(opcode, leader, same ? &cpus[first].memory : nullptr);
+    }
+}
+
+void Batch::fireEvents(size_t lane) {
+    Cpu& cpu = cpus[lane];
+    load(lane);
+    cpu.cycles = cycles[lane];
+    cpu.fireEvents();
+    cycles[lane] = cpu.cycles;
+    save(lane);
+    checkWrites(lane);
+}
+
+void Batch::execute(uint8_t opcode, uint16_t address, const Memory* code) {
+    const isa::Opcode& info = isa::opcodes[opcode];
+    const uint8_t ddd = (opcode >> 3) & 0b111;
+    const uint8_t sss = opcode & 0b111;
+    // Operands come from the shared code when there is one, from each lane's memory otherwise
+    const uint8_t d8 = code ? code->read(address + 1) : 0;
+    const uint16_t d16 = code ? code->read16(address + 1) : 0;
+
+    if (!batch::vectorized(opcode)) {
+        for (size_t i = 0; i < count; i++) {
+            if (!mask[i]) {
+                continue;
+            }
+            const uint16_t operand = code ? d16 : cpus[i].memory.read16(address + 1);
+            if ((opcode & 0b11110111) == 0b11000011 || (opcode & 0b11000111) == 0b11000010) { // JMP, Jcc
+                static constexpr uint8_t FLAGS[4] = {Registers::ZERO_FLAG, Registers::CARRY_FLAG, Registers::PARITY_FLAG, Registers::SIGN_FLAG};
+                const bool taken = opcode & 1 || ((F[i] & FLAGS[ddd >> 1]) != 0) == (ddd & 1);
+                PC[i] = taken ? operand : address + 3;
+            } else if ((opcode & 0b11001111) == 0b00000001) { // LXI
+                if (opcode >> 4 == 3) {
+                    SP[i] = operand;
+                } else {
+                    r[2 * (opcode >> 4)][i] = operand >> 8;
+                    r[2 * (opcode >> 4) + 1][i] = operand & 0xFF;
+                }
+                PC[i] = address + 3;
+            } else {
+                load(i);
+                cpus[i].cycles = cycles[i]; // IN and OUT go through here, devices read the clock
+                cycles[i] += cpus[i].step();
+                save(i);
+                checkWrites(i);
+                scalarSteps++;
+                continue;
+            }
+            cycles[i] += info.cycles;
+            lockstepSteps++;
+        }
+        return;
+    }
+
+    // Gather the operand, run the kernel, and scatter a result that goes to memory
+    const bool mov = opcode >= 0x40 && opcode <= 0x7F;
+    const bool incDec = opcode == 0x34 || opcode == 0x35; // INR M, DCR M
+    const bool readsM = ((mov || (opcode >= 0x80 && opcode <= 0xBF)) && sss == OPERAND) || incDec;
+    const bool writesM = (mov && ddd == OPERAND) || opcode == 0x36 || incDec;
+    std::vector<uint8_t>& operand = r[OPERAND];
+    if (info.length == 2 || readsM) {
+        for (size_t i = 0; i < count; i++) {
+            if (!mask[i]) {
+                continue;
+            }
+            if (info.length == 2) {
+                operand[i] = code ? d8 : cpus[i].memory.read(address + 1);
+            } else {
+                operand[i] = cpus[i].memory.read(r[4][i] << 8 | r[5][i]);
+            }
+        }
+    }
+
+    const batch::Lanes lanes = {
+        {r[0].data(), r[1].data(), r[2].data(), r[3].data(), r[4].data(), r[5].data(), r[6].data(), r[7].data()},
+        F.data(), mask.data(), padded
+    };
+    kernel(opcode, lanes);
+
+    for (size_t i = 0; i < count; i++) {
+        if (!mask[i]) {
+            continue;
+        }
+        if (writesM) {
+            cpus[i].memory.write(r[4][i] << 8 | r[5][i], operand[i]);
+            checkWrites(i);
+        }
+        PC[i] = address + info.length;
+        cycles[i] += info.cycles;
+        lockstepSteps++;
+    }
+}
@@ -0,0 +1,33 @@
+#include "batchKernels.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+    // 32 lanes per register
+    struct Avx2 {
+        using V = __m256i;
+        static constexpr size_t WIDTH = 32;
+
+        static V load(const uint8_t* p) { return _mm256_loadu_si256(reinterpret_cast<const __m256i*>(p)); }
+        static void store(uint8_t* p, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(p), v); }
+        static V set(uint8_t value) { return _mm256_set1_epi8(value); }
+        static V add(V a, V b) { return _mm256_add_epi8(a, b); }
+        static V sub(V a, V b) { return _mm256_sub_epi8(a, b); }
+        static V band(V a, V b) { return _mm256_and_si256(a, b); }
+        static V bor(V a, V b) { return _mm256_or_si256(a, b); }
+        static V bxor(V a, V b) { return _mm256_xor_si256(a, b); }
+        static V bnot(V a) { return _mm256_xor_si256(a, _mm256_set1_epi8(-1)); }
+        static V isZero(V a) { return _mm256_cmpeq_epi8(a, _mm256_setzero_si256()); }
+        static V blend(V old, V value, V mask) { return _mm256_blendv_epi8(old, value, mask); }
+        template<int n> static V shiftRight(V a) { return _mm256_and_si256(_mm256_srli_epi16(a, n), _mm256_set1_epi8(0xFF >> n)); }
+        static V lookup(const uint8_t* table, V index) { // the table in both 128 bit halves, shuffle_epi8 stays within them
+            return _mm256_shuffle_epi8(_mm256_broadcastsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table))), index);
+        }
+    };
+}
+
+const batch::Kernel batch::avx2 = &Kernels<Avx2>::run;
+#else
+const batch::Kernel batch::avx2 = nullptr;
+#endif
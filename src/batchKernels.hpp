@@ -0,0 +1,115 @@
+#pragma once
+
+// Kernels of the batch engine, written once against an instruction set policy P with a vector type V
+// of P::WIDTH bytes. Each of batchScalar.cpp, batchSse.cpp and batchAvx2.cpp includes this with its own
+// policy and compiler flags, so everything here has internal linkage: no copy built for AVX2 can be
+// picked by the linker for code that runs on a host without it.
+
+#include "batch.hpp"
+
+namespace {
+    template<typename P> struct Kernels {
+        using V = typename P::V;
+
+        static V bit7(V a) { // 1 in every byte with bit 7 set
+            return P::band(P::template shiftRight<7>(a), P::set(1));
+        }
+
+        // Zero, sign and parity flag of every byte, as flagTables::ZSP
+        static V zsp(V result) {
+            static constexpr uint8_t ODD[16] = {0, 4, 4, 0, 4, 0, 0, 4, 4, 0, 0, 4, 0, 4, 4, 0}; // nibbles with odd parity
+            const V zero = P::band(P::isZero(result), P::set(Registers::ZERO_FLAG));
+            const V sign = P::band(result, P::set(Registers::SIGN_FLAG));
+            const V odd = P::bxor(P::lookup(ODD, P::band(result, P::set(0x0F))), P::lookup(ODD, P::template shiftRight<4>(result)));
+            return P::bor(P::bor(zero, sign), P::bxor(odd, P::set(Registers::PARITY_FLAG)));
+        }
+
+        // Carry out of bit 3, the way Registers::flagsOf finds it from bit 3 of a, b and the result
+        static V auxCarry(V a, V b, V result) {
+            return P::band(P::bxor(P::bxor(a, b), result), P::set(Registers::AUX_CARRY_FLAG));
+        }
+
+        static void step(uint8_t opcode, const batch::Lanes& lanes, size_t i) {
+            const V mask = P::load(lanes.mask + i);
+            auto get = [&](uint8_t r) { return P::load(lanes.r[r] + i); };
+            auto put = [&](uint8_t r, V value) { P::store(lanes.r[r] + i, P::blend(get(r), value, mask)); };
+            const V F = P::load(lanes.F + i);
+            auto setF = [&](uint8_t affected, V flags) {
+                P::store(lanes.F + i, P::blend(F, P::bor(P::band(F, P::set(~affected)), flags), mask));
+            };
+            constexpr uint8_t ALL = Registers::SIGN_FLAG | Registers::ZERO_FLAG | Registers::AUX_CARRY_FLAG
+                                  | Registers::PARITY_FLAG | Registers::CARRY_FLAG;
+            constexpr uint8_t A = 7, OPERAND = 6;
+            const uint8_t ddd = (opcode >> 3) & 0b111;
+            const uint8_t sss = opcode & 0b111;
+
+            if (opcode >= 0x40 && opcode <= 0x7F) { // MOV, with M in the operand
+                put(ddd, get(sss));
+            } else if ((opcode & 0b11000111) == 0b00000110) { // MVI
+                put(ddd, get(OPERAND));
+            } else if (opcode >= 0x80 && (opcode <= 0xBF || (opcode & 0b11000111) == 0b11000110)) { // ALU, register or immediate
+                const V a = get(A);
+                const V b = get(opcode >= 0xC0 ? OPERAND : sss);
+                const V carry = ddd == 1 || ddd == 3 ? P::band(F, P::set(Registers::CARRY_FLAG)) : P::set(0);
+                V result, flags;
+                if (ddd == 0 || ddd == 1) { // ADD, ADC
+                    result = P::add(P::add(a, b), carry);
+                    const V carryOut = bit7(P::bor(P::band(a, b), P::band(P::bor(a, b), P::bnot(result))));
+                    flags = P::bor(P::bor(zsp(result), auxCarry(a, b, result)), carryOut);
+                } else if (ddd == 2 || ddd == 3 || ddd == 7) { // SUB, SBB, CMP
+                    result = P::sub(P::sub(a, b), carry);
+                    const V notA = P::bnot(a);
+                    const V borrow = bit7(P::bor(P::band(notA, b), P::band(P::bor(notA, b), result)));
+                    flags = P::bor(P::bor(zsp(result), auxCarry(a, b, result)), borrow);
+                } else if (ddd == 4) { // ANA, AC is the OR of bit 3 of both operands
+                    result = P::band(a, b);
+                    const V bit3 = P::band(P::bor(a, b), P::set(0x08));
+                    flags = P::bor(zsp(result), P::add(bit3, bit3));
+                } else { // XRA, ORA
+                    result = ddd == 5 ? P::bxor(a, b) : P::bor(a, b);
+                    flags = zsp(result);
+                }
+                if (ddd != 7) {
+                    put(A, result);
+                }
+                setF(ALL, flags);
+            } else if ((opcode & 0b11000110) == 0b00000100) { // INR, DCR, all flags but CY
+                const V value = get(ddd);
+                const V one = P::set(1);
+                const V result = opcode & 1 ? P::sub(value, one) : P::add(value, one);
+                put(ddd, result);
+                setF(ALL & ~Registers::CARRY_FLAG, P::bor(zsp(result), auxCarry(value, one, result)));
+            } else if ((opcode & 0b11000111) == 0b00000011) { // INX, DCX of BC DE HL
+                const uint8_t high = 2 * (opcode >> 4), low = high + 1;
+                const V lowValue = get(low);
+                if (opcode & 0b00001000) { // DCX borrows from the high byte when the low one was 0
+                    put(high, P::add(get(high), P::isZero(lowValue)));
+                    put(low, P::sub(lowValue, P::set(1)));
+                } else { // INX carries into it when the low one wraps to 0
+                    const V result = P::add(lowValue, P::set(1));
+                    put(high, P::sub(get(high), P::isZero(result)));
+                    put(low, result);
+                }
+            } else if (opcode == 0x2F) { // CMA
+                put(A, P::bnot(get(A)));
+            } else if (opcode == 0x37) { // STC
+                setF(Registers::CARRY_FLAG, P::set(Registers::CARRY_FLAG));
+            } else if (opcode == 0x3F) { // CMC
+                setF(Registers::CARRY_FLAG, P::band(P::bnot(F), P::set(Registers::CARRY_FLAG)));
+            } else if (opcode == 0xEB) { // XCHG
+                const V d = get(2), e = get(3), h = get(4), l = get(5);
+                put(2, h);
+                put(3, l);
+                put(4, d);
+                put(5, e);
+            }
+            // NOP and its aliases leave everything alone
+        }
+
+        static void run(uint8_t opcode, const batch::Lanes& lanes) {
+            for (size_t i = 0; i < lanes.count; i += P::WIDTH) {
+                step(opcode, lanes, i);
+            }
+        }
+    };
+}
@@ -0,0 +1,25 @@
+#include "batchKernels.hpp"
+
+namespace {
+    // One lane at a time, for hosts without SIMD and as the reference for the others
+    struct Scalar {
+        using V = uint8_t;
+        static constexpr size_t WIDTH = 1;
+
+        static V load(const uint8_t* p) { return *p; }
+        static void store(uint8_t* p, V v) { *p = v; }
+        static V set(uint8_t value) { return value; }
+        static V add(V a, V b) { return a + b; }
+        static V sub(V a, V b) { return a - b; }
+        static V band(V a, V b) { return a & b; }
+        static V bor(V a, V b) { return a | b; }
+        static V bxor(V a, V b) { return a ^ b; }
+        static V bnot(V a) { return ~a; }
+        static V isZero(V a) { return a == 0 ? 0xFF : 0; }
+        static V blend(V old, V value, V mask) { return mask ? value : old; }
+        template<int n> static V shiftRight(V a) { return a >> n; }
+        static V lookup(const uint8_t* table, V index) { return table[index]; }
+    };
+}
+
+const batch::Kernel batch::scalar = &Kernels<Scalar>::run;
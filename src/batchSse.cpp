@@ -0,0 +1,33 @@
+#include "batchKernels.hpp"
+
+#if defined(__SSSE3__)
+#include <immintrin.h>
+
+namespace {
+    // 16 lanes per register, SSSE3 for the parity lookup
+    struct Sse {
+        using V = __m128i;
+        static constexpr size_t WIDTH = 16;
+
+        static V load(const uint8_t* p) { return _mm_loadu_si128(reinterpret_cast<const __m128i*>(p)); }
+        static void store(uint8_t* p, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(p), v); }
+        static V set(uint8_t value) { return _mm_set1_epi8(value); }
+        static V add(V a, V b) { return _mm_add_epi8(a, b); }
+        static V sub(V a, V b) { return _mm_sub_epi8(a, b); }
+        static V band(V a, V b) { return _mm_and_si128(a, b); }
+        static V bor(V a, V b) { return _mm_or_si128(a, b); }
+        static V bxor(V a, V b) { return _mm_xor_si128(a, b); }
+        static V bnot(V a) { return _mm_xor_si128(a, _mm_set1_epi8(-1)); }
+        static V isZero(V a) { return _mm_cmpeq_epi8(a, _mm_setzero_si128()); }
+        static V blend(V old, V value, V mask) { return _mm_or_si128(_mm_and_si128(mask, value), _mm_andnot_si128(mask, old)); }
+        template<int n> static V shiftRight(V a) { return _mm_and_si128(_mm_srli_epi16(a, n), _mm_set1_epi8(0xFF >> n)); }
+        static V lookup(const uint8_t* table, V index) {
+            return _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i*>(table)), index);
+        }
+    };
+}
+
+const batch::Kernel batch::sse = &Kernels<Sse>::run;
+#else
+const batch::Kernel batch::sse = nullptr;
+#endif
@@ -0,0 +1,98 @@
+#include <algorithm>
+
+#include "cpu.hpp"
+#include "isa.hpp"
+
+const Cpu::Block& Cpu::translate(uint16_t address) {
+    auto watch = [&](uint16_t byte) {
+        memory.watchCode(byte);
+        std::vector<uint16_t>& starts = pageBlocks[byte >> 8];
+        if (starts.empty() || starts.back() != address) {
+            starts.push_back(address);
+        }
+    };
+
+    std::vector<uint8_t> opcodes;
+    uint16_t pc = address;
+    while (true) {
+        const uint8_t opcode = memory.read(pc);
+        const isa::Opcode& info = isa::opcodes[opcode];
+        opcodes.push_back(opcode);
+        watch(pc);
+        watch(pc + info.length - 1); // operands can cross into the next page
+
+        const uint16_t next = pc + info.length;
+        const bool wrapped = next < pc;
+        pc = next;
+        if (isa::branches(opcode) || opcode == 0x76 || opcodes.size() == MAX_BLOCK || wrapped) { // 0x76 is HLT
+            break;
+        }
+    }
+
+    // The longest superinstruction that matches at each opcode replaces its handlers
+    Block block;
+    block.instructions = opcodes.size();
+    block.io = std::any_of(opcodes.begin(), opcodes.end(), isa::io);
+    for (size_t i = 0; i < opcodes.size();) {
+        Handler handler = handlers[opcodes[i]];
+        size_t length = 1;
+        for (const Superinstruction& fused : superinstructions) {
+            if (fused.length > length && i + fused.length <= opcodes.size()
+                && std::equal(fused.opcodes.begin(), fused.opcodes.begin() + fused.length, opcodes.begin() + i)) {
+                handler = fused.handler;
+                length = fused.length;
+            }
+        }
+        if (length > 1) {
+            blockFusions++;
+        }
+        block.handlers.push_back(handler);
+        i += length;
+    }
+    return blocks.insert_or_assign(address, std::move(block)).first->second;
+}
+
+void Cpu::invalidateCode() {
+    for (uint8_t page : memory.codeWrites()) {
+        // Every block in the page goes, its other pages forget it once they are written too
+        for (uint16_t start : pageBlocks[page]) {
+            if (blocks.erase(start)) {
+                blockInvalidations++;
+                jit.drop(start);
+            }
+        }
+        pageBlocks[page].clear();
+    }
+    memory.codeWrites().clear();
+}
+
+uint64_t Cpu::decodeBlock(uint64_t budget) {
+    if (!memory.codeWrites().empty()) {
+        invalidateCode();
+    }
+
+    const Block* block;
+    auto found = blocks.find(regs.PC);
+    if (found != blocks.end()) {
+        blockHits++;
+        block = &found->second;
+    } else {
+        blockMisses++;
+        block = &translate(regs.PC);
+    }
+
+    uint64_t executed = 0;
+    for (Handler handler : block->handlers) {
+        regs.PC++; // the handlers expect PC past the opcode, and leave it at the next one
+        executed += block->io ? atCycle(executed, [&] { return handler(*this); }) : handler(*this);
+        if (!memory.codeWrites().empty()) {
+            // The block may have just changed itself, stop before running stale handlers
+            invalidateCode();
+            break;
+        }
+        if (executed >= budget) {
+            break;
+        }
+    }
+    return executed;
+}
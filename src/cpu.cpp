@@ -1,4 +1,7 @@
 #include "cpu.hpp"
+#include "isa.hpp"
+
+#include <algorithm>
 
 int Cpu::loadRom(std::istream &rom) {
     if (!rom) {
@@ -6,19 +9,84 @@ int Cpu::loadRom(std::istream &rom) {
         return -1;
     }
 
-    uint16_t address = 0;
-    uint8_t byte = 0;
-    while(rom.read(reinterpret_cast<char*>(&byte), 1)) {
-        memory.write(address++, byte);
-    }
+    // One read for the whole image, anything past the top of memory is dropped
+    std::vector<uint8_t> bytes(0x10000);
+    rom.read(reinterpret_cast<char*>(bytes.data()), bytes.size());
+    memory.load(bytes.data(), rom.gcount());
     return 0;
 }
 
 int Cpu::loadRom(const char* path) {
-    std::ifstream rom(path, std::ios::binary);
+    RomImage rom;
+    if (rom.open(path) != 0) {
+        return -1;
+    }
     return loadRom(rom);
 }
 
+int Cpu::loadRom(const RomImage& rom) {
+    memory.load(rom.data(), rom.size());
+    return 0;
+}
+
+std::shared_ptr<const Cpu::Snapshot> Cpu::snapshot() {
+    memory.clearDirty();
+    resetPoint = std::make_shared<const Snapshot>(Snapshot{regs, memory, cycles, scheduler.deadlines()});
+    return resetPoint;
+}
+
+void Cpu::restore(const std::shared_ptr<const Snapshot>& snapshot) {
+    memory.restore(snapshot->memory, snapshot != resetPoint); // another snapshot can differ anywhere
+    regs = snapshot->regs;
+    cycles = snapshot->cycles;
+    scheduler.setDeadlines(snapshot->deadlines);
+    resetPoint = snapshot;
+}
+
+void Cpu::reset() {
+    if (resetPoint) {
+        restore(resetPoint);
+        return;
+    }
+    static const Memory blank;
+    memory.restore(blank);
+    regs = Registers();
+    cycles = 0;
+}
+
+bool Cpu::interrupt(uint8_t vector) {
+    if (!regs.interruptsEnabled) {
+        return false;
+    }
+    regs.interruptsEnabled = false;
+    if (regs.halted) {
+        regs.halted = false;
+        regs.PC++; // returns past the HLT
+    }
+    memory.write(regs.SP-1, regs.PC >> 8);
+    memory.write(regs.SP-2, regs.PC & 0xFF);
+    regs.SP -= 2;
+    regs.PC = (vector & 0b111) * 8;
+    cycles += isa::opcodes[0xC7].cycles; // as long as RST takes
+    return true;
+}
+
+uint64_t Cpu::stateHash() {
+    // The registers mixed into the hash Memory keeps up to date on every write, then the deadlines of the events
+    auto mix = [](uint64_t x) {
+        x = (x ^ x >> 30) * 0xBF58476D1CE4E5B9;
+        x = (x ^ x >> 27) * 0x94D049BB133111EB;
+        return x ^ x >> 31;
+    };
+    const uint64_t registers = uint64_t(regs.A) << 56 | uint64_t(regs.getF()) << 48 | uint64_t(regs.B) << 40 | uint64_t(regs.C) << 32
+                             | uint64_t(regs.D) << 24 | uint64_t(regs.E) << 16 | uint64_t(regs.H) << 8 | regs.L;
+    uint64_t hash = mix(mix(registers ^ memory.hash()) ^ (uint64_t(regs.interruptState()) << 32 | uint64_t(regs.PC) << 16 | regs.SP));
+    for (Scheduler::Event event = 0; event < scheduler.size(); event++) {
+        hash = mix(hash ^ scheduler.deadline(event));
+    }
+    return hash;
+}
+
 void Cpu::UnimplementedInstruction(uint16_t PC) {
     std::cerr << "Unimplemented instruction at: 0x" << std::hex << (int)PC << '\n' << "0x" << std::hex << (int)memory.read(PC) << '\n';
     exit(1);
@@ -30,7 +98,163 @@ uint16_t Cpu::read16atPC() {
     return value;
 }
 
+int Cpu::step() {
+#if defined(CPU_DISPATCH_SWITCH)
+    return decodeSwitch();
+#else
+    return decodeTable(); // the threaded, block and JIT engines only pay off over many instructions, see run
+#endif
+}
+
 int Cpu::decode() {
+    const int executed = step();
+    cycles += executed;
+    return executed;
+}
+
+template<typename Slice> uint64_t Cpu::runEvents(uint64_t budget, Slice slice) {
+    const uint64_t target = cycles + budget;
+    while (cycles < target) {
+        const uint64_t deadline = std::min(target, scheduler.next());
+        while (cycles < deadline) {
+            if (!fastForward) {
+                slice(deadline - cycles);
+                break;
+            }
+            slice(std::min(deadline - cycles, IDLE_CHECK));
+            if (cycles < deadline) {
+                skipIdle(deadline);
+            }
+        }
+        scheduler.run(*this, cycles);
+    }
+    return cycles - target;
+}
+
+bool Cpu::idle(uint8_t opcode) {
+    return isa::fusable(opcode) && opcode != 0xD3 && opcode != 0xFB && opcode != 0xF3; // not OUT, EI or DI
+}
+
+bool Cpu::spinLoop(uint16_t address, uint16_t& head, uint16_t& end) const {
+    // Forward from address to the jump back, then from its target to address
+    auto jump = [this](uint16_t pc) { return (memory.read(pc) & 0b11000111) == 0b11000010 || (memory.read(pc) & 0b11110111) == 0b11000011; };
+    uint16_t pc = address;
+    uint32_t length = 0;
+    while (length++ < MAX_SPIN) {
+        const uint8_t opcode = memory.read(pc);
+        if (jump(pc) && memory.read16(pc + 1) <= address) {
+            head = memory.read16(pc + 1);
+            end = pc + 3;
+            break;
+        }
+        if (!idle(opcode) && !(jump(pc) && opcode != 0xC3 && opcode != 0xCB)) { // conditional jumps out
+            return false;
+        }
+        pc += isa::opcodes[opcode].length;
+    }
+    if (length > MAX_SPIN) {
+        return false;
+    }
+
+    for (pc = head; pc != address; pc += isa::opcodes[memory.read(pc)].length) {
+        const uint8_t opcode = memory.read(pc);
+        if (length++ == MAX_SPIN || pc > address || !(idle(opcode) || (jump(pc) && opcode != 0xC3 && opcode != 0xCB))) {
+            return false;
+        }
+    }
+    return true;
+}
+
+uint64_t Cpu::spinPeriod(uint64_t deadline) {
+    uint16_t head, end;
+    if (!spinLoop(regs.PC, head, end)) {
+        return 0;
+    }
+    // Steps through the loop while it runs idle instructions and jumps only, false once it leaves
+    auto stepInLoop = [&] {
+        const uint8_t opcode = memory.read(regs.PC);
+        if (cycles >= deadline || regs.PC < head || regs.PC >= end || !(idle(opcode) || (opcode & 0b11000111) == 0b11000010
+                                                                      || (opcode & 0b11110111) == 0b11000011)) {
+            return false;
+        }
+        decode();
+        return true;
+    };
+    for (uint32_t i = 0; regs.PC != head; i++) {
+        if (i == MAX_SPIN || !stepInLoop()) {
+            return 0;
+        }
+    }
+
+    // Only idle instructions ran, so coming back with the same registers repeats the loop exactly
+    Registers before = regs;
+    const uint64_t start = cycles;
+    for (uint32_t i = 0; i == 0 || regs.PC != head; i++) {
+        if (i == MAX_SPIN || !stepInLoop()) {
+            return 0;
+        }
+    }
+    const bool same = regs.A == before.A && regs.B == before.B && regs.C == before.C && regs.D == before.D
+                   && regs.E == before.E && regs.H == before.H && regs.L == before.L && regs.SP == before.SP
+                   && regs.getF() == before.getF() && regs.interruptState() == before.interruptState();
+    return same ? cycles - start : 0;
+}
+
+void Cpu::skipIdle(uint64_t deadline) {
+    const uint64_t period = regs.halted ? isa::opcodes[0x76].cycles : spinPeriod(deadline);
+    if (period == 0 || cycles >= deadline) {
+        return;
+    }
+    const uint64_t skipped = (deadline - cycles) / period * period;
+    cycles += skipped;
+    skippedCycles += skipped;
+}
+
+uint64_t Cpu::run(uint64_t budget) {
+    return runEvents(budget, [this](uint64_t slice) { return runEngine(slice); });
+}
+
+uint64_t Cpu::runEngine(uint64_t budget) {
+    // Count in a local so the loop keeps it in a register, cycles is brought up to date where devices can see it
+    const uint64_t start = cycles;
+    uint64_t executed = 0;
+#if defined(CPU_DISPATCH_THREADED)
+    executed = threaded<true>(budget);
+#elif defined(CPU_DISPATCH_BLOCKS)
+    while (executed < budget) {
+        cycles = start + executed;
+        executed += decodeBlock(budget - executed);
+    }
+#elif defined(CPU_DISPATCH_JIT)
+    while (executed < budget) {
+        cycles = start + executed;
+        executed += decodeJit(budget - executed);
+    }
+#else
+    while (executed < budget) {
+        cycles = start + executed;
+        executed += step();
+    }
+#endif
+    cycles = start + executed;
+    return executed - budget;
+}
+
+uint64_t Cpu::runRecompiled(const recompiled::Rom& rom, uint64_t budget) {
+    return runEvents(budget, [&](uint64_t slice) {
+        uint64_t executed = 0;
+        while (executed < slice) {
+            if (regs.PC < rom.size && rom.blocks[regs.PC] != nullptr) {
+                executed += rom.blocks[regs.PC](regs, memory);
+            } else {
+                executed += atCycle(executed, [this] { return step(); }); // the recompiler leaves IN and OUT to step
+            }
+        }
+        cycles += executed;
+    });
+}
+
+int Cpu::decodeSwitch() {
     const uint8_t opcode = memory.read(regs.PC);
 
     // std::cout << "0x" << std::hex << (int)opcode << '\n';
@@ -46,293 +270,294 @@ int Cpu::decode() {
     
     switch (opcode) {
         case 0x00: // NOP
-            return 4;
+        case 0x08: case 0x10: case 0x18: case 0x20: case 0x28: case 0x30: case 0x38: // undocumented NOPs
+            break;
         // DATA TRANSFER GROUP
         { // MOV
             // destination B
             case 0x40:
-                return 1;
+                break;
             case 0x41:
                 regs.B = regs.C;
-                return 1;
+                break;
             case 0x42:
                 regs.B = regs.D;
-                return 1;
+                break;
             case 0x43:
                 regs.B = regs.E;
-                return 1;
+                break;
             case 0x44:
                 regs.B = regs.H;
-                return 1;
+                break;
             case 0x45:
                 regs.B = regs.L;
-                return 1;
+                break;
             case 0x46:
                 address = regs.readHL();
                 regs.B = memory.read(address);
-                return 2;
+                break;
             case 0x47:
                 regs.B = regs.A;
-                return 1;
+                break;
             // destination C
             case 0x48:
                 regs.C = regs.B;
-                return 1;
+                break;
             case 0x49:
-                return 1;
+                break;
             case 0x4A:
                 regs.C = regs.D;
-                return 1;
+                break;
             case 0x4B:
                 regs.C = regs.E;
-                return 1;
+                break;
             case 0x4C:
                 regs.C = regs.H;
-                return 1;
+                break;
             case 0x4D:
                 regs.C = regs.L;
-                return 1;
+                break;
             case 0x4E:
                 address = regs.readHL();
                 regs.C = memory.read(address);
-                return 2;
+                break;
             case 0x4F:
                 regs.C = regs.A;
-                return 1;
+                break;
             // destination D
             case 0x50:
                 regs.D = regs.B;
-                return 1;
+                break;
             case 0x51:
                 regs.D = regs.C;
-                return 1;
+                break;
             case 0x52:
-                return 1;
+                break;
             case 0x53:
                 regs.D = regs.E;
-                return 1;
+                break;
             case 0x54:
                 regs.D = regs.H;
-                return 1;
+                break;
             case 0x55:
                 regs.D = regs.L;
-                return 1;
+                break;
             case 0x56:
                 address = regs.readHL();
                 regs.D = memory.read(address);
-                return 2;
+                break;
             case 0x57:
                 regs.D = regs.A;
-                return 1;
+                break;
             // destination E
             case 0x58:
                 regs.E = regs.B;
-                return 1;
+                break;
             case 0x59:
                 regs.E = regs.C;
-                return 1;
+                break;
             case 0x5A:
                 regs.E = regs.D;
-                return 1;
+                break;
             case 0x5B:
-                return 1;
+                break;
             case 0x5C:
                 regs.E = regs.H;
-                return 1;
+                break;
             case 0x5D:
                 regs.E = regs.L;
-                return 1;
+                break;
             case 0x5E:
                 address = regs.readHL();
                 regs.E = memory.read(address);
-                return 2;
+                break;
             case 0x5F:
                 regs.E = regs.A;
-                return 1;
+                break;
             // destination H
             case 0x60:
                 regs.H = regs.B;
-                return 1;
+                break;
             case 0x61:
                 regs.H = regs.C;
-                return 1;
+                break;
             case 0x62:
                 regs.H = regs.D;
-                return 1;
+                break;
             case 0x63:
                 regs.H = regs.E;
-                return 1;
+                break;
             case 0x64:
-                return 1;
+                break;
             case 0x65:
                 regs.H = regs.L;
-                return 1;
+                break;
             case 0x66:
                 address = regs.readHL();
                 regs.H = memory.read(address);
-                return 2;
+                break;
             case 0x67:
                 regs.H = regs.A;
-                return 1;
+                break;
             // destination L
             case 0x68:
                 regs.L = regs.B;
-                return 1;
+                break;
             case 0x69:
                 regs.L = regs.C;
-                return 1;
+                break;
             case 0x6A:
                 regs.L = regs.D;
-                return 1;
+                break;
             case 0x6B:
                 regs.L = regs.E;
-                return 1;
+                break;
             case 0x6C:
                 regs.L = regs.H;
-                return 1;
+                break;
             case 0x6D:
-                return 1;
+                break;
             case 0x6E:
                 address = regs.readHL();
                 regs.L = memory.read(address);
-                return 2;
+                break;
             case 0x6F:
                 regs.L = regs.A;
-                return 1;
+                break;
             // destination memory address in HL
             case 0x70:
                 address = regs.readHL();
                 memory.write(address, regs.B);
-                return 2;
+                break;
             case 0x71:
                 address = regs.readHL();
                 memory.write(address, regs.C);
-                return 2;        
+                break;        
             case 0x72:
                 address = regs.readHL();
                 memory.write(address, regs.D);
-                return 2;
+                break;
             case 0x73:
                 address = regs.readHL();
                 memory.write(address, regs.E);
-                return 2;
+                break;
             case 0x74:
                 address = regs.readHL();
                 memory.write(address, regs.H);
-                return 2;
+                break;
             case 0x75:
                 address = regs.readHL();
                 memory.write(address, regs.L);
-                return 2;
+                break;
             case 0x77:
                 address = regs.readHL();
                 memory.write(address, regs.A);
-                return 2;
+                break;
             // destination A
             case 0x78:
                 regs.A = regs.B;
-                return 1;
+                break;
             case 0x79:
                 regs.A = regs.C;
-                return 1;
+                break;
             case 0x7A:
                 regs.A = regs.D;
-                return 1;
+                break;
             case 0x7B:
                 regs.A = regs.E;
-                return 1;
+                break;
             case 0x7C:
                 regs.A = regs.H;
-                return 1;
+                break;
             case 0x7D:
                 regs.A = regs.L;
-                return 1;
+                break;
             case 0x7E:
                 address = regs.readHL();
                 regs.A = memory.read(address);
-                return 2;
+                break;
             case 0x7F:
-                return 1;
+                break;
         };        
         { // MVI
             case 0x06:
                 regs.B = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x0E:
                 regs.C = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x16:
                 regs.D = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x1E:
                 regs.E = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x26:
                 regs.H = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x2E:
                 regs.L = memory.read(regs.PC++);
-                return 2;
+                break;
             case 0x36:
                 temp8 = memory.read(regs.PC++);
                 memory.write(regs.readHL(), temp8);
-                return 3;
+                break;
             case 0x3E:
                 regs.A = memory.read(regs.PC++);
-                return 2;
+                break;
         };
         { // LXI
             case 0x01:
                 regs.setBC(read16atPC());
-                return 3;
+                break;
             case 0x11:
                 regs.setDE(read16atPC());
-                return 3;
+                break;
             case 0x21:
                 regs.setHL(read16atPC());
-                return 3;
+                break;
             case 0x31:
                 regs.SP = read16atPC();
-                return 3;
+                break;
         };
         { // LDA / LDAX
             case 0x0A:
                 regs.A = memory.read(regs.readBC());
-                return 2;
+                break;
             case 0x1A:
                 regs.A = memory.read(regs.readDE());
-                return 2;
+                break;
             case 0x3A: // LDA
                 regs.A = memory.read(read16atPC());
-                return 4;
+                break;
         };
         { // STA / STAX
             case 0x02:
                 memory.write(regs.readBC(), regs.A);
-                return 2;
+                break;
             case 0x12:
                 memory.write(regs.readDE(), regs.A);
-                return 2;
+                break;
             case 0x32:
                 memory.write(read16atPC(), regs.A);
-                return 4;
+                break;
         };
         { // HL stuff
         case 0x2A: // LHLD
             address = read16atPC();
             regs.L = memory.read(address);
             regs.H = memory.read(address+1);
-            return 5;
+            break;
         case 0x22: // SHLD
             address = read16atPC();
             memory.write(address, regs.L);
             memory.write(address+1, regs.H);
-            return 5;
+            break;
         case 0xEB: // XCHG
             temp16 = regs.readHL();
             regs.setHL(regs.readDE());
             regs.setDE(temp16);
-            return 1;
+            break;
         };
         // ARITHMETIC GROUP
         { // ADD
@@ -340,304 +565,304 @@ int Cpu::decode() {
                 temp16 = regs.A + regs.B;
                 regs.setFlagsADD(temp16, regs.A, regs.B);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x81:
                 temp16 = regs.A + regs.C;
                 regs.setFlagsADD(temp16, regs.A, regs.C);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x82:
                 temp16 = regs.A + regs.D;
                 regs.setFlagsADD(temp16, regs.A, regs.D);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x83:
                 temp16 = regs.A + regs.E;
                 regs.setFlagsADD(temp16, regs.A, regs.E);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x84:
                 temp16 = regs.A + regs.H;
                 regs.setFlagsADD(temp16, regs.A, regs.H);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x85:
                 temp16 = regs.A + regs.L;
                 regs.setFlagsADD(temp16, regs.A, regs.L);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x86:
                 temp16 = regs.A + memory.read(regs.readHL());
                 regs.setFlagsADD(temp16, regs.A, memory.read(regs.readHL()));
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x87:
                 temp16 = regs.A + regs.A;
                 regs.setFlagsADD(temp16, regs.A, regs.A);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0xC6: // ADI
                 temp8 = memory.read(regs.PC++);
                 temp16 = regs.A + temp8;
                 regs.setFlagsADD(temp16, regs.A, temp8);
                 regs.A = temp16;
-                return 2;
+                break;
         };
         { // ADC
             case 0x88:
                 temp16 = regs.A + regs.B + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.B, true);
+                regs.setFlagsADD(temp16, regs.A, regs.B);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x89:
                 temp16 = regs.A + regs.C + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.C, true);
+                regs.setFlagsADD(temp16, regs.A, regs.C);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8A:
                 temp16 = regs.A + regs.D + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.D, true);
+                regs.setFlagsADD(temp16, regs.A, regs.D);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8B:
                 temp16 = regs.A + regs.E + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.E, true);
+                regs.setFlagsADD(temp16, regs.A, regs.E);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8C:
                 temp16 = regs.A + regs.H + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.H, true);
+                regs.setFlagsADD(temp16, regs.A, regs.H);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8D:
                 temp16 = regs.A + regs.L + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.L, true);
+                regs.setFlagsADD(temp16, regs.A, regs.L);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8E:
                 temp16 = regs.A + memory.read(regs.readHL()) + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, memory.read(regs.readHL()), true);
+                regs.setFlagsADD(temp16, regs.A, memory.read(regs.readHL()));
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x8F:
                 temp16 = regs.A + regs.A + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, regs.A, true);
+                regs.setFlagsADD(temp16, regs.A, regs.A);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0xCE: // ADI
                 temp8 = memory.read(regs.PC++);
                 temp16 = regs.A + temp8 + regs.getCarry();
-                regs.setFlagsADD(temp16, regs.A, temp8, true);
+                regs.setFlagsADD(temp16, regs.A, temp8);
                 regs.A = temp16;
-                return 2;
+                break;
         };
         { // SUB
             case 0x90:
                 temp16 = regs.A - regs.B;
                 regs.setFlagsSUB(temp16, regs.A, regs.B);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x91:
                 temp16 = regs.A - regs.C;
                 regs.setFlagsSUB(temp16, regs.A, regs.C);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x92:
                 temp16 = regs.A - regs.D;
                 regs.setFlagsSUB(temp16, regs.A, regs.D);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x93:
                 temp16 = regs.A - regs.E;
                 regs.setFlagsSUB(temp16, regs.A, regs.E);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x94:
                 temp16 = regs.A - regs.H;
                 regs.setFlagsSUB(temp16, regs.A, regs.H);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x95:
                 temp16 = regs.A - regs.L;
                 regs.setFlagsSUB(temp16, regs.A, regs.L);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x96:
                 temp16 = regs.A - memory.read(regs.readHL());
                 regs.setFlagsSUB(temp16, regs.A, memory.read(regs.readHL()));
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x97:
                 temp16 = regs.A - regs.A;
                 regs.setFlagsSUB(temp16, regs.A, regs.A);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0xD6: // SUI
                 temp8 = memory.read(regs.PC++);
                 temp16 = regs.A - temp8;
                 regs.setFlagsSUB(temp16, regs.A, temp8);
                 regs.A = temp16;
-                return 2;
+                break;
         };
         { // SBB
             case 0x98:
                 temp16 = regs.A - regs.B - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.B, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.B);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x99:
                 temp16 = regs.A - regs.C - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.C, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.C);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9A:
                 temp16 = regs.A - regs.D - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.D, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.D);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9B:
                 temp16 = regs.A - regs.E - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.E, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.E);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9C:
                 temp16 = regs.A - regs.H - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.H, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.H);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9D:
                 temp16 = regs.A - regs.L - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.L, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.L);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9E:
                 temp16 = regs.A - memory.read(regs.readHL()) - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, memory.read(regs.readHL()), true);
+                regs.setFlagsSUB(temp16, regs.A, memory.read(regs.readHL()));
                 regs.A = temp16;
-                return 1;
+                break;
             case 0x9F:
                 temp16 = regs.A - regs.A - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, regs.A, true);
+                regs.setFlagsSUB(temp16, regs.A, regs.A);
                 regs.A = temp16;
-                return 1;
+                break;
             case 0xDE: // SBI
                 temp8 = memory.read(regs.PC++);
                 temp16 = regs.A - temp8 - regs.getCarry();
-                regs.setFlagsSUB(temp16, regs.A, temp8, true);
+                regs.setFlagsSUB(temp16, regs.A, temp8);
                 regs.A = temp16;
-                return 2;
+                break;
         }
         { // INR
             case 0x04:
                 temp16 = regs.B + 1;
-                regs.setFlagsADD(temp16, regs.B, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.B, 1, Registers::KEEP_CARRY);
                 regs.B = temp16;
-                return 1;
+                break;
             case 0x0C:
                 temp16 = regs.C + 1;
-                regs.setFlagsADD(temp16, regs.C, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.C, 1, Registers::KEEP_CARRY);
                 regs.C = temp16;
-                return 1;
+                break;
             case 0x14:
                 temp16 = regs.D + 1;
-                regs.setFlagsADD(temp16, regs.D, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.D, 1, Registers::KEEP_CARRY);
                 regs.D = temp16;
-                return 1;
+                break;
             case 0x1C:
                 temp16 = regs.E + 1;
-                regs.setFlagsADD(temp16, regs.E, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.E, 1, Registers::KEEP_CARRY);
                 regs.E = temp16;
-                return 1;
+                break;
             case 0x24:
                 temp16 = regs.H + 1;
-                regs.setFlagsADD(temp16, regs.H, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.H, 1, Registers::KEEP_CARRY);
                 regs.H = temp16;
-                return 1;
+                break;
             case 0x2C:
                 temp16 = regs.L + 1;
-                regs.setFlagsADD(temp16, regs.L, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.L, 1, Registers::KEEP_CARRY);
                 regs.L = temp16;
-                return 1;
+                break;
             case 0x34: // increment memory
                 temp16 = memory.read(regs.readHL()) + 1;
-                regs.setFlagsADD(temp16, memory.read(regs.readHL()), 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, memory.read(regs.readHL()), 1, Registers::KEEP_CARRY);
                 memory.write(regs.readHL(), temp16);
-                return 3;
+                break;
             case 0x3C:
                 temp16 = regs.A + 1;
-                regs.setFlagsADD(temp16, regs.A, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsADD(temp16, regs.A, 1, Registers::KEEP_CARRY);
                 regs.A = temp16;
-                return 1;
+                break;
         };
         { // INX, increment 16bit register pair
             case 0x03:
                 regs.setBC(regs.readBC() + 1);
-                return 1;
+                break;
             case 0x13:
                 regs.setDE(regs.readDE() + 1);
-                return 1;
+                break;
             case 0x23:
                 regs.setHL(regs.readHL() + 1);
-                return 1;
+                break;
             case 0x33:
                 regs.SP += 1;
-                return 1;
+                break;
         };
         { // DCR
             case 0x05:
                 temp16 = regs.B - 1;
-                regs.setFlagsSUB(temp16, regs.B, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.B, 1, Registers::KEEP_CARRY);
                 regs.B = temp16;
-                return 1;
+                break;
             case 0x0D:
                 temp16 = regs.C - 1;
-                regs.setFlagsSUB(temp16, regs.C, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.C, 1, Registers::KEEP_CARRY);
                 regs.C = temp16;
-                return 1;
+                break;
             case 0x15:
                 temp16 = regs.D - 1;
-                regs.setFlagsSUB(temp16, regs.D, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.D, 1, Registers::KEEP_CARRY);
                 regs.D = temp16;
-                return 1;
+                break;
             case 0x1D:
                 temp16 = regs.E - 1;
-                regs.setFlagsSUB(temp16, regs.E, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.E, 1, Registers::KEEP_CARRY);
                 regs.E = temp16;
-                return 1;
+                break;
             case 0x25:
                 temp16 = regs.H - 1;
-                regs.setFlagsSUB(temp16, regs.H, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.H, 1, Registers::KEEP_CARRY);
                 regs.H = temp16;
-                return 1;
+                break;
             case 0x2D:
                 temp16 = regs.L - 1;
-                regs.setFlagsSUB(temp16, regs.L, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.L, 1, Registers::KEEP_CARRY);
                 regs.L = temp16;
-                return 1;
+                break;
             case 0x35: // decrease memory
                 temp16 = memory.read(regs.readHL()) - 1;
-                regs.setFlagsSUB(temp16, memory.read(regs.readHL()), 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, memory.read(regs.readHL()), 1, Registers::KEEP_CARRY);
                 memory.write(regs.readHL(), temp16);
-                return 3;
+                break;
             case 0x3D:
                 temp16 = regs.A - 1;
-                regs.setFlagsSUB(temp16, regs.A, 1, 0, 1, 1, 1, 0, 1);
+                regs.setFlagsSUB(temp16, regs.A, 1, Registers::KEEP_CARRY);
                 regs.A = temp16;
-                return 1;
+                break;
         };
         { // DCX, decrement 16bit register pair
             case 0x0B:
                 regs.setBC(regs.readBC() - 1);
-                return 1;
+                break;
             case 0x1B:
                 regs.setDE(regs.readDE() - 1);
-                return 1;
+                break;
             case 0x2B:
                 regs.setHL(regs.readHL() - 1);
-                return 1;
+                break;
             case 0x3B:
                 regs.SP -= 1;
-                return 1;
+                break;
         };
         { // DAD, add register RP to HL, only sets carry flag based on double precision overflow
             case 0x09:
@@ -647,7 +872,7 @@ int Cpu::decode() {
                     regs.clearCarry();
                 }
                 regs.setHL(regs.readHL() + regs.readBC());
-                return 3;
+                break;
             case 0x19:
                 if (UINT16_MAX - regs.readHL() < regs.readDE()) {
                     regs.setCarry();;
@@ -655,7 +880,7 @@ int Cpu::decode() {
                     regs.clearCarry();
                 }
                 regs.setHL(regs.readHL() + regs.readDE());
-                return 3;
+                break;
             case 0x29:
                 if (UINT16_MAX - regs.readHL() < regs.readHL()) { 
                     regs.setCarry();;
@@ -663,7 +888,7 @@ int Cpu::decode() {
                     regs.clearCarry();
                 }
                 regs.setHL(regs.readHL() + regs.readHL());
-                return 3;
+                break;
             case 0x39:
                 if (UINT16_MAX - regs.readHL() < regs.SP) { 
                     regs.setCarry();;
@@ -671,7 +896,7 @@ int Cpu::decode() {
                     regs.clearCarry();
                 }
                 regs.setHL(regs.readHL() + regs.SP);
-                return 3;
+                break;
         };
         { // DAA
             case 0x27: 
@@ -684,245 +909,183 @@ int Cpu::decode() {
                 }
                 temp16 = regs.A + temp8;
                 regs.setFlagsADD(temp16, regs.A, temp8);
-                regs.A = temp8;
-                return 1;
+                if (temp8 >> 4) { // the high digit was corrected, CY is set even when the addition does not carry
+                    regs.setCarry();
+                }
+                regs.A = temp16;
+                break;
         };
         // LOGICAL GROUP
         { // ANA
             case 0xA0:
                 temp8 = regs.A & regs.B;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.B) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.B) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA1:
                 temp8 = regs.A & regs.C;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.C) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.C) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA2:
                 temp8 = regs.A & regs.D;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.D) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.D) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA3:
                 temp8 = regs.A & regs.E;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.E) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
+                regs.setFlagsLogic(temp8, (regs.A | regs.E) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA4:
                 temp8 = regs.A & regs.H;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.H) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.H) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA5:
                 temp8 = regs.A & regs.L;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.L) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.L) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
             case 0xA6:
                 temp8 = regs.A & memory.read(regs.readHL());
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | memory.read(regs.readHL())) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | memory.read(regs.readHL())) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 2;
+                break;
             case 0xA7:
                 temp8 = regs.A & regs.A;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                if (((regs.A | regs.A) && 0b100 ) >> 2) {
-                    regs.F |= 0b00010000;
-                } else {
-                    regs.F &= ~0b00010000;
-                }
-                regs.clearCarry(); // unset CY
+                regs.setFlagsLogic(temp8, (regs.A | regs.A) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 1;
+                break;
         };
         { // ANI
-            case 0xE5:
+            case 0xE6:
                 uint8_t value = memory.read(regs.PC++);
                 temp8 = regs.A & value;
-                regs.setFlags(temp8, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
+                regs.setFlagsLogic(temp8, (regs.A | value) & 0b00001000); // AC is the OR of bit 3 of both operands
                 regs.A = temp8;
-                return 2;
+                break;
         };
         { // XRA
             case 0xA8:
                 regs.A ^= regs.B;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xA9:
                 regs.A ^= regs.C;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAA:
                 regs.A ^= regs.D;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAB:
                 regs.A ^= regs.E;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAC:
                 regs.A ^= regs.H;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAD:
                 regs.A ^= regs.L;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAE:
                 regs.A ^= memory.read(regs.readHL());
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 2;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xAF:
                 regs.A ^= regs.A;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
         };
         { // XRI
-            case 0xED:
+            case 0xEE:
                 regs.A ^= memory.read(regs.PC++);
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 2;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
         };
         { // ORA
             case 0xB0:
                 regs.A |= regs.B;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB1:
                 regs.A |= regs.C;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB2:
                 regs.A |= regs.D;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB3:
                 regs.A |= regs.E;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB4:
                 regs.A |= regs.H;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB5:
                 regs.A |= regs.L;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB6:
                 regs.A |= memory.read(regs.readHL());
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 2;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
             case 0xB7:
                 regs.A |= regs.A;
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 1;
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
         };
         { // ORI
             case 0xF6:
-                regs.A ^= memory.read(regs.PC++);
-                regs.setFlags(regs.A, 1, 1, 1, 0);
-                regs.F &= ~0b00010001; // unset CY and AC
-                return 2;
+                regs.A |= memory.read(regs.PC++);
+                regs.setFlagsLogic(regs.A, 0); // unset CY and AC
+                break;
         };
         { // CMP
             case 0xB8:
                 temp16 = regs.A - regs.B;
                 regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                break;
             case 0xB9:
                 temp16 = regs.A - regs.C;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.C);
+                break;
             case 0xBA:
                 temp16 = regs.A - regs.D;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.D);
+                break;
             case 0xBB:
                 temp16 = regs.A - regs.E;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.E);
+                break;
             case 0xBC:
                 temp16 = regs.A - regs.H;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.H);
+                break;
             case 0xBD:
                 temp16 = regs.A - regs.L;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.L);
+                break;
             case 0xBE:
                 temp16 = regs.A - memory.read(regs.readHL());
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 2;
+                regs.setFlagsSUB(temp16, regs.A, memory.read(regs.readHL()));
+                break;
             case 0xBF:
                 temp16 = regs.A - regs.A;
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 1;
+                regs.setFlagsSUB(temp16, regs.A, regs.A);
+                break;
         };
         { // CPI
             case 0xFE:
-                temp16 = regs.A - memory.read(regs.PC++);
-                regs.setFlagsSUB(temp16, regs.A, regs.B);
-                return 2;
+                temp8 = memory.read(regs.PC++);
+                temp16 = regs.A - temp8;
+                regs.setFlagsSUB(temp16, regs.A, temp8);
+                break;
         };
         { // ROTATE
             case 0x07: // RLC, rotate left
@@ -934,7 +1097,7 @@ int Cpu::decode() {
                 }
                 temp8 = regs.A << 1;
                 regs.A = temp8 + bit;
-                return 1;
+                break;
             case 0x0F: // RRC, rotate right
                 bit = regs.A & 0b1;
                 if (bit == 1) {
@@ -944,7 +1107,7 @@ int Cpu::decode() {
                 }
                 temp8 = (regs.A >> 1) | (bit << 7);
                 regs.A = temp8;
-                return 1;
+                break;
             case 0x17: // RAL, rotate left through carry
                 bit = (regs.A & 0b10000000) >> 7;
                 temp8 = (regs.A << 1) + regs.getCarry();
@@ -954,7 +1117,7 @@ int Cpu::decode() {
                 } else {
                     regs.clearCarry();
                 }
-                return 1;
+                break;
             case 0x1F: // RAR, rotate right through carry
                 bit = regs.A & 0b1;
                 temp8 = (regs.A >> 1) + (regs.getCarry() << 7);
@@ -965,84 +1128,314 @@ int Cpu::decode() {
                 else {
                     regs.clearCarry();
                 }
-                return 1;
+                break;
         };
         { // COMPLEMENT
             case 0x2F: // CMA, complement accumulator
                 regs.A = ~regs.A;
-                return 1;
+                break;
             case 0x3F: // CMC, complement carry
                 regs.toggleCarry();
-                return 1;
+                break;
         };
         { // STC
             case 0x37:
                 regs.setCarry();
-                return 1;
+                break;
         };
         // BRANCH GROUP
         { // JMP
-            case 0xC3: // conditional
+            case 0xC3: // unconditional
+            case 0xCB: // undocumented JMP
                 regs.PC = read16atPC();
-                return 3;
+                break;
             case 0xC2: // JNZ, jump if not zero
+                address = read16atPC(); // skipped when the jump is not taken
                 if (!regs.getZero()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xCA: // JZ, jump if zero
+                address = read16atPC(); // skipped when the jump is not taken
                 if (regs.getZero()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xD2: // JNC, jump if carry not set
+                address = read16atPC(); // skipped when the jump is not taken
                 if (!regs.getCarry()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xDA: // JC, jump if carry set
+                address = read16atPC(); // skipped when the jump is not taken
                 if (regs.getCarry()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xE2: // JPO, jump if parity not set, odd parity
+                address = read16atPC(); // skipped when the jump is not taken
                 if (!regs.getParity()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xEA: // JPE, jump if parity set, even parity
+                address = read16atPC(); // skipped when the jump is not taken
                 if (regs.getParity()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xF2: // JP, jump if sign plus, not set
+                address = read16atPC(); // skipped when the jump is not taken
                 if (!regs.getSign()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
             case 0xFA: // JM, jump if sign minus, set
+                address = read16atPC(); // skipped when the jump is not taken
                 if (regs.getSign()) {
-                    regs.PC = read16atPC();
+                    regs.PC = address;
                 }
-                return 3;
+                break;
         };
         { // CALL
             case 0xCD: // CALL unconditional
-                memory.write(regs.SP-1, (regs.PC & 0xF0) >> 8);
-                memory.write(regs.SP-2, regs.PC & 0x0F);
+            case 0xDD: case 0xED: case 0xFD: // undocumented CALL
+                address = read16atPC(); // the return address is the instruction after CALL
+                memory.write(regs.SP-1, regs.PC >> 8);
+                memory.write(regs.SP-2, regs.PC & 0xFF);
                 regs.SP -= 2;
-                regs.PC = read16atPC();
-                return 5;
+                regs.PC = address;
+                break;
+            case 0xC4: // CNZ, call if not zero
+                address = read16atPC();
+                if (!regs.getZero()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xCC: // CZ, call if zero
+                address = read16atPC();
+                if (regs.getZero()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xD4: // CNC, call if carry not set
+                address = read16atPC();
+                if (!regs.getCarry()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xDC: // CC, call if carry set
+                address = read16atPC();
+                if (regs.getCarry()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xE4: // CPO, call if parity odd
+                address = read16atPC();
+                if (!regs.getParity()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xEC: // CPE, call if parity even
+                address = read16atPC();
+                if (regs.getParity()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xF4: // CP, call if sign plus
+                address = read16atPC();
+                if (!regs.getSign()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xFC: // CM, call if sign minus
+                address = read16atPC();
+                if (regs.getSign()) {
+                    memory.write(regs.SP-1, regs.PC >> 8);
+                    memory.write(regs.SP-2, regs.PC & 0xFF);
+                    regs.SP -= 2;
+                    regs.PC = address;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+        };
+        { // RET
             case 0xC9: // RET, return from call
-                temp16 = 0;
-                temp16 += memory.read(regs.SP);
-                temp16 += memory.read(regs.SP+1) << 8;
+            case 0xD9: // undocumented RET
+                regs.PC = memory.read16(regs.SP);
+                regs.SP += 2;
+                break;
+            case 0xC0: // RNZ, return if not zero
+                if (!regs.getZero()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xC8: // RZ, return if zero
+                if (regs.getZero()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xD0: // RNC, return if carry not set
+                if (!regs.getCarry()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xD8: // RC, return if carry set
+                if (regs.getCarry()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xE0: // RPO, return if parity odd
+                if (!regs.getParity()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xE8: // RPE, return if parity even
+                if (regs.getParity()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xF0: // RP, return if sign plus
+                if (!regs.getSign()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xF8: // RM, return if sign minus
+                if (regs.getSign()) {
+                    regs.PC = memory.read16(regs.SP);
+                    regs.SP += 2;
+                    return isa::opcodes[opcode].cycles + isa::opcodes[opcode].takenCycles;
+                }
+                break;
+            case 0xE9: // PCHL, jump to HL
+                regs.PC = regs.readHL();
+                break;
+        }
+        { // RST, a one byte CALL to n * 8
+            case 0xC7: case 0xCF: case 0xD7: case 0xDF: case 0xE7: case 0xEF: case 0xF7: case 0xFF:
+                memory.write(regs.SP-1, regs.PC >> 8);
+                memory.write(regs.SP-2, regs.PC & 0xFF);
+                regs.SP -= 2;
+                regs.PC = opcode & 0b00111000;
+                break;
+        }
+        { // INTERRUPTS
+            case 0xFB: // EI
+                regs.interruptsEnabled = true;
+                break;
+            case 0xF3: // DI
+                regs.interruptsEnabled = false;
+                break;
+            case 0x76: // HLT, spins on itself until interrupt steps over it
+                regs.halted = true;
+                regs.PC = initialPC;
+                break;
+        }
+        { // I/O
+            case 0xDB: // IN
+                regs.A = ports.in(memory.read(regs.PC++));
+                break;
+            case 0xD3: // OUT
+                ports.out(memory.read(regs.PC++), regs.A);
+                break;
+        }
+        { // STACK
+            case 0xC5: // PUSH B
+                memory.write(regs.SP-1, regs.B);
+                memory.write(regs.SP-2, regs.C);
+                regs.SP -= 2;
+                break;
+            case 0xD5: // PUSH D
+                memory.write(regs.SP-1, regs.D);
+                memory.write(regs.SP-2, regs.E);
+                regs.SP -= 2;
+                break;
+            case 0xE5: // PUSH H
+                memory.write(regs.SP-1, regs.H);
+                memory.write(regs.SP-2, regs.L);
+                regs.SP -= 2;
+                break;
+            case 0xF5: // PUSH PSW
+                memory.write(regs.SP-1, regs.A);
+                memory.write(regs.SP-2, regs.getF() | 0b00000010); // bit 1 always reads as 1
+                regs.SP -= 2;
+                break;
+            case 0xC1: // POP B
+                regs.C = memory.read(regs.SP);
+                regs.B = memory.read(regs.SP+1);
+                regs.SP += 2;
+                break;
+            case 0xD1: // POP D
+                regs.E = memory.read(regs.SP);
+                regs.D = memory.read(regs.SP+1);
+                regs.SP += 2;
+                break;
+            case 0xE1: // POP H
+                regs.L = memory.read(regs.SP);
+                regs.H = memory.read(regs.SP+1);
                 regs.SP += 2;
-                regs.PC = temp16;
-                return 3;
+                break;
+            case 0xF1: // POP PSW
+                regs.setF(memory.read(regs.SP) & 0b11010101); // only the 5 flag bits
+                regs.A = memory.read(regs.SP+1);
+                regs.SP += 2;
+                break;
+            case 0xE3: // XTHL, exchange HL with the top of the stack
+                temp16 = memory.read16(regs.SP);
+                memory.write(regs.SP, regs.L);
+                memory.write(regs.SP+1, regs.H);
+                regs.setHL(temp16);
+                break;
+            case 0xF9: // SPHL
+                regs.SP = regs.readHL();
+                break;
         }
         default:
             UnimplementedInstruction(initialPC);
             return 0;
-    }   
+    }
+    return isa::opcodes[opcode].cycles;
 }
\ No newline at end of file
@@ -0,0 +1,133 @@
+#include "fleet.hpp"
+#include "pacer.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <thread>
+
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+Fleet::Fleet(const Cpu& boot, size_t count) {
+    for (size_t i = 0; i < count; i++) {
+        instances.push_back(std::make_unique<Instance>(Instance{boot}));
+    }
+}
+
+void Fleet::pin(unsigned core) {
+#if defined(__linux__)
+    cpu_set_t cores;
+    CPU_ZERO(&cores);
+    CPU_SET(core % std::max(1u, std::thread::hardware_concurrency()), &cores); // 0 cores when they are not known
+    pthread_setaffinity_np(pthread_self(), sizeof(cores), &cores); // best effort, a worker that stays unpinned still works
+#else
+    (void)core;
+#endif
+}
+
+void Fleet::run(uint64_t frames, unsigned count, bool pinned) {
+    const auto start = std::chrono::steady_clock::now();
+    uint64_t cyclesBefore = 0;
+    for (const auto& instance : instances) {
+        cyclesBefore += instance->cpu.getCycles();
+        instance->target = instance->frames + frames;
+    }
+
+    // Deal the instances out round robin
+    count = std::max(1u, count);
+    std::vector<std::unique_ptr<Worker>> workers;
+    for (unsigned i = 0; i < count; i++) {
+        workers.push_back(std::make_unique<Worker>());
+    }
+    for (size_t i = 0; i < instances.size(); i++) {
+        workers[i % count]->queue.push_back(i);
+    }
+
+    std::atomic<size_t> remaining = frames > 0 ? instances.size() : 0;
+    std::vector<std::thread> threads;
+    for (unsigned i = 0; i < count; i++) {
+        threads.emplace_back([&, i] {
+            if (pinned) {
+                pin(i);
+            }
+            work(workers, i, remaining);
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+
+    elapsed = std::chrono::steady_clock::now() - start;
+    runCycles = 0;
+    for (const auto& instance : instances) {
+        runCycles += instance->cpu.getCycles();
+    }
+    runCycles -= cyclesBefore;
+    runSteals = 0;
+    for (const auto& worker : workers) {
+        runSteals += worker->steals;
+    }
+}
+
+void Fleet::work(std::vector<std::unique_ptr<Worker>>& workers, size_t self, std::atomic<size_t>& remaining) {
+    Worker& own = *workers[self];
+    while (remaining.load(std::memory_order_acquire) > 0) {
+        size_t index = SIZE_MAX;
+        {
+            std::lock_guard guard(own.lock);
+            if (!own.queue.empty()) {
+                index = own.queue.back();
+                own.queue.pop_back();
+            }
+        }
+        // Steal the oldest slice of the next worker that has one
+        for (size_t i = 1; index == SIZE_MAX && i < workers.size(); i++) {
+            Worker& victim = *workers[(self + i) % workers.size()];
+            std::lock_guard guard(victim.lock);
+            if (!victim.queue.empty()) {
+                index = victim.queue.front();
+                victim.queue.pop_front();
+                own.steals++;
+            }
+        }
+        if (index == SIZE_MAX) {
+            std::this_thread::yield(); // the others still run the last slices
+            continue;
+        }
+
+        // One frame, then back on the own queue so the instance stays in this core's cache unless stolen
+        Instance& instance = *instances[index];
+        const uint64_t budget = Pacer::CYCLES_PER_FRAME - instance.overshoot;
+        instance.overshoot = instance.cpu.run(budget);
+        if (++instance.frames < instance.target) {
+            std::lock_guard guard(own.lock);
+            own.queue.push_back(index);
+        } else {
+            remaining.fetch_sub(1, std::memory_order_release);
+        }
+    }
+}
+
+double Fleet::seconds() const {
+    return std::chrono::duration<double>(elapsed).count();
+}
+
+double Fleet::emulatedMHz() const {
+    const double wall = seconds();
+    return wall > 0 ? runCycles / wall / 1e6 : 0;
+}
+
+void Fleet::report(std::ostream& out, bool perInstance) const {
+    out << std::fixed << std::setprecision(2) << instances.size() << " instances: "
+        << emulatedMHz() << " MHz emulated in " << seconds() * 1000 << " ms, "
+        << emulatedMHz() * 1e6 / Pacer::CLOCK_HZ << "x real time, " << runSteals << " steals\n";
+    if (perInstance) {
+        for (size_t i = 0; i < instances.size(); i++) {
+            const Progress done = progress(i);
+            out << "  " << i << ": " << done.frames << " frames, " << done.cycles << " cycles\n";
+        }
+    }
+    out << std::defaultfloat;
+}
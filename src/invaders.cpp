@@ -0,0 +1,25 @@
+#include "invaders.hpp"
+
+#include <algorithm>
+
+void invaders::map(Memory& memory, const RomImage& rom) {
+    memory.mapRom(ROM, rom.data(), std::min<size_t>(rom.size(), ROM_SIZE));
+    memory.mapRam(RAM, RAM_SIZE + VRAM_SIZE);
+    for (uint32_t address = MIRROR; address < 0x10000; address += MIRROR) {
+        memory.mirror(address, MIRROR, ROM);
+    }
+}
+
+invaders::Screen::Screen(Cpu& cpu) : event(cpu.getScheduler().add(interrupt)) {
+    cpu.getScheduler().schedule(event, next(cpu.getCycles()));
+}
+
+uint64_t invaders::Screen::next(uint64_t cycle) {
+    const uint64_t frame = cycle - cycle % Pacer::CYCLES_PER_FRAME;
+    return cycle % Pacer::CYCLES_PER_FRAME < MIDDLE ? frame + MIDDLE : frame + Pacer::CYCLES_PER_FRAME;
+}
+
+uint64_t invaders::Screen::interrupt(void*, Cpu& cpu, uint64_t cycle) {
+    cpu.interrupt(cycle % Pacer::CYCLES_PER_FRAME == MIDDLE ? 1 : 2);
+    return next(cycle);
+}
@@ -0,0 +1,19 @@
+#include "isa.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+std::string isa::disassemble(const Memory &memory, uint16_t address) {
+    const Opcode& opcode = opcodes[memory.read(address)];
+    std::string mnemonic = opcode.mnemonic;
+    if (opcode.length == 1) {
+        return mnemonic;
+    }
+
+    // The operand placeholder is always the end of the mnemonic
+    std::ostringstream text;
+    text << mnemonic.substr(0, mnemonic.size() - (opcode.length == 2 ? 2 : 3)) << '$'
+         << std::hex << std::uppercase << std::setfill('0') << std::setw(opcode.length == 2 ? 2 : 4)
+         << (opcode.length == 2 ? memory.read(address + 1) : memory.read16(address + 1));
+    return text.str();
+}
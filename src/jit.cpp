@@ -0,0 +1,272 @@
+#include "jit.hpp"
+
+#include <cstring>
+
+#include "cpu.hpp"
+#include "isa.hpp"
+
+#if defined(__x86_64__) && defined(__unix__)
+#include <sys/mman.h>
+#define JIT_X86_64
+#endif
+
+// CODE BUFFER
+
+Jit::~Jit() {
+#if defined(JIT_X86_64)
+    if (buffer != nullptr) {
+        munmap(buffer, BUFFER_SIZE);
+    }
+#endif
+}
+
+bool Jit::available() {
+#if defined(JIT_X86_64)
+    return true;
+#else
+    return false;
+#endif
+}
+
+bool Jit::compilable(uint16_t address) const {
+    auto found = rewrites.find(address);
+    return available() && (found == rewrites.end() || found->second < MAX_REWRITES);
+}
+
+Jit::Native Jit::install(uint16_t address, const std::vector<uint8_t>& bytes) {
+#if defined(JIT_X86_64)
+    if (buffer == nullptr) {
+        void* mapped = mmap(nullptr, BUFFER_SIZE, PROT_READ | PROT_WRITE | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (mapped == MAP_FAILED) {
+            return nullptr;
+        }
+        buffer = static_cast<uint8_t*>(mapped);
+    }
+    if (bytes.size() > BUFFER_SIZE) {
+        return nullptr;
+    }
+    if (used + bytes.size() > BUFFER_SIZE) {
+        flush();
+    }
+
+    uint8_t* start = buffer + used;
+    std::memcpy(start, bytes.data(), bytes.size());
+    used += (bytes.size() + 15) & ~size_t(15); // keep blocks 16 byte aligned
+
+    Native native = reinterpret_cast<Native>(start);
+    code[address] = native;
+    return native;
+#else
+    (void)address;
+    (void)bytes;
+    return nullptr;
+#endif
+}
+
+void Jit::drop(uint16_t address) {
+    if (code.erase(address)) {
+        rewrites[address]++;
+    }
+}
+
+void Jit::flush() {
+    code.clear();
+    used = 0;
+}
+
+// TRANSLATION
+
+namespace {
+    // Native code keeps the Cpu in rbx and the T-states so far in r12d, for System V calls
+    class Emitter {
+        public:
+            std::vector<uint8_t> bytes;
+
+            void emit(std::initializer_list<uint8_t> code) { bytes.insert(bytes.end(), code); }
+            void emit32(uint32_t value) { for (int i = 0; i < 4; i++) bytes.push_back(value >> (8 * i)); }
+            void emit64(uint64_t value) { for (int i = 0; i < 8; i++) bytes.push_back(value >> (8 * i)); }
+
+            void loadByte(uint32_t offset) { emit({0x0F, 0xB6, 0x83}); emit32(offset); } // movzx eax, byte [rbx+offset]
+            void loadByteEcx(uint32_t offset) { emit({0x0F, 0xB6, 0x8B}); emit32(offset); } // movzx ecx, byte [rbx+offset]
+            void storeByte(uint32_t offset) { emit({0x88, 0x83}); emit32(offset); } // mov [rbx+offset], al
+            void storeByteCl(uint32_t offset) { emit({0x88, 0x8B}); emit32(offset); } // mov [rbx+offset], cl
+            void storeByteAh(uint32_t offset) { emit({0x88, 0xA3}); emit32(offset); } // mov [rbx+offset], ah
+            void storeImmediate(uint32_t offset, uint8_t value) { emit({0xC6, 0x83}); emit32(offset); emit({value}); } // mov byte [rbx+offset], value
+            void storeImmediate16(uint32_t offset, uint16_t value) { // mov word [rbx+offset], value
+                emit({0x66, 0xC7, 0x83});
+                emit32(offset);
+                emit({static_cast<uint8_t>(value), static_cast<uint8_t>(value >> 8)});
+            }
+            void addCycles(uint32_t cycles) { if (cycles != 0) { emit({0x41, 0x81, 0xC4}); emit32(cycles); } } // add r12d, cycles
+            void addExecuted(uint32_t offset) { emit({0x4C, 0x01, 0xA3}); emit32(offset); } // add [rbx+offset], r12
+            void subExecuted(uint32_t offset) { emit({0x4C, 0x29, 0xA3}); emit32(offset); } // sub [rbx+offset], r12
+
+            void prologue() {
+                emit({0x53, 0x41, 0x54, 0x41, 0x55}); // push rbx; push r12; push r13, which also aligns the stack for calls
+                emit({0x48, 0x89, 0xFB}); // mov rbx, rdi
+                emit({0x45, 0x31, 0xE4}); // xor r12d, r12d
+            }
+            void epilogue() {
+                emit({0x44, 0x89, 0xE0}); // mov eax, r12d
+                emit({0x41, 0x5D, 0x41, 0x5C, 0x5B, 0xC3}); // pop r13; pop r12; pop rbx; ret
+            }
+            static constexpr uint8_t EPILOGUE_SIZE = 9;
+
+            void call(uint64_t function) {
+                emit({0x48, 0x89, 0xDF}); // mov rdi, rbx
+                emit({0x48, 0xB8}); emit64(function); // mov rax, function
+                emit({0xFF, 0xD0}); // call rax
+            }
+            void call(uint64_t function, uint64_t argument) {
+                emit({0x48, 0xBE}); emit64(argument); // mov rsi, argument
+                call(function);
+            }
+    };
+
+    constexpr uint32_t STOP = 0x80000000; // set by jitStep in the returned T-states when the block has to end
+}
+
+uint32_t Cpu::jitStep(Cpu* cpu, Handler handler) {
+    const uint32_t cycles = handler(*cpu);
+    return cpu->memory.codeWrites().empty() ? cycles : cycles | STOP;
+}
+
+void Cpu::compile(uint16_t address, const Block& block) {
+    auto offset = [this](const void* member) {
+        return static_cast<uint32_t>(static_cast<const uint8_t*>(member) - reinterpret_cast<const uint8_t*>(this));
+    };
+    const uint32_t reg[8] = {
+        offset(&regs.B), offset(&regs.C), offset(&regs.D), offset(&regs.E), offset(&regs.H), offset(&regs.L), 0, offset(&regs.A)
+    };
+    const uint32_t PC = offset(&regs.PC);
+    const uint32_t SP = offset(&regs.SP);
+    [[maybe_unused]] const uint32_t F = offset(&regs.F);
+
+    Emitter code;
+    code.prologue();
+    uint32_t pending = 0; // T-states of translated instructions not yet added to r12d
+    bool pcKnown = false; // PC was left right by the last instruction
+
+    uint16_t pc = address;
+    for (size_t i = 0; i < block.instructions; i++) {
+        const uint8_t opcode = memory.read(pc);
+        const isa::Opcode& info = isa::opcodes[opcode];
+        const uint8_t ddd = (opcode >> 3) & 0b111;
+        const uint8_t sss = opcode & 0b111;
+        const uint8_t rp = (opcode >> 4) & 0b11;
+        const uint16_t operand = info.length == 3 ? memory.read16(pc + 1) : memory.read(pc + 1);
+        pcKnown = false;
+
+        if ((opcode & 0b11000111) == 0b00000000) { // NOP
+        } else if ((opcode & 0b11000000) == 0b01000000 && ddd != 6 && sss != 6) { // MOV r, r
+            code.loadByte(reg[sss]);
+            code.storeByte(reg[ddd]);
+        } else if ((opcode & 0b11000111) == 0b00000110 && ddd != 6) { // MVI r
+            code.storeImmediate(reg[ddd], operand);
+        } else if ((opcode & 0b11001111) == 0b00000001) { // LXI
+            if (rp == 3) {
+                code.storeImmediate16(SP, operand);
+            } else {
+                code.storeImmediate(reg[rp * 2], operand >> 8);
+                code.storeImmediate(reg[rp * 2 + 1], operand & 0xFF);
+            }
+        } else if ((opcode & 0b11000111) == 0b00000011) { // INX, DCX
+            const bool increment = (opcode & 0b00001000) == 0;
+            if (rp == 3) {
+                code.emit({0x66, 0xFF, static_cast<uint8_t>(increment ? 0x83 : 0x8B)}); // inc/dec word [rbx+SP]
+                code.emit32(SP);
+            } else {
+                code.loadByte(reg[rp * 2 + 1]);
+                code.loadByteEcx(reg[rp * 2]);
+                code.emit({0xC1, 0xE1, 0x08}); // shl ecx, 8
+                code.emit({0x09, 0xC8}); // or eax, ecx
+                code.emit({0xFF, static_cast<uint8_t>(increment ? 0xC0 : 0xC8)}); // inc/dec eax
+                code.storeByte(reg[rp * 2 + 1]);
+                code.storeByteAh(reg[rp * 2]);
+            }
+        } else if (opcode == 0xEB) { // XCHG
+            for (uint8_t r : {2, 3}) {
+                code.loadByte(reg[r]);
+                code.loadByteEcx(reg[r + 2]);
+                code.storeByteCl(reg[r]);
+                code.storeByte(reg[r + 2]);
+            }
+        } else if ((opcode & 0b11110111) == 0b11000011) { // JMP
+            code.storeImmediate16(PC, operand);
+            pcKnown = true;
+#if !defined(LAZY_FLAGS)
+        } else if ((opcode & 0b11000111) == 0b11000010) { // Jcc, the condition is a flag in F
+            constexpr uint8_t flags[4] = {Registers::ZERO_FLAG, Registers::CARRY_FLAG, Registers::PARITY_FLAG, Registers::SIGN_FLAG};
+            const bool whenSet = ddd & 1;
+            code.storeImmediate16(PC, pc + info.length);
+            code.emit({0xF6, 0x83}); code.emit32(F); code.emit({flags[ddd >> 1]}); // test byte [rbx+F], flag
+            code.emit({static_cast<uint8_t>(whenSet ? 0x74 : 0x75), 9}); // jz/jnz over the store below when not taken
+            code.storeImmediate16(PC, operand);
+            pcKnown = true;
+#endif
+        } else if (!isa::writesMemory(opcode)) {
+            // Cannot write code, so the handler is called directly. PC only matters for operands and branches.
+            code.addCycles(pending);
+            pending = 0;
+            const bool setsPC = isa::branches(opcode) || opcode == 0x76; // HLT steps back onto itself
+            if (info.length > 1 || setsPC) {
+                code.storeImmediate16(PC, pc + 1);
+            }
+            if (isa::io(opcode)) { // devices see cycles with the block so far added in, like atCycle
+                code.addExecuted(offset(&cycles));
+                code.call(reinterpret_cast<uint64_t>(handlers[opcode]));
+                code.subExecuted(offset(&cycles));
+            } else {
+                code.call(reinterpret_cast<uint64_t>(handlers[opcode]));
+            }
+            code.emit({0x41, 0x01, 0xC4}); // add r12d, eax
+            pc += info.length;
+            pcKnown = info.length > 1 || setsPC;
+            continue;
+        } else {
+            // Everything else runs its handler, which reads its operands at PC like the interpreter
+            code.addCycles(pending);
+            pending = 0;
+            code.storeImmediate16(PC, pc + 1);
+            code.call(reinterpret_cast<uint64_t>(&Cpu::jitStep), reinterpret_cast<uint64_t>(handlers[opcode]));
+            code.emit({0x89, 0xC1}); // mov ecx, eax
+            code.emit({0x81, 0xE1}); code.emit32(~STOP); // and ecx, ~STOP
+            code.emit({0x41, 0x01, 0xCC}); // add r12d, ecx
+            code.emit({0x85, 0xC0}); // test eax, eax
+            code.emit({0x79, Emitter::EPILOGUE_SIZE}); // jns over the early exit
+            code.epilogue();
+            pc += info.length;
+            pcKnown = true;
+            continue;
+        }
+        pending += info.cycles;
+        pc += info.length;
+    }
+
+    code.addCycles(pending);
+    if (!pcKnown) {
+        code.storeImmediate16(PC, pc);
+    }
+    code.epilogue();
+    jit.install(address, code.bytes);
+}
+
+uint64_t Cpu::decodeJit(uint64_t budget) {
+    if (!memory.codeWrites().empty()) {
+        invalidateCode();
+    }
+
+    const uint16_t address = regs.PC;
+    if (Jit::Native native = jit.find(address)) {
+        nativeRuns++;
+        return native(this);
+    }
+
+    // Cold, or not compilable: interpret and count towards compiling
+    const uint64_t executed = decodeBlock(budget);
+    auto found = blocks.find(address);
+    if (found != blocks.end() && ++found->second.runs == Jit::HOT && jit.compilable(address)) {
+        compile(address, found->second);
+    }
+    return executed;
+}
@@ -1,24 +1,70 @@
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 
 #include "cpu.hpp"
+#include "invaders.hpp"
+#include "pacer.hpp"
+
+#if defined(RECOMPILED)
+extern const recompiled::Rom RECOMPILED; // from the static recompiler, see tools/CMakeLists.txt
+#endif
+
+int main(int argc, char* argv[]) {
+    unsigned turbo = 1;
+
+    for (int i = 1; i < argc; i++) {
+        if (std::strcmp(argv[i], "--turbo") == 0 && i + 1 < argc) {
+            char* end;
+            turbo = std::strtoul(argv[++i], &end, 10);
+            if (*end != '\0') {
+                std::cerr << "Invalid turbo factor: " << argv[i] << '\n';
+                return 1;
+            }
+        } else if (std::strcmp(argv[i], "--uncapped") == 0) {
+            turbo = 0;
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [--turbo N | --uncapped]\n";
+            return 1;
+        }
+    }
 
-int main() {
     Cpu cpu;
 
     //LOAD ROM
     const char* path = "../assets/invaders";
-    cpu.loadRom(path);
-    
-    int cycles = 0;
+    RomImage rom;
+    if (rom.open(path) != 0) {
+        return 1;
+    }
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+
+    Pacer pacer(turbo);
+    uint64_t overshoot = 0;
 
     while (true) {
-        if (cycles > 0) {
-            cycles--;
-            continue;
+        // Whatever the last instruction ran over the frame is taken off the next one
+        const uint64_t budget = Pacer::CYCLES_PER_FRAME - overshoot;
+#if defined(RECOMPILED)
+        overshoot = cpu.runRecompiled(RECOMPILED, budget);
+#else
+        overshoot = cpu.run(budget);
+#endif
+
+        if (pacer.frame(budget + overshoot)) {
+            pacer.report(std::cout);
+            std::cout << "idle: " << cpu.getSkippedCycles() << " cycles skipped of " << cpu.getCycles() << '\n';
+#if defined(CPU_DISPATCH_BLOCKS) || defined(CPU_DISPATCH_JIT)
+            const Cpu::BlockStats blocks = cpu.getBlockStats();
+            std::cout << "blocks: " << blocks.hits << " hits, " << blocks.misses << " misses, "
+                      << blocks.invalidations << " invalidations, " << blocks.compiled << " compiled, "
+                      << blocks.fusions << " superinstructions\n";
+#endif
         }
-        cycles = cpu.decode();
-        cycles--;
     }
     return 0;
-}
\ No newline at end of file
+}
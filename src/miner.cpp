@@ -0,0 +1,57 @@
+#include "miner.hpp"
+#include "isa.hpp"
+
+#include <algorithm>
+#include <iomanip>
+
+void SequenceMiner::record(uint8_t opcode) {
+    // Every sequence ending here that only falls through before its last opcode, and starts at any IN or OUT in it
+    if (isa::io(opcode)) {
+        window.clear();
+    }
+    window.push_back(opcode);
+    uint32_t key = opcode;
+    for (size_t length = 2; length <= window.size(); length++) {
+        key |= window[window.size() - length] << 8 * (length - 1);
+        counts[length << 24 | key]++;
+    }
+
+    if (!isa::fusable(opcode)) {
+        window.clear();
+    } else if (window.size() == MAX_LENGTH) {
+        window.erase(window.begin());
+    }
+}
+
+std::vector<SequenceMiner::Candidate> SequenceMiner::candidates(size_t limit, uint64_t minimum) const {
+    std::vector<Candidate> ranked;
+    for (const auto& [key, count] : counts) {
+        if (count < minimum) {
+            continue;
+        }
+        std::vector<uint8_t> opcodes;
+        for (int i = (key >> 24) - 1; i >= 0; i--) {
+            opcodes.push_back(key >> 8 * i);
+        }
+        ranked.push_back({opcodes, count});
+    }
+    std::stable_sort(ranked.begin(), ranked.end(), [](const Candidate& a, const Candidate& b) { return a.saved() > b.saved(); });
+    if (ranked.size() > limit) {
+        ranked.resize(limit);
+    }
+    return ranked;
+}
+
+void SequenceMiner::write(std::ostream& out, const std::vector<Candidate>& candidates) {
+    for (const Candidate& candidate : candidates) {
+        out << "FUSE(";
+        for (size_t i = 0; i < candidate.opcodes.size(); i++) {
+            out << (i ? ", " : "") << "0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(2) << int(candidate.opcodes[i]);
+        }
+        out << ") //";
+        for (const uint8_t opcode : candidate.opcodes) {
+            out << ' ' << isa::opcodes[opcode].mnemonic << ';';
+        }
+        out << std::dec << ' ' << candidate.count << " times\n";
+    }
+}
@@ -0,0 +1,511 @@
+#include <algorithm>
+#include <utility>
+
+#include "cpu.hpp"
+#include "isa.hpp"
+
+// Handlers for the table and threaded engines, the switch in Cpu::decodeSwitch is the reference.
+
+namespace {
+    constexpr uint8_t M = 6; // register encoding of the memory operand at HL
+    constexpr uint8_t IMMEDIATE = 8; // ALU source that reads the byte after the opcode
+    constexpr uint8_t ALWAYS = 8; // condition of the unconditional branches
+}
+
+// REGISTER ACCESS, by the encoding used in the opcodes: B C D E H L M A and BC DE HL SP
+
+template<uint8_t r> uint8_t Cpu::load() {
+    if constexpr (r == 0) return regs.B;
+    else if constexpr (r == 1) return regs.C;
+    else if constexpr (r == 2) return regs.D;
+    else if constexpr (r == 3) return regs.E;
+    else if constexpr (r == 4) return regs.H;
+    else if constexpr (r == 5) return regs.L;
+    else if constexpr (r == M) return memory.read(regs.readHL());
+    else return regs.A;
+}
+
+template<uint8_t r> void Cpu::store(uint8_t value) {
+    if constexpr (r == 0) regs.B = value;
+    else if constexpr (r == 1) regs.C = value;
+    else if constexpr (r == 2) regs.D = value;
+    else if constexpr (r == 3) regs.E = value;
+    else if constexpr (r == 4) regs.H = value;
+    else if constexpr (r == 5) regs.L = value;
+    else if constexpr (r == M) memory.write(regs.readHL(), value);
+    else regs.A = value;
+}
+
+template<uint8_t rp> uint16_t Cpu::loadPair() {
+    if constexpr (rp == 0) return regs.readBC();
+    else if constexpr (rp == 1) return regs.readDE();
+    else if constexpr (rp == 2) return regs.readHL();
+    else return regs.SP;
+}
+
+template<uint8_t rp> void Cpu::storePair(uint16_t value) {
+    if constexpr (rp == 0) regs.setBC(value);
+    else if constexpr (rp == 1) regs.setDE(value);
+    else if constexpr (rp == 2) regs.setHL(value);
+    else regs.SP = value;
+}
+
+// DATA TRANSFER GROUP
+
+template<uint8_t dst, uint8_t src> void Cpu::mov() {
+    store<dst>(load<src>());
+}
+
+template<uint8_t r> void Cpu::mvi() {
+    store<r>(memory.read(regs.PC++));
+}
+
+template<uint8_t rp> void Cpu::lxi() {
+    storePair<rp>(read16atPC());
+}
+
+// Register pair 3 is PSW here instead of SP: A and the packed flags
+template<uint8_t rp> void Cpu::push() {
+    const uint16_t value = rp == 3 ? regs.A << 8 | regs.getF() | 0b00000010 : loadPair<rp>(); // bit 1 of F always reads as 1
+    memory.write(regs.SP-1, value >> 8);
+    memory.write(regs.SP-2, value & 0xFF);
+    regs.SP -= 2;
+}
+
+template<uint8_t rp> void Cpu::pop() {
+    const uint16_t value = memory.read16(regs.SP);
+    regs.SP += 2;
+    if constexpr (rp == 3) {
+        regs.A = value >> 8;
+        regs.setF(value & 0b11010101); // only the 5 flag bits
+    } else {
+        storePair<rp>(value);
+    }
+}
+
+// ARITHMETIC AND LOGICAL GROUP
+
+// op is the ALU operation in bits 3-5: ADD ADC SUB SBB ANA XRA ORA CMP
+template<uint8_t op, uint8_t src> void Cpu::alu() {
+    uint8_t value;
+    if constexpr (src == IMMEDIATE) {
+        value = memory.read(regs.PC++);
+    } else {
+        value = load<src>();
+    }
+
+    uint16_t result;
+    if constexpr (op == 0) { // ADD
+        result = regs.A + value;
+        regs.setFlagsADD(result, regs.A, value);
+    } else if constexpr (op == 1) { // ADC
+        result = regs.A + value + regs.getCarry();
+        regs.setFlagsADD(result, regs.A, value);
+    } else if constexpr (op == 2 || op == 7) { // SUB, CMP
+        result = regs.A - value;
+        regs.setFlagsSUB(result, regs.A, value);
+    } else if constexpr (op == 3) { // SBB
+        result = regs.A - value - regs.getCarry();
+        regs.setFlagsSUB(result, regs.A, value);
+    } else if constexpr (op == 4) { // ANA, AC is the OR of bit 3 of both operands
+        result = regs.A & value;
+        regs.setFlagsLogic(result, (regs.A | value) & 0b00001000);
+    } else { // XRA, ORA, unset CY and AC
+        result = op == 5 ? regs.A ^ value : regs.A | value;
+        regs.setFlagsLogic(result, 0);
+    }
+
+    if constexpr (op != 7) { // CMP only sets the flags
+        regs.A = result;
+    }
+}
+
+template<uint8_t r> void Cpu::inr() {
+    const uint8_t value = load<r>();
+    const uint16_t result = value + 1;
+    regs.setFlagsADD(result, value, 1, Registers::KEEP_CARRY);
+    store<r>(result);
+}
+
+template<uint8_t r> void Cpu::dcr() {
+    const uint8_t value = load<r>();
+    const uint16_t result = value - 1;
+    regs.setFlagsSUB(result, value, 1, Registers::KEEP_CARRY);
+    store<r>(result);
+}
+
+template<uint8_t rp> void Cpu::inx() {
+    storePair<rp>(loadPair<rp>() + 1);
+}
+
+template<uint8_t rp> void Cpu::dcx() {
+    storePair<rp>(loadPair<rp>() - 1);
+}
+
+// Add register pair to HL, only sets carry flag based on double precision overflow
+template<uint8_t rp> void Cpu::dad() {
+    const uint32_t result = regs.readHL() + loadPair<rp>();
+    if (result > UINT16_MAX) {
+        regs.setCarry();
+    } else {
+        regs.clearCarry();
+    }
+    regs.setHL(result);
+}
+
+// BRANCH GROUP
+
+// cc is the condition in bits 3-5: NZ Z NC C PO PE P M
+template<uint8_t cc> bool Cpu::condition() {
+    if constexpr (cc == ALWAYS) {
+        return true;
+    } else {
+        uint8_t flag;
+        if constexpr (cc >> 1 == 0) flag = regs.getZero();
+        else if constexpr (cc >> 1 == 1) flag = regs.getCarry();
+        else if constexpr (cc >> 1 == 2) flag = regs.getParity();
+        else flag = regs.getSign();
+        return flag == (cc & 1); // odd conditions test for a set flag
+    }
+}
+
+template<uint8_t cc> void Cpu::jump() {
+    const uint16_t address = read16atPC(); // the address is skipped when the jump is not taken
+    if (condition<cc>()) {
+        regs.PC = address;
+    }
+}
+
+template<uint8_t cc> bool Cpu::call() {
+    const uint16_t address = read16atPC(); // the return address is the instruction after CALL
+    if (!condition<cc>()) {
+        return false;
+    }
+    memory.write(regs.SP-1, regs.PC >> 8);
+    memory.write(regs.SP-2, regs.PC & 0xFF);
+    regs.SP -= 2;
+    regs.PC = address;
+    return true;
+}
+
+template<uint8_t cc> bool Cpu::ret() {
+    if (!condition<cc>()) {
+        return false;
+    }
+    regs.PC = memory.read16(regs.SP);
+    regs.SP += 2;
+    return true;
+}
+
+template<uint8_t n> void Cpu::rst() { // a one byte CALL to n * 8, also what interrupting hardware puts on the bus
+    memory.write(regs.SP-1, regs.PC >> 8);
+    memory.write(regs.SP-2, regs.PC & 0xFF);
+    regs.SP -= 2;
+    regs.PC = n * 8;
+}
+
+// Opcodes that belong to a family are routed to its template by their bit fields,
+// the rest are explicit specializations of instruction below. The cycles come from the opcode table.
+template<uint8_t opcode> int Cpu::execute() {
+    constexpr uint8_t ddd = (opcode >> 3) & 0b111; // destination register, ALU operation or condition
+    constexpr uint8_t sss = opcode & 0b111; // source register
+    constexpr uint8_t rp = (opcode >> 4) & 0b11; // register pair
+    constexpr isa::Opcode info = isa::opcodes[opcode];
+
+    if constexpr ((opcode & 0b11000000) == 0b01000000 && opcode != 0x76) { // 0x76 is HLT, not MOV M,M
+        mov<ddd, sss>();
+    } else if constexpr ((opcode & 0b11000000) == 0b10000000) {
+        alu<ddd, sss>();
+    } else if constexpr ((opcode & 0b11000111) == 0b11000110) { // ADI ACI SUI SBI ANI XRI ORI CPI
+        alu<ddd, IMMEDIATE>();
+    } else if constexpr ((opcode & 0b11000111) == 0b00000110) {
+        mvi<ddd>();
+    } else if constexpr ((opcode & 0b11000111) == 0b00000100) {
+        inr<ddd>();
+    } else if constexpr ((opcode & 0b11000111) == 0b00000101) {
+        dcr<ddd>();
+    } else if constexpr ((opcode & 0b11001111) == 0b00000001) {
+        lxi<rp>();
+    } else if constexpr ((opcode & 0b11001111) == 0b00000011) {
+        inx<rp>();
+    } else if constexpr ((opcode & 0b11001111) == 0b00001011) {
+        dcx<rp>();
+    } else if constexpr ((opcode & 0b11001111) == 0b00001001) {
+        dad<rp>();
+    } else if constexpr ((opcode & 0b11001111) == 0b11000101) {
+        push<rp>();
+    } else if constexpr ((opcode & 0b11001111) == 0b11000001) {
+        pop<rp>();
+    } else if constexpr ((opcode & 0b11000111) == 0b00000000) { // NOP and its undocumented aliases
+    } else if constexpr ((opcode & 0b11000111) == 0b11000010) {
+        jump<ddd>();
+    } else if constexpr ((opcode & 0b11110111) == 0b11000011) { // JMP and its alias 0xCB
+        jump<ALWAYS>();
+    } else if constexpr ((opcode & 0b11000111) == 0b11000100) {
+        if (call<ddd>()) {
+            return info.cycles + info.takenCycles;
+        }
+    } else if constexpr ((opcode & 0b11001111) == 0b11001101) { // CALL and its aliases 0xDD 0xED 0xFD
+        call<ALWAYS>();
+    } else if constexpr ((opcode & 0b11000111) == 0b11000000) {
+        if (ret<ddd>()) {
+            return info.cycles + info.takenCycles;
+        }
+    } else if constexpr ((opcode & 0b11101111) == 0b11001001) { // RET and its alias 0xD9
+        ret<ALWAYS>();
+    } else if constexpr ((opcode & 0b11000111) == 0b11000111) {
+        rst<ddd>();
+    } else {
+        instruction<opcode>();
+    }
+    return info.cycles;
+}
+
+template<uint8_t opcode> void Cpu::instruction() {
+    UnimplementedInstruction(regs.PC - 1);
+}
+
+// DATA TRANSFER GROUP
+
+// LDA / LDAX
+template<> void Cpu::instruction<0x0A>() {
+    regs.A = memory.read(regs.readBC());
+}
+template<> void Cpu::instruction<0x1A>() {
+    regs.A = memory.read(regs.readDE());
+}
+template<> void Cpu::instruction<0x3A>() { // LDA
+    regs.A = memory.read(read16atPC());
+}
+
+// STA / STAX
+template<> void Cpu::instruction<0x02>() {
+    memory.write(regs.readBC(), regs.A);
+}
+template<> void Cpu::instruction<0x12>() {
+    memory.write(regs.readDE(), regs.A);
+}
+template<> void Cpu::instruction<0x32>() {
+    memory.write(read16atPC(), regs.A);
+}
+
+// HL stuff
+template<> void Cpu::instruction<0x2A>() { // LHLD
+    uint16_t address = read16atPC();
+    regs.L = memory.read(address);
+    regs.H = memory.read(address+1);
+}
+template<> void Cpu::instruction<0x22>() { // SHLD
+    uint16_t address = read16atPC();
+    memory.write(address, regs.L);
+    memory.write(address+1, regs.H);
+}
+template<> void Cpu::instruction<0xEB>() { // XCHG
+    uint16_t temp16 = regs.readHL();
+    regs.setHL(regs.readDE());
+    regs.setDE(temp16);
+}
+
+// ARITHMETIC GROUP
+
+// DAA
+template<> void Cpu::instruction<0x27>() {
+    uint8_t temp8 = 0;
+    if ((regs.A & 0x0F) > 9 || regs.getAuxCarry() == 1) {
+        temp8 += 6;
+    }
+    if ((regs.A + temp8) >> 4 > 9 || regs.getCarry() == 1) {
+        temp8 += 6 << 4;
+    }
+    uint16_t temp16 = regs.A + temp8;
+    regs.setFlagsADD(temp16, regs.A, temp8);
+    if (temp8 >> 4) { // the high digit was corrected, CY is set even when the addition does not carry
+        regs.setCarry();
+    }
+    regs.A = temp16;
+}
+
+// LOGICAL GROUP
+
+// ROTATE
+template<> void Cpu::instruction<0x07>() { // RLC, rotate left
+    uint8_t bit = (regs.A & 0b10000000) >> 7;
+    if (bit == 1) {
+        regs.setCarry();
+    } else {
+        regs.clearCarry();
+    }
+    uint8_t temp8 = regs.A << 1;
+    regs.A = temp8 + bit;
+}
+template<> void Cpu::instruction<0x0F>() { // RRC, rotate right
+    uint8_t bit = regs.A & 0b1;
+    if (bit == 1) {
+        regs.setCarry();
+    } else {
+        regs.clearCarry();
+    }
+    uint8_t temp8 = (regs.A >> 1) | (bit << 7);
+    regs.A = temp8;
+}
+template<> void Cpu::instruction<0x17>() { // RAL, rotate left through carry
+    uint8_t bit = (regs.A & 0b10000000) >> 7;
+    uint8_t temp8 = (regs.A << 1) + regs.getCarry();
+    regs.A = temp8;
+    if (bit == 1) {
+        regs.setCarry();
+    } else {
+        regs.clearCarry();
+    }
+}
+template<> void Cpu::instruction<0x1F>() { // RAR, rotate right through carry
+    uint8_t bit = regs.A & 0b1;
+    uint8_t temp8 = (regs.A >> 1) + (regs.getCarry() << 7);
+    regs.A = temp8;
+    if (bit == 1) {
+        regs.setCarry();
+    }
+    else {
+        regs.clearCarry();
+    }
+}
+
+// COMPLEMENT
+template<> void Cpu::instruction<0x2F>() { // CMA, complement accumulator
+    regs.A = ~regs.A;
+}
+template<> void Cpu::instruction<0x3F>() { // CMC, complement carry
+    regs.toggleCarry();
+}
+
+// STC
+template<> void Cpu::instruction<0x37>() {
+    regs.setCarry();
+}
+
+// BRANCH GROUP
+
+template<> void Cpu::instruction<0xE9>() { // PCHL
+    regs.PC = regs.readHL();
+}
+
+// STACK
+template<> void Cpu::instruction<0xE3>() { // XTHL, exchange HL with the top of the stack
+    const uint16_t value = memory.read16(regs.SP);
+    memory.write(regs.SP, regs.L);
+    memory.write(regs.SP+1, regs.H);
+    regs.setHL(value);
+}
+template<> void Cpu::instruction<0xF9>() { // SPHL
+    regs.SP = regs.readHL();
+}
+
+// I/O
+template<> void Cpu::instruction<0xDB>() { // IN
+    regs.A = ports.in(memory.read(regs.PC++));
+}
+template<> void Cpu::instruction<0xD3>() { // OUT
+    ports.out(memory.read(regs.PC++), regs.A);
+}
+
+// INTERRUPTS
+template<> void Cpu::instruction<0xFB>() { // EI
+    regs.interruptsEnabled = true;
+}
+template<> void Cpu::instruction<0xF3>() { // DI
+    regs.interruptsEnabled = false;
+}
+template<> void Cpu::instruction<0x76>() { // HLT, spins on itself until interrupt steps over it
+    regs.halted = true;
+    regs.PC--;
+}
+
+const std::array<Cpu::Handler, 0x100> Cpu::handlers = []<std::size_t... opcode>(std::index_sequence<opcode...>) {
+    return std::array<Handler, 0x100>{ &Cpu::dispatch<opcode>... };
+}(std::make_index_sequence<0x100>{});
+
+// SUPERINSTRUCTIONS
+
+// The block loop steps PC over the first opcode, the others are stepped over here
+template<uint8_t first, uint8_t... rest> int Cpu::fused(Cpu& cpu) {
+    int cycles = cpu.execute<first>();
+    ((cpu.regs.PC++, cycles += cpu.execute<rest>()), ...);
+    return cycles;
+}
+
+template<uint8_t... opcodes> Cpu::Superinstruction Cpu::superinstruction() {
+    constexpr std::array<uint8_t, sizeof...(opcodes)> sequence = {opcodes...};
+    static_assert(sequence.size() >= 2 && sequence.size() <= 3);
+    static_assert(std::all_of(sequence.begin(), sequence.end() - 1, isa::fusable), "only the last opcode may leave the sequence");
+    static_assert(std::none_of(sequence.begin() + 1, sequence.end(), isa::io), "IN and OUT only see the cycle the sequence starts at");
+    return {{opcodes...}, sizeof...(opcodes), &Cpu::fused<opcodes...>};
+}
+
+const std::vector<Cpu::Superinstruction> Cpu::superinstructions = {
+#define FUSE(...) superinstruction<__VA_ARGS__>(),
+#include "superinstructions.inc"
+#undef FUSE
+};
+
+int Cpu::decodeTable() {
+    const uint8_t opcode = memory.read(regs.PC++);
+    return handlers[opcode](*this);
+}
+
+#if defined(__GNUC__)
+// Expands X(op) for every opcode 0x00 - 0xFF
+#define OPCODE_ROW(r) X(r##0) X(r##1) X(r##2) X(r##3) X(r##4) X(r##5) X(r##6) X(r##7) \
+                      X(r##8) X(r##9) X(r##A) X(r##B) X(r##C) X(r##D) X(r##E) X(r##F)
+#define ALL_OPCODES OPCODE_ROW(0x0) OPCODE_ROW(0x1) OPCODE_ROW(0x2) OPCODE_ROW(0x3) \
+                    OPCODE_ROW(0x4) OPCODE_ROW(0x5) OPCODE_ROW(0x6) OPCODE_ROW(0x7) \
+                    OPCODE_ROW(0x8) OPCODE_ROW(0x9) OPCODE_ROW(0xA) OPCODE_ROW(0xB) \
+                    OPCODE_ROW(0xC) OPCODE_ROW(0xD) OPCODE_ROW(0xE) OPCODE_ROW(0xF)
+
+uint64_t Cpu::decodeThreaded(uint64_t count) {
+    return threaded<false>(count);
+}
+
+template<bool budgeted>
+uint64_t Cpu::threaded(uint64_t limit) {
+    // Every handler ends in its own indirect jump, so the branch predictor gets a history per opcode
+    // instead of sharing the single jump of the switch or table loop.
+    #define X(op) &&op_##op,
+    static void* const labels[0x100] = { ALL_OPCODES };
+    #undef X
+
+    uint64_t executed = 0;
+    if (limit == 0) {
+        return 0;
+    }
+    goto *labels[memory.read(regs.PC++)];
+
+    #define X(op) \
+    op_##op: \
+        executed += isa::io(op) ? atCycle(executed, [this] { return execute<op>(); }) : execute<op>(); \
+        if (budgeted ? executed >= limit : --limit == 0) { \
+            return executed; \
+        } \
+        goto *labels[memory.read(regs.PC++)];
+    ALL_OPCODES
+    #undef X
+}
+
+#undef ALL_OPCODES
+#undef OPCODE_ROW
+#else
+uint64_t Cpu::decodeThreaded(uint64_t count) {
+    return threaded<false>(count);
+}
+
+template<bool budgeted>
+uint64_t Cpu::threaded(uint64_t limit) {
+    // No labels as values, fall back to the table
+    uint64_t executed = 0;
+    while (budgeted ? executed < limit : limit-- > 0) {
+        executed += atCycle(executed, [this] { return decodeTable(); });
+    }
+    return executed;
+}
+#endif
+
+template uint64_t Cpu::threaded<true>(uint64_t limit);
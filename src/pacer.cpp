@@ -0,0 +1,53 @@
+#include "pacer.hpp"
+
+#include <iomanip>
+#include <thread>
+
+Pacer::Pacer(unsigned turbo) : turbo(turbo) {
+    epoch = Clock::now();
+    frameStart = epoch;
+    windowStart = epoch;
+}
+
+bool Pacer::frame(uint64_t executed) {
+    Clock::time_point now = Clock::now();
+    busy += now - frameStart;
+    cycles += executed;
+
+    if (turbo != 0) {
+        const std::chrono::nanoseconds period(1'000'000'000 / (FRAME_HZ * turbo));
+        frames++;
+        const Clock::time_point deadline = epoch + std::chrono::nanoseconds(frames * 1'000'000'000 / (FRAME_HZ * turbo));
+
+        if (now - deadline > period) {
+            // More than a frame behind, start over instead of racing to catch up
+            epoch = now;
+            frames = 0;
+        } else {
+            std::this_thread::sleep_until(deadline);
+            now = Clock::now();
+        }
+    }
+
+    frameStart = now;
+    return now - windowStart >= std::chrono::seconds(1);
+}
+
+double Pacer::emulatedMHz() const {
+    const std::chrono::duration<double, std::micro> wall = frameStart - windowStart;
+    return wall.count() > 0 ? cycles / wall.count() : 0;
+}
+
+double Pacer::hostUtilization() const {
+    const Clock::duration wall = frameStart - windowStart;
+    return wall.count() > 0 ? static_cast<double>(busy.count()) / wall.count() : 0;
+}
+
+void Pacer::report(std::ostream &out) {
+    out << std::fixed << std::setprecision(3) << emulatedMHz() << " MHz emulated, "
+        << std::setprecision(1) << hostUtilization() * 100 << "% host CPU\n";
+
+    windowStart = frameStart;
+    busy = Clock::duration{0};
+    cycles = 0;
+}
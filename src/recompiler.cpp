@@ -0,0 +1,247 @@
+#include "recompiler.hpp"
+#include "isa.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+namespace {
+    constexpr uint8_t M = 6; // register encoding of the memory operand at HL
+
+    const char* const REGISTERS[] = { "regs.B", "regs.C", "regs.D", "regs.E", "regs.H", "regs.L", "", "regs.A" };
+    const char* const PAIRS[] = { "regs.readBC()", "regs.readDE()", "regs.readHL()", "regs.SP" };
+    const char* const FLAGS[] = { "regs.getZero()", "regs.getCarry()", "regs.getParity()", "regs.getSign()" };
+
+    std::string hex(uint32_t value, int digits = 4) {
+        std::ostringstream text;
+        text << "0x" << std::hex << std::uppercase << std::setfill('0') << std::setw(digits) << value;
+        return text.str();
+    }
+
+    std::string name(uint16_t address) {
+        std::ostringstream text;
+        text << "block_" << std::hex << std::setfill('0') << std::setw(4) << address;
+        return text.str();
+    }
+
+    std::string load(uint8_t r) {
+        return r == M ? "memory.read(regs.readHL())" : REGISTERS[r];
+    }
+
+    std::string store(uint8_t r, const std::string& value) {
+        return r == M ? "memory.write(regs.readHL(), " + value + ");" : std::string(REGISTERS[r]) + " = " + value + ";";
+    }
+
+    std::string storePair(uint8_t rp, const std::string& value) {
+        static const char* const setters[] = { "regs.setBC(", "regs.setDE(", "regs.setHL(" };
+        return rp == 3 ? "regs.SP = " + value + ";" : setters[rp] + value + ");";
+    }
+
+    // cc is the condition in bits 3-5: NZ Z NC C PO PE P M, odd conditions test for a set flag
+    std::string condition(uint8_t cc) {
+        std::string flag = FLAGS[cc >> 1];
+        return cc & 1 ? flag : '!' + flag;
+    }
+}
+
+Recompiler::Recompiler(const Memory& rom, uint32_t size) : rom(rom), size(std::min<uint32_t>(size, 0x10000)), reached(this->size) {
+    std::vector<uint16_t> entries;
+    for (uint16_t vector = 0; vector <= 0x38; vector += 8) { // reset and RST 1-7
+        entries.push_back(vector);
+    }
+    analyze(entries);
+}
+
+// HLT, RST, IN, OUT, EI and DI
+bool Recompiler::interpreted(uint8_t opcode) {
+    return opcode == 0x76 || (opcode & 0b11000111) == 0b11000111
+        || opcode == 0xDB || opcode == 0xD3 || opcode == 0xF3 || opcode == 0xFB;
+}
+
+void Recompiler::analyze(const std::vector<uint16_t>& entries) {
+    std::vector<uint32_t> pending;
+    auto enter = [&](uint32_t address) {
+        if (inRom(address)) {
+            leaders.insert(address);
+            pending.push_back(address);
+        }
+    };
+    for (const uint16_t entry : entries) {
+        enter(entry);
+    }
+
+    while (!pending.empty()) {
+        uint32_t address = pending.back();
+        pending.pop_back();
+
+        // Follow the straight line code until it branches. Every other way in starts a block.
+        while (inRom(address) && !reached[address]) {
+            reached[address] = true;
+            const uint8_t opcode = rom.read(address);
+            const uint32_t next = address + isa::opcodes[opcode].length;
+
+            if (interpreted(opcode)) {
+                enter(next); // RST returns here, the vectors are entries already
+                break;
+            }
+            if (isa::branches(opcode)) {
+                if (isa::opcodes[opcode].length == 3) {
+                    enter(rom.read16(address + 1));
+                }
+                const bool jmp = (opcode & 0b11110111) == 0b11000011;
+                const bool ret = (opcode & 0b11101111) == 0b11001001;
+                if (!jmp && !ret && opcode != 0xE9) { // conditional branches and calls come back to the next instruction
+                    enter(next);
+                }
+                break;
+            }
+            address = next;
+        }
+    }
+}
+
+void Recompiler::emitInstruction(std::ostream& out, uint16_t address) const {
+    const uint8_t opcode = rom.read(address);
+    const std::string d8 = hex(rom.read(address + 1), 2);
+    const std::string d16 = hex(rom.read16(address + 1));
+    const uint8_t r = (opcode >> 3) & 0b111; // destination register, or ALU operation
+    const uint8_t rp = (opcode >> 4) & 0b11;
+
+    out << "    ";
+    if (opcode >= 0x40 && opcode <= 0x7F) { // MOV
+        out << store(r, load(opcode & 0b111));
+    } else if ((opcode & 0b11000111) == 0b00000110) { // MVI
+        out << store(r, d8);
+    } else if ((opcode & 0b11001111) == 0b00000001) { // LXI
+        out << storePair(rp, d16);
+    } else if (opcode >= 0x80 && opcode <= 0xBF) {
+        out << "alu<" << int(r) << ">(regs, " << load(opcode & 0b111) << ");";
+    } else if ((opcode & 0b11000111) == 0b11000110) { // ADI ACI SUI SBI ANI XRI ORI CPI
+        out << "alu<" << int(r) << ">(regs, " << d8 << ");";
+    } else if ((opcode & 0b11000111) == 0b00000100) { // INR
+        out << store(r, "inr(regs, " + load(r) + ")");
+    } else if ((opcode & 0b11000111) == 0b00000101) { // DCR
+        out << store(r, "dcr(regs, " + load(r) + ")");
+    } else if ((opcode & 0b11001111) == 0b00000011) { // INX
+        out << storePair(rp, PAIRS[rp] + std::string(" + 1"));
+    } else if ((opcode & 0b11001111) == 0b00001011) { // DCX
+        out << storePair(rp, PAIRS[rp] + std::string(" - 1"));
+    } else if ((opcode & 0b11001111) == 0b00001001) { // DAD
+        out << "dad(regs, " << PAIRS[rp] << ");";
+    } else if ((opcode & 0b11001111) == 0b11000101) { // PUSH
+        out << "push(regs, memory, " << (rp == 3 ? "psw(regs)" : PAIRS[rp]) << ");";
+    } else if ((opcode & 0b11001111) == 0b11000001) { // POP
+        out << (rp == 3 ? "setPsw(regs, pop(regs, memory));" : storePair(rp, "pop(regs, memory)"));
+    } else {
+        switch (opcode) {
+            case 0x02: out << "memory.write(regs.readBC(), regs.A);"; break; // STAX
+            case 0x12: out << "memory.write(regs.readDE(), regs.A);"; break;
+            case 0x32: out << "memory.write(" << d16 << ", regs.A);"; break; // STA
+            case 0x0A: out << "regs.A = memory.read(regs.readBC());"; break; // LDAX
+            case 0x1A: out << "regs.A = memory.read(regs.readDE());"; break;
+            case 0x3A: out << "regs.A = memory.read(" << d16 << ");"; break; // LDA
+            case 0x22: // SHLD
+                out << "memory.write(" << d16 << ", regs.L); memory.write(" << hex((rom.read16(address + 1) + 1) & 0xFFFF) << ", regs.H);";
+                break;
+            case 0x2A: // LHLD
+                out << "regs.L = memory.read(" << d16 << "); regs.H = memory.read(" << hex((rom.read16(address + 1) + 1) & 0xFFFF) << ");";
+                break;
+            case 0xEB: out << "{ const uint16_t hl = regs.readHL(); regs.setHL(regs.readDE()); regs.setDE(hl); }"; break; // XCHG
+            case 0x27: out << "daa(regs);"; break;
+            case 0x07: out << "rlc(regs);"; break;
+            case 0x0F: out << "rrc(regs);"; break;
+            case 0x17: out << "ral(regs);"; break;
+            case 0x1F: out << "rar(regs);"; break;
+            case 0x2F: out << "regs.A = ~regs.A;"; break; // CMA
+            case 0x3F: out << "regs.toggleCarry();"; break; // CMC
+            case 0x37: out << "regs.setCarry();"; break; // STC
+            case 0xE3: out << "xthl(regs, memory);"; break;
+            case 0xF9: out << "regs.SP = regs.readHL();"; break; // SPHL
+            default: out << "// NOP"; break; // and its undocumented aliases
+        }
+    }
+    out << '\n';
+}
+
+void Recompiler::emitBlock(std::ostream& out, uint16_t address) const {
+    out << "uint32_t " << name(address) << "(Registers& regs, [[maybe_unused]] Memory& memory) {\n";
+
+    uint32_t pc = address;
+    uint32_t cycles = 0;
+    while (true) {
+        const uint8_t opcode = rom.read(pc);
+        const isa::Opcode& info = isa::opcodes[opcode];
+        if (interpreted(opcode)) {
+            out << "    regs.PC = " << hex(pc) << ";\n    return " << cycles << ";\n";
+            break;
+        }
+
+        out << "    // " << hex(pc) << ' ' << isa::disassemble(rom, pc) << '\n';
+        const std::string next = hex((pc + info.length) & 0xFFFF);
+        const std::string target = hex(rom.read16(pc + 1));
+        cycles += info.cycles;
+        if (isa::branches(opcode)) {
+            const uint8_t cc = (opcode >> 3) & 0b111;
+            const std::string taken = std::to_string(cycles + info.takenCycles);
+            if ((opcode & 0b11110111) == 0b11000011) { // JMP
+                out << "    regs.PC = " << target << ";\n";
+            } else if ((opcode & 0b11000111) == 0b11000010) { // Jcc
+                out << "    regs.PC = " << condition(cc) << " ? " << target << " : " << next << ";\n";
+            } else if ((opcode & 0b11001111) == 0b11001101) { // CALL
+                out << "    push(regs, memory, " << next << ");\n    regs.PC = " << target << ";\n";
+            } else if ((opcode & 0b11000111) == 0b11000100) { // Ccc
+                out << "    if (" << condition(cc) << ") {\n"
+                    << "        push(regs, memory, " << next << ");\n"
+                    << "        regs.PC = " << target << ";\n"
+                    << "        return " << taken << ";\n    }\n"
+                    << "    regs.PC = " << next << ";\n";
+            } else if ((opcode & 0b11101111) == 0b11001001) { // RET
+                out << "    regs.PC = pop(regs, memory);\n";
+            } else if ((opcode & 0b11000111) == 0b11000000) { // Rcc
+                out << "    if (" << condition(cc) << ") {\n"
+                    << "        regs.PC = pop(regs, memory);\n"
+                    << "        return " << taken << ";\n    }\n"
+                    << "    regs.PC = " << next << ";\n";
+            } else { // PCHL
+                out << "    regs.PC = regs.readHL();\n";
+            }
+            out << "    return " << cycles << ";\n";
+            break;
+        }
+
+        emitInstruction(out, pc);
+        pc += info.length;
+        if (!inRom(pc) || leaders.contains(pc)) {
+            out << "    regs.PC = " << hex(pc & 0xFFFF) << ";\n    return " << cycles << ";\n";
+            break;
+        }
+    }
+    out << "}\n\n";
+}
+
+void Recompiler::emit(std::ostream& out, const std::string& symbol) const {
+    out << "// Generated by the static recompiler, do not edit\n\n"
+        << "#include <array>\n\n"
+        << "#include \"recompiled.hpp\"\n\n"
+        << "using namespace recompiled;\n\n"
+        << "namespace {\n\n";
+
+    // A block that starts with an interpreted instruction is left to the interpreter entirely
+    std::vector<uint16_t> compiled;
+    for (const uint16_t address : leaders) {
+        if (!interpreted(rom.read(address))) {
+            compiled.push_back(address);
+            emitBlock(out, address);
+        }
+    }
+
+    out << "}\n\n"
+        << "extern const recompiled::Rom " << symbol << ";\n"
+        << "const recompiled::Rom " << symbol << " = [] {\n"
+        << "    static std::array<recompiled::Block, " << hex(size) << "> blocks{};\n";
+    for (const uint16_t address : compiled) {
+        out << "    blocks[" << hex(address) << "] = " << name(address) << ";\n";
+    }
+    out << "    return recompiled::Rom{blocks.data(), " << hex(size) << "};\n"
+        << "}();\n";
+}
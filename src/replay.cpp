@@ -0,0 +1,171 @@
+#include "replay.hpp"
+
+#include <cstring>
+
+namespace {
+    void putVarint(SaveWriter& out, uint64_t value) {
+        while (value >= 0x80) {
+            out.put8(value | 0x80);
+            value >>= 7;
+        }
+        out.put8(value);
+    }
+
+    uint64_t getVarint(SaveReader& in) {
+        uint64_t value = 0;
+        for (int shift = 0; shift < 64 && in.good(); shift += 7) {
+            const uint8_t byte = in.get8();
+            value |= uint64_t(byte & 0x7F) << shift;
+            if (!(byte & 0x80)) {
+                break;
+            }
+        }
+        return value;
+    }
+}
+
+// RECORDER
+
+InputRecorder::InputRecorder(SaveWriter& out, Cpu& cpu) : out(out), cpu(cpu), last(cpu.getCycles()) {
+    out.put(reinterpret_cast<const uint8_t*>(replay::MAGIC), sizeof(replay::MAGIC));
+    out.put16(replay::VERSION);
+    out.put64(last);
+    for (uint32_t port = 0; port < live.size(); port++) {
+        live[port] = cpu.getPorts().input(port);
+        cpu.getPorts().attach(port, Ports::Input{&InputRecorder::read, this});
+    }
+}
+
+void InputRecorder::event(replay::Kind kind) {
+    out.put8(static_cast<uint8_t>(kind));
+    putVarint(out, cpu.getCycles() - last);
+    last = cpu.getCycles();
+}
+
+uint8_t InputRecorder::read(void* context, uint8_t port) {
+    InputRecorder& recorder = *static_cast<InputRecorder*>(context);
+    const uint8_t value = recorder.live[port].read(recorder.live[port].context, port);
+    recorder.event(replay::Kind::PORT);
+    recorder.out.put8(port);
+    recorder.out.put8(value);
+    return value;
+}
+
+void InputRecorder::interrupt(uint8_t vector) {
+    event(replay::Kind::INTERRUPT);
+    out.put8(vector);
+    cpu.interrupt(vector);
+}
+
+void InputRecorder::frame() {
+    event(replay::Kind::FRAME);
+    out.put64(cpu.stateHash());
+}
+
+void InputRecorder::finish() {
+    if (!finished) {
+        event(replay::Kind::END);
+        for (uint32_t port = 0; port < live.size(); port++) {
+            cpu.getPorts().attach(port, live[port]);
+        }
+        finished = true;
+    }
+}
+
+// REPLAY
+
+replay::Event InputReplay::next() {
+    replay::Event event{};
+    event.kind = static_cast<replay::Kind>(in.get8());
+    last += getVarint(in);
+    event.cycle = last;
+    switch (event.kind) {
+        case replay::Kind::PORT:
+            event.port = in.get8();
+            event.value = in.get8();
+            break;
+        case replay::Kind::INTERRUPT:
+            event.port = in.get8();
+            break;
+        case replay::Kind::FRAME:
+            event.hash = in.get64();
+            break;
+        default:
+            break;
+    }
+    if (!in.good() || event.kind > replay::Kind::END) {
+        event.kind = replay::Kind::END;
+        diverged = true;
+    }
+    return event;
+}
+
+uint8_t InputReplay::read(void* context, uint8_t port) {
+    InputReplay& replay = *static_cast<InputReplay*>(context);
+    if (replay.reads.empty() || replay.reads.front().port != port || replay.reads.front().cycle != replay.cpu.getCycles()) {
+        replay.diverged = true;
+        return 0xFF; // an open bus, the run stops at the next event anyway
+    }
+    const uint8_t value = replay.reads.front().value;
+    replay.reads.pop_front();
+    return value;
+}
+
+int64_t InputReplay::run() {
+    char magic[sizeof(replay::MAGIC)];
+    in.get(reinterpret_cast<uint8_t*>(magic), sizeof(magic));
+    const uint16_t version = in.get16();
+    last = in.get64();
+    if (!in.good() || std::memcmp(magic, replay::MAGIC, sizeof(magic)) != 0 || version != replay::VERSION) {
+        std::cerr << "Not an input log" << std::endl;
+        return -1;
+    }
+    if (last != cpu.getCycles()) {
+        std::cerr << "Input log starts at cycle " << last << ", not " << cpu.getCycles() << std::endl;
+        return -1;
+    }
+
+    std::array<Ports::Input, 0x100> live;
+    for (uint32_t port = 0; port < live.size(); port++) {
+        live[port] = cpu.getPorts().input(port);
+        cpu.getPorts().attach(port, Ports::Input{&InputReplay::read, this});
+    }
+    int64_t frames = 0;
+    while (!diverged) {
+        // The reads of the stretch up to the next interrupt or frame, which the run takes one by one
+        replay::Event event = next();
+        while (event.kind == replay::Kind::PORT) {
+            reads.push_back(event);
+            event = next();
+        }
+        if (event.kind == replay::Kind::END && reads.empty()) {
+            break;
+        }
+        if (event.cycle > cpu.getCycles()) {
+            cpu.run(event.cycle - cpu.getCycles());
+        }
+        if (diverged || !reads.empty() || cpu.getCycles() != event.cycle) {
+            diverged = true;
+            break;
+        }
+
+        if (event.kind == replay::Kind::INTERRUPT) {
+            cpu.interrupt(event.port);
+        } else if (event.kind == replay::Kind::FRAME) {
+            if (cpu.stateHash() != event.hash) {
+                diverged = true;
+                break;
+            }
+            frames++;
+        }
+    }
+    for (uint32_t port = 0; port < live.size(); port++) {
+        cpu.getPorts().attach(port, live[port]);
+    }
+
+    if (diverged) {
+        std::cerr << "Replay diverged from the log at cycle " << cpu.getCycles() << std::endl;
+        return -1;
+    }
+    return frames;
+}
@@ -0,0 +1,196 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "savestate.hpp"
+
+namespace {
+    // Registers, PC, SP, interrupt state, cycles, the page count and the event count, then the event deadlines,
+    // then per page its number, the encoded length and the encoded bytes
+    constexpr size_t HEADER = 8 + 2 + 2 + 1 + 8 + 2 + 2;
+    constexpr size_t PAGE_HEADER = 1 + 2;
+
+    void put16(uint8_t* out, uint16_t value) {
+        out[0] = value;
+        out[1] = value >> 8;
+    }
+
+    uint16_t get16(const uint8_t* in) {
+        return in[0] | in[1] << 8;
+    }
+}
+
+Rewind::Rewind(Cpu& cpu, size_t capacity, size_t bytes)
+    : cpu(cpu), ring(bytes > 0 ? bytes : capacity * FRAME_BYTES), frames(std::max<size_t>(capacity, 1)),
+      scratch(HEADER + Memory::PAGES * (PAGE_HEADER + savestate::MAX_ENCODED)), previous(0x10000) {
+    capture();
+}
+
+void Rewind::capture() {
+    Memory& memory = cpu.memory;
+    for (uint32_t page = 0; page < Memory::PAGES; page++) {
+        if (const uint8_t* bytes = memory.page(page)) {
+            std::memcpy(previous.data() + page * Memory::PAGE_SIZE, bytes, Memory::PAGE_SIZE);
+        }
+    }
+    regs = cpu.regs;
+    cycles = cpu.cycles;
+    cpu.scheduler.deadlines(deadlines);
+    recorded = memory.checkpoint();
+}
+
+void Rewind::clear() {
+    oldest = 0;
+    count = 0;
+    capture();
+}
+
+size_t Rewind::used() const {
+    size_t total = 0;
+    for (size_t i = 0; i < count; i++) {
+        total += frames[(oldest + i) % frames.size()].size;
+    }
+    return total;
+}
+
+size_t Rewind::allocate(size_t size) {
+    if (count == frames.size()) {
+        oldest = (oldest + 1) % frames.size();
+        count--;
+    }
+
+    size_t start = 0;
+    if (count > 0) {
+        const Frame& newest = frames[(oldest + count - 1) % frames.size()];
+        start = newest.offset + newest.size;
+    }
+    if (start + size > ring.size()) {
+        // Whatever is left after the newest frame is the oldest frames, they go before the ones from 0 on
+        while (count > 0 && frames[oldest].offset >= start) {
+            oldest = (oldest + 1) % frames.size();
+            count--;
+        }
+        start = 0;
+    }
+
+    // The oldest frames follow the newest one around the ring
+    while (count > 0) {
+        const Frame& frame = frames[oldest];
+        if (frame.offset >= start + size || frame.offset + frame.size <= start) {
+            break;
+        }
+        oldest = (oldest + 1) % frames.size();
+        count--;
+    }
+    return start;
+}
+
+void Rewind::record() {
+    Memory& memory = cpu.memory;
+
+    // Pages written during the frame, through any of their mirrors. ROM and I/O have no state to go back to.
+    std::array<bool, Memory::PAGES> written{};
+    uint16_t pages = 0;
+    for (uint32_t page = 0; page < Memory::PAGES; page++) {
+        if (memory.writtenSince(page, recorded) && memory.writable(page << 8) && !written[memory.storage(page)]) {
+            written[memory.storage(page)] = true;
+            pages++;
+        }
+    }
+
+    // Encoded in scratch first, the ring only gives up the frames it has to
+    scratch.resize(std::max(scratch.size(), HEADER + deadlines.size() * 8 + Memory::PAGES * (PAGE_HEADER + savestate::MAX_ENCODED)));
+    uint8_t* out = scratch.data();
+
+    // The state the frame started with
+    const uint8_t registers[] = {regs.A, regs.getF(), regs.B, regs.C, regs.D, regs.E, regs.H, regs.L};
+    std::memcpy(out, registers, sizeof(registers));
+    put16(out + 8, regs.PC);
+    put16(out + 10, regs.SP);
+    out[12] = regs.interruptState();
+    std::memcpy(out + 13, &cycles, sizeof(cycles));
+    put16(out + 21, pages);
+    put16(out + 23, deadlines.size());
+    std::memcpy(out + HEADER, deadlines.data(), deadlines.size() * 8);
+    size_t size = HEADER + deadlines.size() * 8;
+
+    for (uint32_t page = 0; page < Memory::PAGES; page++) {
+        if (!written[page]) {
+            continue;
+        }
+        uint8_t* before = previous.data() + page * Memory::PAGE_SIZE;
+        const uint8_t* now = memory.page(page);
+        out[size] = page;
+        const size_t length = savestate::encode(now, before, out + size + PAGE_HEADER);
+        put16(out + size + 1, length);
+        size += PAGE_HEADER + length;
+        std::memcpy(before, now, Memory::PAGE_SIZE);
+    }
+
+    if (size > ring.size()) {
+        count = 0; // a frame this big cannot be kept, start over from here
+    } else {
+        const size_t offset = allocate(size);
+        std::memcpy(ring.data() + offset, out, size);
+        frames[(oldest + count) % frames.size()] = {offset, size};
+        count++;
+    }
+    regs = cpu.regs;
+    cycles = cpu.cycles;
+    cpu.scheduler.deadlines(deadlines); // every frame, into the buffer of the last one
+    recorded = memory.checkpoint();
+}
+
+bool Rewind::rewind(size_t back) {
+    if (back == 0 || back > count) {
+        return false;
+    }
+    Memory& memory = cpu.memory;
+
+    // Back to the last record first, then through the deltas from the newest
+    for (uint32_t page = 0; page < Memory::PAGES; page++) {
+        if (memory.writtenSince(page, recorded) && memory.writable(page << 8)) {
+            const uint8_t storage = memory.storage(page);
+            memory.load(previous.data() + storage * Memory::PAGE_SIZE, Memory::PAGE_SIZE, storage * Memory::PAGE_SIZE);
+        }
+    }
+
+    const uint8_t* header = nullptr;
+    for (; back > 0; back--) {
+        const Frame& frame = frames[(oldest + count - 1) % frames.size()];
+        header = ring.data() + frame.offset;
+        size_t at = HEADER + get16(header + 23) * 8;
+        for (uint16_t pages = get16(header + 21); pages > 0; pages--) {
+            const uint8_t page = header[at];
+            const uint16_t length = get16(header + at + 1);
+            uint8_t* bytes = previous.data() + page * Memory::PAGE_SIZE;
+            savestate::decode(header + at + PAGE_HEADER, length, bytes);
+            memory.load(bytes, Memory::PAGE_SIZE, page * Memory::PAGE_SIZE);
+            at += PAGE_HEADER + length;
+        }
+        count--;
+    }
+
+    Registers& target = cpu.regs;
+    target.A = header[0];
+    target.setF(header[1]);
+    target.B = header[2];
+    target.C = header[3];
+    target.D = header[4];
+    target.E = header[5];
+    target.H = header[6];
+    target.L = header[7];
+    target.PC = get16(header + 8);
+    target.SP = get16(header + 10);
+    target.setInterruptState(header[12]);
+    std::memcpy(&cpu.cycles, header + 13, sizeof(cpu.cycles));
+    deadlines.resize(get16(header + 23));
+    std::memcpy(deadlines.data(), header + HEADER, deadlines.size() * 8);
+    cpu.scheduler.setDeadlines(deadlines);
+
+    regs = cpu.regs;
+    cycles = cpu.cycles;
+    recorded = memory.checkpoint();
+    return true;
+}
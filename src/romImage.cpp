@@ -0,0 +1,64 @@
+#include "romImage.hpp"
+
+#include <fstream>
+#include <iostream>
+
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define ROM_MMAP
+#endif
+
+void RomImage::release() {
+#if defined(ROM_MMAP)
+    if (isMapped) {
+        munmap(const_cast<uint8_t*>(bytes), length);
+    }
+#endif
+    bytes = nullptr;
+    length = 0;
+    isMapped = false;
+    buffer.clear();
+}
+
+int RomImage::open(const char* path) {
+    release();
+
+#if defined(ROM_MMAP)
+    const int file = ::open(path, O_RDONLY);
+    if (file >= 0) {
+        struct stat info;
+        if (fstat(file, &info) == 0 && info.st_size > 0) {
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_SHARED, file, 0);
+            if (mapping != MAP_FAILED) {
+                bytes = static_cast<const uint8_t*>(mapping);
+                length = info.st_size;
+                isMapped = true;
+            }
+        }
+        close(file); // the mapping keeps the file open
+        if (isMapped) {
+            return 0;
+        }
+    }
+#endif
+
+    // Read the whole file at once
+    std::ifstream rom(path, std::ios::binary | std::ios::ate);
+    if (!rom) {
+        std::cerr << "Failed to open rom " << path << std::endl;
+        return -1;
+    }
+    buffer.resize(rom.tellg());
+    rom.seekg(0);
+    if (!rom.read(reinterpret_cast<char*>(buffer.data()), buffer.size())) {
+        std::cerr << "Failed to read rom " << path << std::endl;
+        buffer.clear();
+        return -1;
+    }
+    bytes = buffer.data();
+    length = buffer.size();
+    return 0;
+}
@@ -0,0 +1,267 @@
+#include "savestate.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+#include "cpu.hpp"
+
+// ENCODING
+
+size_t savestate::encode(const uint8_t* page, const uint8_t* base, uint8_t* out) {
+    auto sameWord = [&](size_t at) {
+        uint64_t a, b;
+        std::memcpy(&a, page + at, sizeof(a));
+        std::memcpy(&b, base + at, sizeof(b));
+        return a == b;
+    };
+
+    size_t length = 0;
+    size_t i = 0;
+    while (i < Memory::PAGE_SIZE) {
+        // Equal bytes a word at a time, most of a page is unchanged from one frame to the next
+        size_t run = 0;
+        while (i + run + 8 <= Memory::PAGE_SIZE && run + 8 <= 0x80 && sameWord(i + run)) {
+            run += 8;
+        }
+        while (i + run < Memory::PAGE_SIZE && run < 0x80 && page[i + run] == base[i + run]) {
+            run++;
+        }
+        if (run > 0) {
+            out[length++] = run - 1;
+            i += run;
+            continue;
+        }
+
+        // Literals up to the next pair of equal bytes, a single one is cheaper inline
+        const size_t start = i;
+        while (i < Memory::PAGE_SIZE && i - start < 0x80
+               && !(page[i] == base[i] && i + 1 < Memory::PAGE_SIZE && page[i + 1] == base[i + 1])) {
+            i++;
+        }
+        out[length++] = 0x7F + (i - start);
+        for (size_t j = start; j < i; j++) {
+            out[length++] = page[j] ^ base[j];
+        }
+    }
+    return length;
+}
+
+bool savestate::decode(const uint8_t* encoded, size_t length, uint8_t* page) {
+    size_t i = 0;
+    size_t at = 0;
+    while (at < length) {
+        const uint8_t control = encoded[at++];
+        if (control < 0x80) {
+            i += control + 1;
+        } else {
+            const size_t count = control - 0x7F;
+            if (at + count > length || i + count > Memory::PAGE_SIZE) {
+                return false;
+            }
+            for (size_t j = 0; j < count; j++) {
+                page[i++] ^= encoded[at++];
+            }
+        }
+    }
+    return i == Memory::PAGE_SIZE;
+}
+
+// WRITER
+
+void SaveWriter::put(const uint8_t* bytes, size_t size) {
+    if (buffer != nullptr) {
+        buffer->insert(buffer->end(), bytes, bytes + size);
+    } else {
+        stream->write(reinterpret_cast<const char*>(bytes), size);
+    }
+    written += size;
+}
+
+void SaveWriter::put16(uint16_t value) {
+    const uint8_t bytes[] = {uint8_t(value), uint8_t(value >> 8)};
+    put(bytes, sizeof(bytes));
+}
+
+void SaveWriter::put64(uint64_t value) {
+    uint8_t bytes[8];
+    for (int i = 0; i < 8; i++) {
+        bytes[i] = value >> (8 * i);
+    }
+    put(bytes, sizeof(bytes));
+}
+
+// READER
+
+bool SaveReader::get(uint8_t* out, size_t size) {
+    if (!failed && stream != nullptr) {
+        failed = !stream->read(reinterpret_cast<char*>(out), size);
+    } else if (!failed) {
+        failed = size > length - position;
+        if (!failed) {
+            std::memcpy(out, bytes + position, size);
+            position += size;
+        }
+    }
+    if (failed) {
+        std::memset(out, 0, size);
+    }
+    return !failed;
+}
+
+uint8_t SaveReader::get8() {
+    uint8_t value;
+    get(&value, 1);
+    return value;
+}
+
+uint16_t SaveReader::get16() {
+    uint8_t bytes[2];
+    get(bytes, sizeof(bytes));
+    return bytes[0] | bytes[1] << 8;
+}
+
+uint64_t SaveReader::get64() {
+    uint8_t bytes[8];
+    get(bytes, sizeof(bytes));
+    uint64_t value = 0;
+    for (int i = 7; i >= 0; i--) {
+        value = value << 8 | bytes[i];
+    }
+    return value;
+}
+
+// CPU
+
+void Cpu::save(SaveWriter& out, const Snapshot* base) {
+    out.put(reinterpret_cast<const uint8_t*>(savestate::MAGIC), sizeof(savestate::MAGIC));
+    out.put16(savestate::VERSION);
+    out.put8(static_cast<uint8_t>(base ? savestate::Kind::DELTA : savestate::Kind::FULL));
+    out.put64(base ? base->cycles : 0);
+
+    const uint8_t registers[] = {regs.A, regs.getF(), regs.B, regs.C, regs.D, regs.E, regs.H, regs.L};
+    out.put(registers, sizeof(registers));
+    out.put16(regs.PC);
+    out.put16(regs.SP);
+    out.put8(regs.interruptState());
+    out.put64(cycles);
+    out.put16(scheduler.size());
+    for (const uint64_t deadline : scheduler.deadlines()) {
+        out.put64(deadline);
+    }
+
+    // Against the reset point only the dirty pages, or the pages they mirror, can differ.
+    // Mirrors are saved once, and pages the guest cannot write belong to the machine rather than the state.
+    static const uint8_t zeros[Memory::PAGE_SIZE] = {};
+    auto against = [&](uint8_t page) { return base != nullptr ? base->memory.page(page) : zeros; };
+    std::array<bool, Memory::PAGES> candidates{};
+    if (base != nullptr && base == resetPoint.get()) {
+        for (uint8_t page : memory.dirtyPages()) {
+            candidates[memory.storage(page)] = true;
+        }
+    } else {
+        candidates.fill(true);
+    }
+    std::vector<uint8_t> changed;
+    for (uint32_t page = 0; page < Memory::PAGES; page++) {
+        if (candidates[page] && memory.storage(page) == page && memory.writable(page << 8) && against(page) != nullptr
+            && std::memcmp(memory.page(page), against(page), Memory::PAGE_SIZE) != 0) {
+            changed.push_back(page);
+        }
+    }
+
+    out.put16(changed.size());
+    uint8_t encoded[savestate::MAX_ENCODED];
+    for (uint8_t page : changed) {
+        const size_t length = savestate::encode(memory.page(page), against(page), encoded);
+        out.put8(page);
+        out.put16(length);
+        out.put(encoded, length);
+    }
+}
+
+int Cpu::load(SaveReader& in, const std::shared_ptr<const Snapshot>& base) {
+    char magic[sizeof(savestate::MAGIC)];
+    in.get(reinterpret_cast<uint8_t*>(magic), sizeof(magic));
+    const uint16_t version = in.get16();
+    const savestate::Kind kind = static_cast<savestate::Kind>(in.get8());
+    const uint64_t baseCycles = in.get64();
+    if (!in.good() || std::memcmp(magic, savestate::MAGIC, sizeof(magic)) != 0) {
+        std::cerr << "Not a savestate" << std::endl;
+        return -1;
+    }
+    if (version < 1 || version > savestate::VERSION) {
+        std::cerr << "Unsupported savestate version " << version << std::endl;
+        return -1;
+    }
+    if (kind == savestate::Kind::DELTA && (base == nullptr || base->cycles != baseCycles)) {
+        std::cerr << "Savestate delta needs its base at cycle " << baseCycles << std::endl;
+        return -1;
+    }
+
+    uint8_t registers[8];
+    in.get(registers, sizeof(registers));
+    const uint16_t pc = in.get16();
+    const uint16_t sp = in.get16();
+    const uint8_t interrupts = version >= 2 ? in.get8() : 0;
+    const uint64_t savedCycles = in.get64();
+    std::vector<uint64_t> deadlines = scheduler.deadlines();
+    if (version >= 2) {
+        const uint16_t events = in.get16();
+        if (in.good() && events != scheduler.size()) {
+            std::cerr << "Savestate has " << events << " events, the machine " << scheduler.size() << std::endl;
+            return -1;
+        }
+        for (uint64_t& deadline : deadlines) {
+            deadline = in.get64();
+        }
+    }
+
+    // Start from the base, then apply the pages that differ from it
+    if (kind == savestate::Kind::DELTA) {
+        restore(base);
+    } else {
+        static const uint8_t zeros[Memory::PAGE_SIZE] = {};
+        for (uint32_t page = 0; page < Memory::PAGES; page++) {
+            if (memory.writable(page << 8)) {
+                memory.load(zeros, Memory::PAGE_SIZE, page << 8);
+            }
+        }
+        resetPoint = nullptr;
+    }
+    uint8_t encoded[savestate::MAX_ENCODED];
+    uint8_t page[Memory::PAGE_SIZE];
+    for (uint16_t count = in.get16(); count > 0 && in.good(); count--) {
+        const uint8_t number = in.get8();
+        const uint16_t length = in.get16();
+        if (length > sizeof(encoded) || !memory.writable(number << 8) || memory.storage(number) != number) {
+            std::cerr << "Bad savestate page " << int(number) << std::endl;
+            return -1;
+        }
+        in.get(encoded, length);
+        std::memcpy(page, memory.page(number), Memory::PAGE_SIZE);
+        if (!savestate::decode(encoded, length, page)) {
+            std::cerr << "Bad savestate page " << int(number) << std::endl;
+            return -1;
+        }
+        memory.load(page, Memory::PAGE_SIZE, number << 8);
+    }
+    if (!in.good()) {
+        std::cerr << "Savestate is cut short" << std::endl;
+        return -1;
+    }
+
+    regs.A = registers[0];
+    regs.setF(registers[1]);
+    regs.B = registers[2];
+    regs.C = registers[3];
+    regs.D = registers[4];
+    regs.E = registers[5];
+    regs.H = registers[6];
+    regs.L = registers[7];
+    regs.PC = pc;
+    regs.SP = sp;
+    regs.setInterruptState(interrupts);
+    cycles = savedCycles;
+    scheduler.setDeadlines(deadlines);
+    return 0;
+}
@@ -0,0 +1,111 @@
+#include "scheduler.hpp"
+
+Scheduler::Event Scheduler::add(Callback callback, void* context) {
+    events.push_back({callback, context, NEVER, 0});
+    return events.size() - 1;
+}
+
+void Scheduler::siftUp(uint32_t position) {
+    const Event event = heap[position];
+    while (position > 0 && before(event, heap[(position - 1) / 2])) {
+        place(position, heap[(position - 1) / 2]);
+        position = (position - 1) / 2;
+    }
+    place(position, event);
+}
+
+void Scheduler::siftDown(uint32_t position) {
+    const Event event = heap[position];
+    while (true) {
+        uint32_t child = 2 * position + 1;
+        if (child >= heap.size()) {
+            break;
+        }
+        if (child + 1 < heap.size() && before(heap[child + 1], heap[child])) {
+            child++;
+        }
+        if (!before(heap[child], event)) {
+            break;
+        }
+        place(position, heap[child]);
+        position = child;
+    }
+    place(position, event);
+}
+
+void Scheduler::schedule(Event event, uint64_t cycle) {
+    if (cycle == NEVER) {
+        cancel(event);
+        return;
+    }
+    Entry& entry = events[event];
+    if (entry.cycle == NEVER) {
+        entry.cycle = cycle;
+        heap.push_back(event);
+        siftUp(heap.size() - 1);
+    } else {
+        const bool earlier = cycle < entry.cycle;
+        entry.cycle = cycle;
+        if (earlier) {
+            siftUp(entry.position);
+        } else {
+            siftDown(entry.position);
+        }
+    }
+}
+
+void Scheduler::cancel(Event event) {
+    Entry& entry = events[event];
+    if (entry.cycle == NEVER) {
+        return;
+    }
+    // The last event takes its place, then moves whichever way it has to
+    const uint32_t position = entry.position;
+    const Event last = heap.back();
+    heap.pop_back();
+    entry.cycle = NEVER;
+    if (last != event) {
+        place(position, last);
+        siftDown(position);
+        siftUp(events[last].position);
+    }
+}
+
+std::vector<uint64_t> Scheduler::deadlines() const {
+    std::vector<uint64_t> cycles;
+    deadlines(cycles);
+    return cycles;
+}
+
+void Scheduler::deadlines(std::vector<uint64_t>& cycles) const {
+    cycles.clear();
+    for (const Entry& entry : events) {
+        cycles.push_back(entry.cycle);
+    }
+}
+
+void Scheduler::setDeadlines(const std::vector<uint64_t>& cycles) {
+    for (Event event = 0; event < cycles.size() && event < events.size(); event++) {
+        events[event].cycle = cycles[event];
+    }
+    // Rebuilt bottom up, which is O(n)
+    heap.clear();
+    for (Event event = 0; event < events.size(); event++) {
+        if (events[event].cycle != NEVER) {
+            events[event].position = heap.size();
+            heap.push_back(event);
+        }
+    }
+    for (uint32_t position = heap.size() / 2; position-- > 0;) {
+        siftDown(position);
+    }
+}
+
+void Scheduler::run(Cpu& cpu, uint64_t now) {
+    while (!heap.empty() && events[heap.front()].cycle <= now) {
+        const Event event = heap.front();
+        const Entry& entry = events[event];
+        // Rescheduled in place, so a periodic event costs one sift
+        schedule(event, entry.callback(entry.context, cpu, entry.cycle));
+    }
+}
@@ -1,97 +1,289 @@
 #include "state.hpp"
 
+#include <algorithm>
+#include <cstring>
+
 // MEMORY
 
-uint8_t Memory::read(uint16_t address) const {
-    return data[address];
+Memory::Memory() {
+    mapRam(0, 0x10000);
 }
 
-void Memory::write(uint16_t address, uint8_t value) {
-    data[address] = value;
+// The dirty pages go along, a copy resets to the same snapshot as the original
+Memory::Memory(const Memory& other) : writtenAt(other.writtenAt), epoch(other.epoch), clean(other.clean),
+                                      pageHashes(other.pageHashes), root(other.root), watched(other.watched),
+                                      writtenCodePages(other.writtenCodePages), writtenLines(other.writtenLines) {
+    copyMap(other);
 }
 
-uint16_t Memory::read16(uint16_t address) const {
-    uint8_t low = read(address);
-    uint8_t high = read(address + 1);
-    return (high << 8) | low;
+Memory& Memory::operator=(const Memory& other) {
+    if (this != &other) {
+        writtenAt = other.writtenAt;
+        epoch = other.epoch;
+        clean = other.clean;
+        pageHashes = other.pageHashes;
+        root = other.root;
+        watched = other.watched;
+        writtenCodePages = other.writtenCodePages;
+        writtenLines = other.writtenLines;
+        copyMap(other);
+    }
+    return *this;
 }
 
-// REGISTERS
+void Memory::copyMap(const Memory& other) {
+    std::memcpy(data, other.data, sizeof(data));
+    devices = other.devices;
+    auto rebase = [&](auto* pointer) -> decltype(pointer) {
+        const uint8_t* byte = pointer;
+        if (byte >= other.data && byte < other.data + sizeof(data)) {
+            return data + (byte - other.data); // discarded() included
+        }
+        return pointer; // shared ROM, or I/O
+    };
+    for (uint32_t page = 0; page < PAGES; page++) {
+        pages[page] = {rebase(other.pages[page].read), rebase(other.pages[page].write)};
+    }
+}
 
-Registers::Registers() : B(0), C(0), D(0), E(0), H(0), L(0), A(0), F(0), PC(0), SP(0) {}
+void Memory::mapRam(uint16_t address, uint32_t size) {
+    for (uint32_t page = address / PAGE_SIZE; page < (address + size) / PAGE_SIZE; page++) {
+        pages[page] = {data + page * PAGE_SIZE, data + page * PAGE_SIZE};
+    }
+}
 
-void Registers::setFlags(uint16_t result, bool enableZero, bool enableSign, bool enableParity, bool enableCarry) {
-    if ((uint8_t)result == 0x0 && enableZero) { // Zero flag
-        F |= 0b01000000; // 7th bit
-    } else {
-        F &= ~0b01000000;
+void Memory::mapRom(uint16_t address, uint32_t size) {
+    for (uint32_t page = address / PAGE_SIZE; page < (address + size) / PAGE_SIZE; page++) {
+        pages[page] = {data + page * PAGE_SIZE, discarded()};
+        watched[page] = 0;
     }
-    if (((uint8_t)result & 0b10000000 && enableSign) >> 7 ==  0b1) { // Sign flag, most significant bit set
-        F |= 0b10000000; // 8th bit
-    } else {
-        F &= ~0b1000000;
+}
+
+void Memory::mapRom(uint16_t address, const uint8_t* bytes, uint32_t size) {
+    for (uint32_t offset = 0; offset + PAGE_SIZE <= size && address + offset < 0x10000; offset += PAGE_SIZE) {
+        pages[(address + offset) / PAGE_SIZE] = {bytes + offset, discarded()};
+        watched[(address + offset) / PAGE_SIZE] = 0;
     }
-    if (std::popcount((uint8_t)result) % 2 == 0 && enableParity) { // Parity flag, modulo 2 sum of bits is zero 
-        F |= 0b00000100; // 3th bit
-    } else {
-        F &= ~0b00000100; 
-    }
-    if (result > UINT8_MAX && enableCarry) { // Carry flag
-    /*  This is the same for addition and subtraction.
-        This is possible because if the addition overflows the 8 bit value it's higher than the 8bit maximum in an 16bit uint.
-        And if the subtraction borrows it will underflow and in a 16 bit int will become higher than the 8 bit maximum,
-        even if a=0x00 and b=0xFF the result would be 0xFF01, a lot bigger than 0xFF.*/
-        F |= 0b00000001;  // 1st bit
-    } else {
-        F &= ~0b00000001;
+
+    // A page the image only fills partly is copied
+    const uint32_t tail = size % PAGE_SIZE;
+    const uint32_t last = address + size - tail;
+    if (tail > 0 && last < 0x10000) {
+        std::memset(data + last, 0, PAGE_SIZE);
+        std::memcpy(data + last, bytes + size - tail, tail);
+        rehash(last >> 8);
+        mapRom(last, PAGE_SIZE);
     }
 }
 
-void Registers::setFlagsADD(uint16_t result, uint8_t a, uint8_t b, bool carry,
-                            bool enableZero, bool enableSign, bool enableParity, bool enableCarry, bool enableAuxCarry) {
-    setFlags(result, enableZero, enableSign, enableParity, enableCarry); // Zero, Sign, Parity, and Carry flags
-    /* Checks if the sum of the two argument's lower nibbles (and if used the carry) is higher than the 8 bit maximum.
-       If this is the case the addition overflowed into the higher nibble. */
-    if (((a & 0x0F) + (b & 0x0F) + 0b1*carry) > 0xF && enableAuxCarry) { // AuxCarry flag, set if the lower 4 bit overflowed 
-        F |= 0b00010000; // 5th bit
-    } else {
-        F &= ~0b00010000;
+void Memory::mirror(uint16_t address, uint32_t size, uint16_t target) {
+    for (uint32_t page = 0; page < size / PAGE_SIZE && address / PAGE_SIZE + page < PAGES; page++) {
+        pages[address / PAGE_SIZE + page] = pages[(target / PAGE_SIZE + page) % PAGES];
+        devices[address / PAGE_SIZE + page] = devices[(target / PAGE_SIZE + page) % PAGES];
+        watched[address / PAGE_SIZE + page] = watched[(target / PAGE_SIZE + page) % PAGES]; // for code or lines watched already
     }
 }
 
-void Registers::setFlagsSUB(uint16_t result, uint8_t a, uint8_t b, bool borrow,
-                            bool enableZero, bool enableSign, bool enableParity, bool enableCarry, bool enableAuxCarry) {
-    setFlags(result, enableZero, enableSign, enableParity, enableCarry); // Zero, Sign, Parity and Carry flags
-    /* Check if the lower nibble of the first value is smaller than the lower nibble of the second value (if used with borrow).
-       If this is the case a bit would've been borrowed from the higher nibble. */
-    if ((a & 0x0F) < ((b & 0x0F) + 0b1 * borrow) && enableAuxCarry) { // AuxCarry flag, set if the lower 4 bits borrowed from the higher bits
-        F |= 0b00010000; // 5th bit
+uint8_t Memory::storage(uint8_t page) const {
+    const uint8_t* bytes = pages[page].read;
+    return bytes >= data && bytes < data + DISCARDED ? (bytes - data) / PAGE_SIZE : page;
+}
+
+void Memory::mapIo(uint16_t address, uint32_t size, Io device) {
+    for (uint32_t page = address / PAGE_SIZE; page < (address + size) / PAGE_SIZE; page++) {
+        pages[page] = {nullptr, nullptr};
+        devices[page] = device;
+        watched[page] = 0;
+    }
+}
+
+uint8_t Memory::readIo(uint16_t address) const {
+    const Io& device = devices[address >> 8];
+    return device.read(device.context, address);
+}
+
+void Memory::writeSlow(uint16_t address, uint8_t value) {
+    const Page& page = pages[address >> 8];
+    if (page.write != nullptr) {
+        store(page.write + (address & 0xFF), value);
+        markDirty(address >> 8);
+        if (watched[address >> 8] & LINES) {
+            const uint32_t line = (page.write - data + (address & 0xFF)) / LINE_SIZE;
+            writtenLines[line / 64] |= uint64_t(1) << line % 64;
+        }
     } else {
-        F &= ~0b00010000;
+        const Io& device = devices[address >> 8];
+        device.write(device.context, address, value);
+    }
+    if (watched[address >> 8] & CODE) {
+        codeWritten(address >> 8);
+    }
+}
+
+void Memory::watchCode(uint16_t address) {
+    const Page& page = pages[address >> 8];
+    if ((watched[address >> 8] & CODE) || page.write == nullptr || page.write == discarded()) {
+        return;
+    }
+    // Code in a mirrored page can be written through any of its addresses
+    for (uint32_t other = 0; other < PAGES; other++) {
+        if (pages[other].write == page.write) {
+            watched[other] |= CODE;
+        }
+    }
+}
+
+void Memory::codeWritten(uint8_t page) {
+    uint8_t* storage = pages[page].write;
+    for (uint32_t other = 0; other < PAGES; other++) {
+        if ((watched[other] & CODE) && pages[other].write == storage) {
+            watched[other] &= ~CODE;
+            writtenCodePages.push_back(other);
+        }
+    }
+}
+
+void Memory::watchLines(uint16_t address, uint32_t size) {
+    for (uint32_t page = address / PAGE_SIZE; page < (address + size + PAGE_SIZE - 1) / PAGE_SIZE && page < PAGES; page++) {
+        uint8_t* storage = pages[page].write;
+        if (storage == nullptr || storage == discarded()) {
+            continue;
+        }
+        for (uint32_t other = 0; other < PAGES; other++) {
+            if (pages[other].write == storage) {
+                watched[other] |= LINES;
+            }
+        }
+        linesWritten(storage - data, PAGE_SIZE);
+    }
+}
+
+void Memory::linesWritten(uint32_t address, uint32_t size) {
+    for (uint32_t line = address / LINE_SIZE; line < (address + size + LINE_SIZE - 1) / LINE_SIZE; line++) {
+        writtenLines[line / 64] |= uint64_t(1) << line % 64;
+    }
+}
+
+void Memory::clearLines(uint16_t address, uint32_t size) {
+    for (uint32_t at = address; at < address + size && at < 0x10000; at += LINE_SIZE) {
+        const uint32_t line = (storage(at >> 8) * PAGE_SIZE + (at & 0xFF)) / LINE_SIZE;
+        writtenLines[line / 64] &= ~(uint64_t(1) << line % 64);
+    }
+}
+
+void Memory::load(const uint8_t* bytes, size_t size, uint16_t address) {
+    size = std::min<size_t>(size, 0x10000 - address);
+    for (size_t offset = 0; offset < size;) {
+        const uint32_t at = address + offset;
+        const size_t chunk = std::min<size_t>(size - offset, PAGE_SIZE - at % PAGE_SIZE);
+        const uint8_t* storage = pages[at >> 8].read;
+        if (storage >= data && storage < data + DISCARDED) {
+            std::memcpy(data + (storage - data) + at % PAGE_SIZE, bytes + offset, chunk);
+            rehash((storage - data) / PAGE_SIZE);
+            markDirty(at >> 8);
+            if (watched[at >> 8] & LINES) {
+                linesWritten(storage - data + at % PAGE_SIZE, chunk);
+            }
+            if (watched[at >> 8] & CODE) {
+                codeWritten(at >> 8);
+            }
+        }
+        offset += chunk;
+    }
+}
+
+void Memory::rehash(uint8_t page) {
+    uint64_t hash = 0;
+    for (uint32_t address = page * PAGE_SIZE; address < (page + 1) * PAGE_SIZE; address++) {
+        hash += BYTE_HASHES[data[address]] * weight(address);
+    }
+    root += hash - pageHashes[page];
+    pageHashes[page] = hash;
+}
+
+std::vector<uint8_t> Memory::dirtyPages() const {
+    std::vector<uint8_t> written;
+    for (uint32_t page = 0; page < PAGES; page++) {
+        if (dirty(page)) {
+            written.push_back(page);
+        }
+    }
+    return written;
+}
+
+void Memory::restore(const Memory& snapshot, bool all) {
+    for (uint32_t page = 0; page < PAGES; page++) {
+        const uint8_t* storage = pages[page].read;
+        const uint8_t* source = snapshot.pages[page].read;
+        if (!(all || dirty(page)) || storage < data || storage >= data + DISCARDED || source == nullptr) {
+            continue; // clean, or shared ROM and I/O with nothing to restore
+        }
+        std::memcpy(data + (storage - data), source, PAGE_SIZE);
+        const uint8_t slot = (storage - data) / PAGE_SIZE; // where the snapshot has its hash too, as the map is the same
+        root += snapshot.pageHashes[slot] - pageHashes[slot];
+        pageHashes[slot] = snapshot.pageHashes[slot];
+        markDirty(page); // for the other observers
+        if (watched[page] & LINES) {
+            linesWritten(slot * PAGE_SIZE, PAGE_SIZE);
+        }
+        if (watched[page] & CODE) {
+            codeWritten(page);
+        }
+    }
+    clearDirty();
+}
+
+uint16_t Memory::read16(uint16_t address) const {
+    uint8_t low = read(address);
+    uint8_t high = read(address + 1);
+    return (high << 8) | low;
+}
+
+// REGISTERS
+
+Registers::Registers() : F(0),
+#if defined(LAZY_FLAGS)
+    lazyMask(0),
+#endif
+    B(0), C(0), D(0), E(0), H(0), L(0), A(0), PC(0), SP(0), interruptsEnabled(false), halted(false) {}
+
+#if defined(LAZY_FLAGS)
+void Registers::resolveFlags() {
+    uint8_t flags;
+    switch (lazyOp) {
+        case FlagOp::FLAGS: flags = flagsOf<FlagOp::FLAGS>(lazyResult, lazyA, lazyB); break;
+        case FlagOp::ADD: flags = flagsOf<FlagOp::ADD>(lazyResult, lazyA, lazyB); break;
+        case FlagOp::SUB: flags = flagsOf<FlagOp::SUB>(lazyResult, lazyA, lazyB); break;
+        default: flags = flagsOf<FlagOp::LOGIC>(lazyResult, lazyA, lazyB); break;
     }
+    F = (F & ~lazyMask) | (flags & lazyMask);
+    lazyMask = 0;
 }
+#endif
 
+uint8_t Registers::getF(){resolveFlags(0xFF); return F;}
+void Registers::setF(uint8_t value){resolveFlags(0xFF); F = value;}
 
-uint8_t Registers::getZero(){return (F & 0b01000000) >> 6;}
-void Registers::setZero(){F |= 0b01000000;}
-void Registers::clearZero(){F &= ~0b01000000;}
+uint8_t Registers::getZero(){resolveFlags(ZERO_FLAG); return (F & ZERO_FLAG) >> 6;}
+void Registers::setZero(){resolveFlags(ZERO_FLAG); F |= ZERO_FLAG;}
+void Registers::clearZero(){resolveFlags(ZERO_FLAG); F &= ~ZERO_FLAG;}
 
-uint8_t Registers::getCarry(){return (F & 0b00000001) >> 0;}
-void Registers::setCarry(){F |= 0b00000001;}
-void Registers::clearCarry(){F &= ~0b00000001;}
-void Registers::toggleCarry(){F ^= 0b00000001;}
+uint8_t Registers::getCarry(){resolveFlags(CARRY_FLAG); return (F & CARRY_FLAG) >> 0;}
+void Registers::setCarry(){resolveFlags(CARRY_FLAG); F |= CARRY_FLAG;}
+void Registers::clearCarry(){resolveFlags(CARRY_FLAG); F &= ~CARRY_FLAG;}
+void Registers::toggleCarry(){resolveFlags(CARRY_FLAG); F ^= CARRY_FLAG;}
 
-uint8_t Registers::getSign(){return (F & 0b10000000) >> 7;}
-void Registers::setSign(){F |= 0b10000000;}
-void Registers::clearSign(){F &= ~0b10000000;}
+uint8_t Registers::getSign(){resolveFlags(SIGN_FLAG); return (F & SIGN_FLAG) >> 7;}
+void Registers::setSign(){resolveFlags(SIGN_FLAG); F |= SIGN_FLAG;}
+void Registers::clearSign(){resolveFlags(SIGN_FLAG); F &= ~SIGN_FLAG;}
 
-uint8_t Registers::getParity(){return (F & 0b00000100) >> 2;}
-void Registers::setParity(){F |= 0b00000100;}
-void Registers::clearParity(){F &= ~0b00000100;}
+uint8_t Registers::getParity(){resolveFlags(PARITY_FLAG); return (F & PARITY_FLAG) >> 2;}
+void Registers::setParity(){resolveFlags(PARITY_FLAG); F |= PARITY_FLAG;}
+void Registers::clearParity(){resolveFlags(PARITY_FLAG); F &= ~PARITY_FLAG;}
 
-uint8_t Registers::getAuxCarry(){return F & 0b00010000 >> 4;}
-void Registers::setAuxCarry(){F |= 0b00010000;}
-void Registers::clearAuxCarry(){F &= ~0b00010000;}
+uint8_t Registers::getAuxCarry(){resolveFlags(AUX_CARRY_FLAG); return (F & AUX_CARRY_FLAG) >> 4;}
+void Registers::setAuxCarry(){resolveFlags(AUX_CARRY_FLAG); F |= AUX_CARRY_FLAG;}
+void Registers::clearAuxCarry(){resolveFlags(AUX_CARRY_FLAG); F &= ~AUX_CARRY_FLAG;}
 
 uint16_t Registers::readPair(uint8_t high, uint8_t low)
 {
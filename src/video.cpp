@@ -0,0 +1,111 @@
+#include "video.hpp"
+
+#include <algorithm>
+
+Video::Video(const std::vector<video::Band>& overlay, video::Isa wanted) {
+    // Each row of the image as the colors of its pixels, shared with the rows before that look the same
+    for (uint32_t y = 0; y < video::HEIGHT; y++) {
+        std::vector<uint32_t> row(video::WIDTH, video::WHITE);
+        for (const video::Band& band : overlay) {
+            if (y >= band.top && y < band.bottom) {
+                std::fill(row.begin() + std::min<uint32_t>(band.left, video::WIDTH), row.begin() + std::min<uint32_t>(band.right, video::WIDTH), band.color);
+            }
+        }
+        uint32_t offset = 0;
+        while (offset < colors.size() && !std::equal(row.begin(), row.end(), colors.begin() + offset)) {
+            offset += video::WIDTH;
+        }
+        if (offset == colors.size()) {
+            colors.insert(colors.end(), row.begin(), row.end());
+        }
+        rows[y] = offset;
+    }
+    for (const uint32_t color : colors) {
+        grays.push_back(((color & 0xFF) * 77 + (color >> 8 & 0xFF) * 150 + (color >> 16 & 0xFF) * 29) >> 8);
+    }
+
+    if (wanted == video::Isa::BEST) {
+        wanted = available(video::Isa::AVX2) ? video::Isa::AVX2 : available(video::Isa::SSE) ? video::Isa::SSE : video::Isa::SCALAR;
+    } else if (!available(wanted)) {
+        wanted = video::Isa::SCALAR;
+    }
+    instructionSet = wanted;
+    kernels = wanted == video::Isa::AVX2 ? video::avx2 : wanted == video::Isa::SSE ? video::sse : video::scalar;
+}
+
+bool Video::available(video::Isa wanted) {
+    switch (wanted) {
+#if defined(__x86_64__) || defined(__i386__)
+        case video::Isa::SSE: return video::sse != nullptr && __builtin_cpu_supports("sse2");
+        case video::Isa::AVX2: return video::avx2 != nullptr && __builtin_cpu_supports("avx2");
+#else
+        case video::Isa::SSE:
+        case video::Isa::AVX2: return false;
+#endif
+        default: return true;
+    }
+}
+
+const uint8_t* Video::vram(const Memory& memory, uint8_t* copy) {
+    const uint8_t first = invaders::VRAM >> 8;
+    const uint8_t* start = memory.page(first);
+    bool contiguous = start != nullptr;
+    for (uint32_t page = 1; contiguous && page < invaders::VRAM_SIZE / Memory::PAGE_SIZE; page++) {
+        contiguous = memory.page(first + page) == start + page * Memory::PAGE_SIZE;
+    }
+    if (contiguous) {
+        return start;
+    }
+    for (uint32_t i = 0; i < invaders::VRAM_SIZE; i++) {
+        copy[i] = memory.read(invaders::VRAM + i);
+    }
+    return copy;
+}
+
+void Video::rgba(const Memory& memory, uint32_t* out) const {
+    uint8_t copy[invaders::VRAM_SIZE];
+    rgba(vram(memory, copy), out);
+}
+
+void Video::gray(const Memory& memory, uint8_t* out) const {
+    uint8_t copy[invaders::VRAM_SIZE];
+    gray(vram(memory, copy), out);
+}
+
+std::vector<video::Rect> Video::written(Memory& memory, uint32_t& blocks) {
+    std::vector<video::Rect> rects;
+    blocks = 0;
+    for (uint32_t x = 0; x < video::WIDTH; x++) {
+        if (!memory.lineWritten(invaders::VRAM + x * video::LINE)) {
+            continue;
+        }
+        blocks |= 1 << x / video::BLOCK;
+        if (!rects.empty() && rects.back().x + rects.back().width == x) {
+            rects.back().width++;
+        } else {
+            rects.push_back({uint16_t(x), 0, 1, video::HEIGHT});
+        }
+    }
+    memory.clearLines(invaders::VRAM, invaders::VRAM_SIZE);
+    return rects;
+}
+
+std::vector<video::Rect> Video::update(Memory& memory, uint32_t* out) const {
+    uint32_t blocks;
+    std::vector<video::Rect> rects = written(memory, blocks);
+    if (blocks != 0) {
+        uint8_t copy[invaders::VRAM_SIZE];
+        kernels->rgba(vram(memory, copy), out, palette(), blocks);
+    }
+    return rects;
+}
+
+std::vector<video::Rect> Video::update(Memory& memory, uint8_t* out) const {
+    uint32_t blocks;
+    std::vector<video::Rect> rects = written(memory, blocks);
+    if (blocks != 0) {
+        uint8_t copy[invaders::VRAM_SIZE];
+        kernels->gray(vram(memory, copy), out, palette(), blocks);
+    }
+    return rects;
+}
@@ -0,0 +1,41 @@
+#include "videoKernels.hpp"
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+
+namespace {
+    // 32 columns per register, lines x to x + 15 in the low half and x + 16 to x + 31 in the high one. The unpacks
+    // stay within the halves, so the transpose does both at once.
+    struct Avx2 {
+        using V = __m256i;
+        static constexpr uint32_t WIDTH = 32;
+
+        static V load(const void* p) { return _mm256_loadu_si256(static_cast<const __m256i*>(p)); }
+        static void store(void* p, V v) { _mm256_storeu_si256(static_cast<__m256i*>(p), v); }
+        static __m128i load128(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+
+        static V loadLines(const uint8_t* p) { return _mm256_inserti128_si256(_mm256_castsi128_si256(load128(p)), load128(p + 16 * video::LINE), 1); }
+        static V unpackLo(V a, V b) { return _mm256_unpacklo_epi8(a, b); }
+        static V unpackHi(V a, V b) { return _mm256_unpackhi_epi8(a, b); }
+        static V test(V bytes, uint8_t bit) { return _mm256_cmpeq_epi8(_mm256_and_si256(bytes, _mm256_set1_epi8(bit)), _mm256_set1_epi8(bit)); }
+
+        static void storeGray(uint8_t* out, const uint8_t* grays, V lit) { store(out, _mm256_and_si256(lit, load(grays))); }
+        static void storeRgba(uint32_t* out, const uint32_t* colors, V lit) {
+            // Every byte sign extended to a pixel, 8 at a time
+            const V alpha = _mm256_set1_epi32(video::BLACK);
+            const __m128i halves[2] = {_mm256_castsi256_si128(lit), _mm256_extracti128_si256(lit, 1)};
+            for (int i = 0; i < 2; i++) {
+                const V pixels[2] = {_mm256_cvtepi8_epi32(halves[i]), _mm256_cvtepi8_epi32(_mm_srli_si128(halves[i], 8))};
+                for (int j = 0; j < 2; j++) {
+                    const uint32_t at = i * 16 + j * 8;
+                    store(out + at, _mm256_or_si256(_mm256_and_si256(pixels[j], load(colors + at)), alpha));
+                }
+            }
+        }
+    };
+}
+
+const video::Kernels* const video::avx2 = &Rotate<Avx2>::kernels;
+#else
+const video::Kernels* const video::avx2 = nullptr;
+#endif
@@ -0,0 +1,62 @@
+#pragma once
+
+// SIMD kernels of Video, written once against an instruction set policy P that converts P::WIDTH columns of the image
+// at a time. videoSse.cpp and videoAvx2.cpp include this with their own policy and compiler flags, so everything here
+// has internal linkage, as in batchKernels.hpp.
+
+#include "video.hpp"
+
+namespace {
+    template<typename P> struct Rotate {
+        using V = typename P::V;
+
+        // Calls row(y, x, lit) with 0xFF in the bytes of the lit pixels in columns x up to x + P::WIDTH of row y,
+        // for the columns in blocks
+        template<typename Row> static void convert(const uint8_t* vram, uint32_t blocks, Row row) {
+            constexpr uint32_t BLOCKS = (1 << P::WIDTH / video::BLOCK) - 1; // per vector
+            for (uint32_t x = 0; x < video::WIDTH; x += P::WIDTH) {
+                if (!(blocks >> x / video::BLOCK & BLOCKS)) {
+                    continue;
+                }
+                for (uint32_t half = 0; half < video::LINE; half += 16) {
+                    // 16 bytes of each of 16 VRAM lines, transposed so that every vector holds one byte of all lines:
+                    // each round interleaves vector k with k + 8, four of them move the line index into the byte index.
+                    V v[16];
+                    for (uint32_t i = 0; i < 16; i++) {
+                        v[i] = P::loadLines(vram + (x + i) * video::LINE + half);
+                    }
+                    for (int round = 0; round < 4; round++) {
+                        V t[16];
+                        for (int k = 0; k < 8; k++) {
+                            t[2*k] = P::unpackLo(v[k], v[k+8]);
+                            t[2*k+1] = P::unpackHi(v[k], v[k+8]);
+                        }
+                        for (int k = 0; k < 16; k++) {
+                            v[k] = t[k];
+                        }
+                    }
+
+                    for (uint32_t byte = 0; byte < 16; byte++) {
+                        for (uint32_t bit = 0; bit < 8; bit++) {
+                            row(video::HEIGHT - 1 - (half + byte) * 8 - bit, x, P::test(v[byte], 1 << bit));
+                        }
+                    }
+                }
+            }
+        }
+
+        static void rgba(const uint8_t* vram, uint32_t* out, const video::Palette& palette, uint32_t blocks) {
+            convert(vram, blocks, [&](uint32_t y, uint32_t x, V lit) {
+                P::storeRgba(out + y * video::WIDTH + x, palette.colors + palette.rows[y] + x, lit);
+            });
+        }
+
+        static void gray(const uint8_t* vram, uint8_t* out, const video::Palette& palette, uint32_t blocks) {
+            convert(vram, blocks, [&](uint32_t y, uint32_t x, V lit) {
+                P::storeGray(out + y * video::WIDTH + x, palette.grays + palette.rows[y] + x, lit);
+            });
+        }
+
+        static constexpr video::Kernels kernels = {&rgba, &gray};
+    };
+}
@@ -0,0 +1,31 @@
+#include "video.hpp"
+
+namespace {
+    // A pixel at a time, for hosts without SIMD and as the reference for the others
+    template<typename Pixel> void convert(const uint8_t* vram, Pixel* out, const Pixel* colors, const uint32_t* rows, Pixel unlit,
+                                          uint32_t blocks) {
+        for (uint32_t y = 0; y < video::HEIGHT; y++) {
+            const uint32_t bit = video::HEIGHT - 1 - y; // of the VRAM line, counted from the bottom of the image
+            const Pixel* lit = colors + rows[y];
+            for (uint32_t x = 0; x < video::WIDTH; x++) {
+                if (!(blocks >> x / video::BLOCK & 1)) {
+                    x += video::BLOCK - 1;
+                    continue;
+                }
+                const bool on = vram[x * video::LINE + bit / 8] >> bit % 8 & 1;
+                out[y * video::WIDTH + x] = on ? lit[x] : unlit;
+            }
+        }
+    }
+
+    const video::Kernels kernels = {
+        [](const uint8_t* vram, uint32_t* out, const video::Palette& palette, uint32_t blocks) {
+            convert(vram, out, palette.colors, palette.rows, video::BLACK, blocks);
+        },
+        [](const uint8_t* vram, uint8_t* out, const video::Palette& palette, uint32_t blocks) {
+            convert<uint8_t>(vram, out, palette.grays, palette.rows, 0, blocks);
+        },
+    };
+}
+
+const video::Kernels* const video::scalar = &kernels;
@@ -0,0 +1,39 @@
+#include "videoKernels.hpp"
+
+#if defined(__SSE2__)
+#include <immintrin.h>
+
+namespace {
+    // 16 columns per register
+    struct Sse {
+        using V = __m128i;
+        static constexpr uint32_t WIDTH = 16;
+
+        static V load(const void* p) { return _mm_loadu_si128(static_cast<const __m128i*>(p)); }
+        static void store(void* p, V v) { _mm_storeu_si128(static_cast<__m128i*>(p), v); }
+
+        static V loadLines(const uint8_t* p) { return load(p); }
+        static V unpackLo(V a, V b) { return _mm_unpacklo_epi8(a, b); }
+        static V unpackHi(V a, V b) { return _mm_unpackhi_epi8(a, b); }
+        static V test(V bytes, uint8_t bit) { return _mm_cmpeq_epi8(_mm_and_si128(bytes, _mm_set1_epi8(bit)), _mm_set1_epi8(bit)); }
+
+        static void storeGray(uint8_t* out, const uint8_t* grays, V lit) { store(out, _mm_and_si128(lit, load(grays))); }
+        static void storeRgba(uint32_t* out, const uint32_t* colors, V lit) {
+            // Every byte widened to a pixel, by interleaving the mask with itself twice
+            const V alpha = _mm_set1_epi32(video::BLACK);
+            const V pairs[2] = {_mm_unpacklo_epi8(lit, lit), _mm_unpackhi_epi8(lit, lit)};
+            for (int i = 0; i < 2; i++) {
+                const V pixels[2] = {_mm_unpacklo_epi16(pairs[i], pairs[i]), _mm_unpackhi_epi16(pairs[i], pairs[i])};
+                for (int j = 0; j < 2; j++) {
+                    const uint32_t at = i * 8 + j * 4;
+                    store(out + at, _mm_or_si128(_mm_and_si128(pixels[j], load(colors + at)), alpha));
+                }
+            }
+        }
+    };
+}
+
+const video::Kernels* const video::sse = &Rotate<Sse>::kernels;
+#else
+const video::Kernels* const video::sse = nullptr;
+#endif
@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "batch.hpp"
+#include "invaders.hpp"
+#include "isa.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("Batch kernels agree with the switch") {
+    constexpr size_t LANES = 40; // more than one register of lanes, and a partial one
+    for (batch::Isa isa : {batch::Isa::SCALAR, batch::Isa::SSE, batch::Isa::AVX2}) {
+        if (!Batch::available(isa)) {
+            continue;
+        }
+        for (int opcode = 0; opcode <= 0xFF; opcode++) {
+            CAPTURE(int(isa), opcode);
+
+            // Every lane starts from other registers, so conditional jumps split them up
+            std::vector<Cpu> machines(LANES);
+            for (size_t lane = 0; lane < LANES; lane++) {
+                Registers& regs = CpuTestWrapper::getRegs(machines[lane]);
+                uint16_t value = opcode * 131 + lane * 7919;
+                for (uint8_t* r : {&regs.B, &regs.C, &regs.D, &regs.E, &regs.H, &regs.L, &regs.A}) {
+                    value = value * 75 + 74;
+                    *r = value >> 8;
+                }
+                value = value * 75 + 74;
+                regs.setF(value >> 8);
+                regs.SP = value * 75 + 74;
+                Memory& memory = CpuTestWrapper::getMemory(machines[lane]);
+                memory.write(regs.readHL(), value >> 3);
+                memory.write(0, opcode);
+                if (isa::opcodes[opcode].length > 1) {
+                    memory.write(1, value >> 5);
+                }
+                if (isa::opcodes[opcode].length > 2) {
+                    memory.write(2, value >> 9);
+                }
+            }
+            std::vector<Cpu> reference = machines;
+
+            Batch batch(machines, isa);
+            REQUIRE(batch.getIsa() == isa);
+            batch.run(1);
+            for (size_t lane = 0; lane < LANES; lane++) {
+                CAPTURE(lane);
+                reference[lane].decode();
+                requireSameState(batch.lane(lane), reference[lane]);
+            }
+            if (batch::vectorized(opcode)) {
+                REQUIRE(batch.getStats().scalarSteps == 0);
+            }
+        }
+    }
+}
+
+TEST_CASE("Batch lanes that branch apart meet again") {
+    const uint8_t program[] = {
+        0x05, // DCR B
+        0xC2, 0x00, 0x00, // JNZ 0x0000
+        0x3C, // INR A
+        0xC3, 0x04, 0x00, // JMP 0x0004
+    };
+    std::vector<Cpu> machines(9);
+    for (size_t lane = 0; lane < machines.size(); lane++) {
+        for (uint16_t address = 0; address < sizeof(program); address++) {
+            CpuTestWrapper::getMemory(machines[lane]).write(address, program[address]);
+        }
+        CpuTestWrapper::getRegs(machines[lane]).B = lane + 1;
+    }
+    std::vector<Cpu> reference = machines;
+
+    Batch batch(machines);
+    batch.run(500);
+    for (size_t lane = 0; lane < machines.size(); lane++) {
+        CAPTURE(lane);
+        while (reference[lane].getCycles() < 500) {
+            reference[lane].decode();
+        }
+        requireSameState(batch.lane(lane), reference[lane]);
+    }
+    REQUIRE(batch.getStats().scalarSteps == 0);
+}
+
+TEST_CASE("Batch runs the invaders boot like single Cpus") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+    Cpu reference = boot;
+    while (reference.getCycles() < 200'000) {
+        reference.decode();
+    }
+
+    Batch batch(boot, 37);
+    batch.run(200'000);
+    for (size_t lane = 0; lane < batch.size(); lane++) {
+        CAPTURE(lane);
+        requireSameState(batch.lane(lane), reference);
+    }
+    REQUIRE(batch.getStats().lockstepSteps > batch.getStats().scalarSteps);
+}
+
+TEST_CASE("Batch lanes take the interrupts of their Cpu") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+    invaders::Screen screen(boot);
+    // One instruction at a time like the lanes, run with the jit engine only stops between blocks
+    Cpu reference = boot;
+    reference.trace(10 * Pacer::CYCLES_PER_FRAME, [](uint16_t, uint8_t) {});
+
+    Batch batch(boot, 5);
+    batch.run(10 * Pacer::CYCLES_PER_FRAME);
+    for (size_t lane = 0; lane < batch.size(); lane++) {
+        CAPTURE(lane);
+        Cpu cpu = batch.lane(lane);
+        requireSameState(cpu, reference);
+        REQUIRE(cpu.getScheduler().deadline(screen.getEvent()) == reference.getScheduler().deadline(screen.getEvent()));
+        REQUIRE(cpu.getScheduler().deadline(screen.getEvent()) > 10 * Pacer::CYCLES_PER_FRAME);
+    }
+}
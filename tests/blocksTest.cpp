@@ -0,0 +1,147 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+
+#include "cpu.hpp"
+#include "sameState.hpp"
+
+TEST_CASE_METHOD(Cpu, "Block cache") {
+    std::stringstream fakerom;
+
+    SECTION("loop") {
+        const uint8_t program[] = {
+            0x06, 0x03, // MVI B, 3
+            0x05, // DCR B
+            0xC2, 0x02, 0x00, // JNZ 0x0002
+            0xC3, 0x06, 0x00, // JMP 0x0006
+        };
+        fakerom.write(reinterpret_cast<const char*>(program), sizeof(program));
+        REQUIRE(this->loadRom(fakerom) == 0);
+
+        REQUIRE(this->decodeBlock() == 7 + 5 + 10);
+        REQUIRE(this->regs.PC == 0x0002);
+        REQUIRE(this->decodeBlock() == 5 + 10);
+        REQUIRE(this->decodeBlock() == 5 + 10);
+        REQUIRE(this->regs.B == 0);
+        REQUIRE(this->regs.PC == 0x0006);
+
+        Cpu::BlockStats stats = this->getBlockStats();
+        REQUIRE(stats.hits == 1);
+        REQUIRE(stats.misses == 2);
+
+        this->decodeBlock();
+        this->decodeBlock();
+        stats = this->getBlockStats();
+        REQUIRE(stats.hits == 2);
+        REQUIRE(stats.misses == 3);
+        REQUIRE(stats.invalidations == 0);
+    }
+
+    SECTION("budget") {
+        // Memory starts zeroed, a block of NOPs
+        REQUIRE(this->decodeBlock(10) == 12);
+        REQUIRE(this->regs.PC == 3);
+        REQUIRE(this->decodeBlock() == 64 * 4);
+        REQUIRE(this->regs.PC == 3 + 64);
+    }
+
+    SECTION("self modifying code") {
+        const uint8_t program[] = {
+            0x3E, 0x07, // MVI A, 7
+            0x32, 0x06, 0x00, // STA 0x0006, the operand of the MVI below
+            0x06, 0x01, // MVI B, 1
+            0xC3, 0x00, 0x00, // JMP 0x0000
+        };
+        fakerom.write(reinterpret_cast<const char*>(program), sizeof(program));
+        REQUIRE(this->loadRom(fakerom) == 0);
+
+        // The block stops after the store into itself
+        REQUIRE(this->decodeBlock() == 7 + 13);
+        REQUIRE(this->regs.PC == 0x0005);
+        REQUIRE(this->getBlockStats().invalidations == 1);
+
+        this->decodeBlock();
+        REQUIRE(this->regs.B == 7);
+        REQUIRE(this->regs.PC == 0x0000);
+
+        // Storing the same value again still drops the block, whose operand is then read back unchanged
+        this->decodeBlock();
+        this->decodeBlock();
+        REQUIRE(this->regs.B == 7);
+        REQUIRE(this->getBlockStats().invalidations == 3);
+    }
+
+    SECTION("writes outside the block") {
+        const uint8_t program[] = {
+            0x21, 0x00, 0x20, // LXI H, 0x2000
+            0x34, // INR M
+            0xC3, 0x00, 0x00, // JMP 0x0000
+        };
+        fakerom.write(reinterpret_cast<const char*>(program), sizeof(program));
+        REQUIRE(this->loadRom(fakerom) == 0);
+
+        for (int i = 0; i < 5; i++) {
+            REQUIRE(this->decodeBlock() == 10 + 10 + 10);
+        }
+        REQUIRE(this->memory.read(0x2000) == 5);
+
+        const Cpu::BlockStats stats = this->getBlockStats();
+        REQUIRE(stats.hits == 4);
+        REQUIRE(stats.misses == 1);
+        REQUIRE(stats.invalidations == 0);
+    }
+}
+
+TEST_CASE_METHOD(Cpu, "Superinstructions") {
+    const uint8_t program[] = {
+        0x11, 0x00, 0x01, // LXI D, 0x0100
+        0x21, 0x00, 0x20, // LXI H, 0x2000
+        0x06, 0x10, // MVI B, 16
+        0x1A, // LDAX D
+        0x77, // MOV M,A
+        0x23, // INX H
+        0x13, // INX D
+        0x05, // DCR B
+        0xC2, 0x08, 0x00, // JNZ 0x0008
+    };
+    for (uint16_t address = 0; address < sizeof(program); address++) {
+        this->memory.write(address, program[address]);
+    }
+    for (uint16_t i = 0; i < 16; i++) {
+        this->memory.write(0x0100 + i, i * 7);
+    }
+
+    REQUIRE(this->decodeBlock() == 10 + 10 + 7 + 7 + 7 + 5 + 5 + 5 + 10);
+    REQUIRE(this->getBlockStats().fusions == 2); // LDAX D; MOV M,A and INX H; INX D; DCR B
+    for (int i = 1; i < 16; i++) {
+        REQUIRE(this->decodeBlock() == 7 + 7 + 5 + 5 + 5 + 10);
+    }
+    REQUIRE(this->regs.PC == sizeof(program));
+    REQUIRE(this->regs.B == 0);
+    REQUIRE(this->regs.getZero() == 1);
+    REQUIRE(this->regs.readHL() == 0x2010);
+    REQUIRE(this->regs.readDE() == 0x0110);
+    for (uint16_t i = 0; i < 16; i++) {
+        REQUIRE(this->memory.read(0x2000 + i) == i * 7);
+    }
+}
+
+TEST_CASE("Block cache runs the invaders boot like the switch") {
+    Cpu blocks, reference;
+    REQUIRE(blocks.loadRom(ROM_PATH) == 0);
+    REQUIRE(reference.loadRom(ROM_PATH) == 0);
+
+    // Blocks end on instruction boundaries, so the switch reaches the same state after the same cycles
+    uint64_t cycles = 0;
+    while (cycles < 200'000) {
+        cycles += blocks.decodeBlock();
+    }
+    uint64_t expected = 0;
+    while (expected < cycles) {
+        expected += reference.decodeSwitch();
+    }
+    REQUIRE(expected == cycles);
+
+    requireSameState(blocks, reference);
+    REQUIRE(blocks.getBlockStats().hits > blocks.getBlockStats().misses);
+    REQUIRE(blocks.getBlockStats().fusions > 0);
+}
@@ -186,4 +186,57 @@ TEST_CASE_METHOD(Cpu, "CPU") {
             REQUIRE(value2 == this->memory.read(address+1));
         }
     }
-}   
\ No newline at end of file
+
+    SECTION("Arithmetic Group") {
+        SECTION("DAA") {
+            // a + b in BCD: the sum and the carry out of the second digit
+            auto [a, b, sum, carry] = GENERATE(table<uint8_t, uint8_t, uint8_t, bool>({
+                {0x09, 0x08, 0x17, false}, // low digit corrected through AC
+                {0x38, 0x45, 0x83, false}, // low digit above 9
+                {0x50, 0x60, 0x10, true},  // high digit above 9
+                {0x99, 0x01, 0x00, true},  // both digits, the correction carries
+                {0x99, 0x99, 0x98, true},  // CY from the ADI, the correction itself does not carry
+                {0x12, 0x34, 0x46, false}, // nothing to correct
+            }));
+            fakerom.put(0x3E); // MVI A, a
+            fakerom.put(a);
+            fakerom.put(0xC6); // ADI b
+            fakerom.put(b);
+            fakerom.put(0x27); // DAA
+
+            REQUIRE(this->loadRom(fakerom) == 0);
+            this->decode();
+            this->decode();
+            this->decode();
+            REQUIRE(this->regs.A == sum);
+            REQUIRE(this->regs.getCarry() == carry);
+        }
+    }
+}   
+TEST_CASE_METHOD(Cpu, "Run") {
+    // Memory starts zeroed, so the CPU runs through NOPs of 4 cycles each
+
+    SECTION("run") {
+        REQUIRE(this->run(10) == 2);
+        REQUIRE(this->regs.PC == 3);
+        REQUIRE(this->getCycles() == 12);
+
+        REQUIRE(this->run(0) == 0);
+        REQUIRE(this->regs.PC == 3);
+
+        REQUIRE(this->run(8) == 0);
+        REQUIRE(this->regs.PC == 5);
+        REQUIRE(this->getCycles() == 20);
+    }
+
+    SECTION("runUntil") {
+        REQUIRE(this->runUntil([this] { return this->regs.PC == 0x10; }) == 0x40);
+        REQUIRE(this->getCycles() == 0x40);
+        REQUIRE(this->runUntil([] { return true; }) == 0);
+    }
+
+    SECTION("decode counts cycles") {
+        this->decode();
+        REQUIRE(this->getCycles() == 4);
+    }
+}
@@ -0,0 +1,35 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_adapters.hpp>
+#include <catch2/generators/catch_generators_random.hpp>
+
+#include "cpu.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("Dispatch engines agree") {
+    auto seed = GENERATE(take(4, random(0, 0xFFFF)));
+
+    for (int opcode = 0; opcode <= 0xFF; opcode++) {
+        CAPTURE(opcode, seed);
+
+        Cpu reference, table;
+        for (Cpu* cpu : {&reference, &table}) {
+            Registers& regs = CpuTestWrapper::getRegs(*cpu);
+            uint16_t value = seed;
+            for (uint8_t* r : {&regs.B, &regs.C, &regs.D, &regs.E, &regs.H, &regs.L, &regs.A}) {
+                value = value * 75 + 74; // same pseudo random state on both
+                *r = value >> 8;
+            }
+            value = value * 75 + 74;
+            regs.setF(value >> 8);
+            regs.SP = value * 75 + 74;
+            CpuTestWrapper::getMemory(*cpu).write(regs.readHL(), seed >> 3);
+            CpuTestWrapper::getMemory(*cpu).write(0, opcode);
+            CpuTestWrapper::getMemory(*cpu).write(1, seed);
+            CpuTestWrapper::getMemory(*cpu).write(2, seed >> 8);
+        }
+        REQUIRE(reference.decodeSwitch() == table.decodeTable());
+
+        requireSameState(table, reference);
+    }
+}
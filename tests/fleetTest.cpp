@@ -0,0 +1,30 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "fleet.hpp"
+#include "pacer.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("Fleet runs every instance like a single Cpu") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+
+    // Frames of the invaders boot, the way main runs them
+    constexpr uint64_t FRAMES = 4;
+    Cpu reference = boot;
+    uint64_t overshoot = 0;
+    for (uint64_t frame = 0; frame < 2 * FRAMES; frame++) {
+        overshoot = reference.run(Pacer::CYCLES_PER_FRAME - overshoot);
+    }
+
+    Fleet fleet(boot, 12);
+    fleet.run(FRAMES, 3);
+    fleet.run(FRAMES, 5, false); // picks up where the first run stopped
+    REQUIRE(fleet.emulatedMHz() > 0);
+
+    for (size_t i = 0; i < fleet.size(); i++) {
+        CAPTURE(i);
+        REQUIRE(fleet.progress(i).frames == 2 * FRAMES);
+        REQUIRE(fleet.progress(i).cycles == reference.getCycles());
+        requireSameState(fleet.instance(i), reference);
+    }
+}
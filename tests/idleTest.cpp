@@ -0,0 +1,99 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+
+namespace {
+    // Sets the byte at 0x2000 to 1 when it fires, what an interrupt handler would do
+    uint64_t raiseFlag(void*, Cpu& cpu, uint64_t) {
+        cpu.getMemory().write(0x2000, 1);
+        return Scheduler::NEVER;
+    }
+
+    // Interrupts with RST 0 every 10000 cycles
+    uint64_t tick(void*, Cpu& cpu, uint64_t cycle) {
+        cpu.interrupt(0);
+        return cycle + 10000;
+    }
+
+    // Runs program with event first firing at cycle 10000, with and without fast-forward. Both have to end in the same state.
+    uint64_t skipped(const std::vector<uint8_t>& program, Scheduler::Callback event = raiseFlag, uint64_t budget = 20000) {
+        uint64_t hashes[2], skips[2], cycles[2];
+        for (int fastForward = 0; fastForward < 2; fastForward++) {
+            Cpu cpu;
+            cpu.getMemory().load(program.data(), program.size());
+            cpu.getScheduler().schedule(cpu.getScheduler().add(event, nullptr), 10000);
+            cpu.setFastForward(fastForward);
+            cpu.run(budget);
+            hashes[fastForward] = cpu.stateHash();
+            skips[fastForward] = cpu.getSkippedCycles();
+            cycles[fastForward] = cpu.getCycles();
+        }
+        REQUIRE(skips[0] == 0);
+        REQUIRE(cycles[1] == cycles[0]);
+        REQUIRE(hashes[1] == hashes[0]);
+        return skips[1];
+    }
+}
+
+TEST_CASE("Idle fast-forward") {
+    SECTION("skips a spin loop on memory up to the event") {
+        const uint64_t skips = skipped({
+            0x3A, 0x00, 0x20,   // 0x00 LDA 0x2000
+            0xA7,               //      ANA A
+            0xCA, 0x00, 0x00,   //      JZ 0x00
+            0x3C,               //      INR A
+            0xC3, 0x07, 0x00,   // 0x07 JMP 0x07
+        });
+        REQUIRE(skips > 5000);
+        REQUIRE(skips % 27 == 0); // whole iterations of LDA, ANA, JZ
+    }
+
+    SECTION("skips HLT up to the interrupt") {
+        const uint64_t skips = skipped({
+            0xFB,               // 0x00 EI
+            0x76,               //      HLT
+            0xC3, 0x00, 0x00,   //      JMP 0x00
+        }, tick, 100000);
+        REQUIRE(skips > 100000 / 2);
+    }
+
+    SECTION("runs loops that change the state") {
+        REQUIRE(skipped({
+            0x3A, 0x00, 0x20,   // 0x00 LDA 0x2000
+            0x04,               //      INR B, counts
+            0xC3, 0x00, 0x00,   //      JMP 0x00
+        }) == 0);
+        REQUIRE(skipped({
+            0x21, 0x00, 0x21,   // 0x00 LXI H,0x2100
+            0x34,               // 0x03 INR M, writes memory
+            0xC3, 0x03, 0x00,   //      JMP 0x03
+        }) == 0);
+        REQUIRE(skipped({
+            0xDB, 0x01,         // 0x00 IN 1
+            0xD3, 0x02,         //      OUT 2, can reach a device
+            0xC3, 0x00, 0x00,   //      JMP 0x00
+        }) == 0);
+    }
+
+    SECTION("the invaders attract mode idles most of the time") {
+        RomImage rom;
+        REQUIRE(rom.open(ROM_PATH) == 0);
+        uint64_t hashes[2], skips[2];
+        for (int fastForward = 0; fastForward < 2; fastForward++) {
+            Cpu cpu;
+            invaders::map(cpu.getMemory(), rom);
+            invaders::Shifter shifter;
+            shifter.attach(cpu.getPorts());
+            invaders::Screen screen(cpu);
+            cpu.setFastForward(fastForward);
+            for (int frame = 0; frame < 120; frame++) {
+                cpu.run(Pacer::CYCLES_PER_FRAME);
+            }
+            hashes[fastForward] = cpu.stateHash();
+            skips[fastForward] = cpu.getSkippedCycles();
+        }
+        REQUIRE(hashes[1] == hashes[0]);
+        REQUIRE(skips[1] > 120 * Pacer::CYCLES_PER_FRAME / 2);
+    }
+}
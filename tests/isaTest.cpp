@@ -0,0 +1,97 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_adapters.hpp>
+#include <catch2/generators/catch_generators_random.hpp>
+
+#include "cpu.hpp"
+#include "isa.hpp"
+
+TEST_CASE("Opcode table") {
+    auto seed = GENERATE(take(4, random(0, 0xFFFF)));
+
+    for (int opcode = 0; opcode <= 0xFF; opcode++) {
+        const isa::Opcode& info = isa::opcodes[opcode];
+        CAPTURE(opcode, info.mnemonic, seed);
+
+        Cpu cpu;
+        Registers& regs = CpuTestWrapper::getRegs(cpu);
+        uint16_t value = seed;
+        for (uint8_t* r : {&regs.B, &regs.C, &regs.D, &regs.E, &regs.H, &regs.L, &regs.A}) {
+            value = value * 75 + 74;
+            *r = value >> 8;
+        }
+        value = value * 75 + 74;
+        regs.setF(value >> 8);
+        regs.SP = 0x2400; // clear of the opcode and its operands
+        regs.setHL(regs.readHL() | 0x8000);
+        CpuTestWrapper::getMemory(cpu).write(0, opcode);
+        CpuTestWrapper::getMemory(cpu).write(1, seed);
+        CpuTestWrapper::getMemory(cpu).write(2, seed >> 8);
+
+        const uint8_t flags = regs.getF();
+        const int cycles = cpu.decodeSwitch();
+
+        if (opcode == 0x76) { // HLT waits on itself
+            REQUIRE(regs.halted);
+            REQUIRE(regs.PC == 0);
+        } else if (!isa::branches(opcode)) {
+            REQUIRE(regs.PC == info.length);
+        }
+
+        const bool taken = regs.SP != 0x2400 && info.takenCycles != 0; // conditional CALL or RET that moved the stack
+        REQUIRE(cycles == info.cycles + (taken ? info.takenCycles : 0));
+
+        REQUIRE(((regs.getF() ^ flags) & ~info.flags & isa::ALL) == 0); // only the listed flags change
+    }
+}
+
+TEST_CASE_METHOD(Cpu, "Conditional CALL and RET cycles") {
+    auto cc = GENERATE(range(0, 8));
+    const uint8_t call = 0b11000100 | (cc << 3);
+    const uint8_t ret = 0b11000000 | (cc << 3);
+    const uint8_t flag = std::array<uint8_t, 4>{Registers::ZERO_FLAG, Registers::CARRY_FLAG, Registers::PARITY_FLAG, Registers::SIGN_FLAG}[cc >> 1];
+    CAPTURE(cc);
+
+    // Odd conditions are taken when the flag is set
+    const bool taken = GENERATE(false, true);
+    this->regs.setF(taken == (cc & 1) ? flag : 0);
+    this->regs.SP = 0x2400;
+    this->memory.write(0, call);
+    this->memory.write(1, 0x00);
+    this->memory.write(2, 0x10);
+    this->memory.write(0x1000, ret);
+
+    REQUIRE(this->decode() == (taken ? 17 : 11));
+    REQUIRE(this->regs.PC == (taken ? 0x1000 : 3));
+    if (taken) {
+        REQUIRE(this->decode() == 11);
+        REQUIRE(this->regs.PC == 3);
+    }
+}
+
+TEST_CASE_METHOD(Cpu, "Disassemble") {
+    const uint8_t program[] = { 0x00, 0x06, 0x2A, 0x21, 0x34, 0x12, 0xC3, 0xCD, 0xAB, 0x7E, 0xCB, 0x00, 0x00 };
+    for (uint16_t address = 0; address < sizeof(program); address++) {
+        this->memory.write(address, program[address]);
+    }
+
+    REQUIRE(isa::disassemble(this->memory, 0) == "NOP");
+    REQUIRE(isa::disassemble(this->memory, 1) == "MVI B,$2A");
+    REQUIRE(isa::disassemble(this->memory, 3) == "LXI H,$1234");
+    REQUIRE(isa::disassemble(this->memory, 6) == "JMP $ABCD");
+    REQUIRE(isa::disassemble(this->memory, 9) == "MOV A,M");
+    REQUIRE(isa::disassemble(this->memory, 10) == "*JMP $0000");
+}
+
+TEST_CASE("T-states") {
+    REQUIRE(isa::opcodes[0x00].cycles == 4); // NOP
+    REQUIRE(isa::opcodes[0x41].cycles == 5); // MOV B,C
+    REQUIRE(isa::opcodes[0x46].cycles == 7); // MOV B,M
+    REQUIRE(isa::opcodes[0x36].cycles == 10); // MVI M
+    REQUIRE(isa::opcodes[0x3A].cycles == 13); // LDA
+    REQUIRE(isa::opcodes[0x2A].cycles == 16); // LHLD
+    REQUIRE(isa::opcodes[0xC5].cycles == 11); // PUSH B
+    REQUIRE(isa::opcodes[0xE3].cycles == 18); // XTHL
+    REQUIRE(isa::opcodes[0xCD].cycles == 17); // CALL
+    REQUIRE(isa::opcodes[0xC9].cycles == 10); // RET
+}
@@ -0,0 +1,113 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <catch2/generators/catch_generators_adapters.hpp>
+#include <catch2/generators/catch_generators_random.hpp>
+
+#include "cpu.hpp"
+#include "isa.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("JIT agrees with the switch") {
+    if (!Jit::available()) {
+        return;
+    }
+    auto seed = GENERATE(take(4, random(0, 0xFFFF)));
+
+    for (int opcode = 0; opcode <= 0xFF; opcode++) {
+        CAPTURE(opcode, seed);
+
+        Cpu reference, jit;
+        for (Cpu* cpu : {&reference, &jit}) {
+            Registers& regs = CpuTestWrapper::getRegs(*cpu);
+            uint16_t value = seed;
+            for (uint8_t* r : {&regs.B, &regs.C, &regs.D, &regs.E, &regs.H, &regs.L, &regs.A}) {
+                value = value * 75 + 74; // same pseudo random state on both
+                *r = value >> 8;
+            }
+            value = value * 75 + 74;
+            regs.setF(value >> 8);
+            regs.SP = value * 75 + 74;
+            CpuTestWrapper::getMemory(*cpu).write(regs.readHL(), seed >> 3);
+            CpuTestWrapper::getMemory(*cpu).write(0, opcode);
+            if (isa::opcodes[opcode].length > 1) {
+                CpuTestWrapper::getMemory(*cpu).write(1, seed);
+            }
+            if (isa::opcodes[opcode].length > 2) {
+                CpuTestWrapper::getMemory(*cpu).write(2, seed >> 8);
+            }
+        }
+
+        // The opcode, then NOPs up to the end of the block
+        CpuTestWrapper::compile(jit, 0);
+        REQUIRE(jit.getBlockStats().compiled == 1);
+        const uint64_t cycles = jit.decodeJit();
+        REQUIRE(jit.getBlockStats().nativeRuns == 1);
+
+        uint64_t expected = 0;
+        while (expected < cycles) {
+            expected += reference.decodeSwitch();
+        }
+        REQUIRE(expected == cycles);
+        requireSameState(jit, reference);
+    }
+}
+
+TEST_CASE("JIT runs the invaders boot like the switch") {
+    Cpu jit, reference;
+    REQUIRE(jit.loadRom(ROM_PATH) == 0);
+    REQUIRE(reference.loadRom(ROM_PATH) == 0);
+
+    uint64_t cycles = 0;
+    while (cycles < 200'000) {
+        cycles += jit.decodeJit();
+    }
+    uint64_t expected = 0;
+    while (expected < cycles) {
+        expected += reference.decodeSwitch();
+    }
+    REQUIRE(expected == cycles);
+    requireSameState(jit, reference);
+
+    if (Jit::available()) {
+        REQUIRE(jit.getBlockStats().compiled > 0);
+        REQUIRE(jit.getBlockStats().nativeRuns > jit.getBlockStats().misses);
+    }
+}
+
+TEST_CASE_METHOD(Cpu, "JIT drops rewritten code") {
+    if (!Jit::available()) {
+        return;
+    }
+    const uint8_t program[] = {
+        0x06, 0x01, // MVI B, 1
+        0xC3, 0x00, 0x00, // JMP 0x0000
+    };
+    for (uint16_t address = 0; address < sizeof(program); address++) {
+        this->memory.write(address, program[address]);
+    }
+
+    for (uint32_t i = 0; i < Jit::HOT + 4; i++) {
+        REQUIRE(this->decodeJit() == 7 + 10);
+    }
+    REQUIRE(this->getBlockStats().compiled == 1);
+    REQUIRE(this->getBlockStats().nativeRuns == 4);
+    REQUIRE(this->regs.B == 1);
+
+    // The native block has the old operand built in
+    this->memory.write(1, 9);
+    this->decodeJit();
+    REQUIRE(this->regs.B == 9);
+    REQUIRE(this->getBlockStats().compiled == 0);
+    REQUIRE(this->getBlockStats().invalidations == 1);
+
+    // Rewritten code is compiled again until it has been rewritten too often
+    for (uint8_t rewrite = 1; rewrite < Jit::MAX_REWRITES + 2; rewrite++) {
+        for (uint32_t i = 0; i < Jit::HOT; i++) {
+            this->decodeJit();
+        }
+        REQUIRE(this->getBlockStats().compiled == (rewrite < Jit::MAX_REWRITES ? 1 : 0));
+        this->memory.write(1, rewrite);
+        this->decodeJit();
+        REQUIRE(this->regs.B == rewrite);
+    }
+}
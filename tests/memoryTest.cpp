@@ -27,4 +27,186 @@ TEST_CASE_METHOD(Memory, "Memory") {
         this->write(address, value);
         REQUIRE(value == this->data[address]);
     }
-}
\ No newline at end of file
+}
+namespace {
+    struct Device {
+        uint16_t lastAddress = 0;
+        uint8_t lastValue = 0;
+
+        static uint8_t read(void* context, uint16_t address) { return (address & 0xFF) ^ static_cast<Device*>(context)->lastValue; }
+        static void write(void* context, uint16_t address, uint8_t value) {
+            Device* device = static_cast<Device*>(context);
+            device->lastAddress = address;
+            device->lastValue = value;
+        }
+    };
+}
+
+TEST_CASE("Memory map") {
+    Memory memory;
+    const uint8_t rom[0x180] = {0x3E, 0x42};
+
+    SECTION("ROM ignores writes") {
+        memory.write(0x1000, 0x11);
+        memory.mapRom(0x1000, Memory::PAGE_SIZE);
+        memory.write(0x1000, 0x22);
+        REQUIRE(memory.read(0x1000) == 0x11);
+        REQUIRE_FALSE(memory.writable(0x1000));
+        REQUIRE(memory.writable(0x1100));
+    }
+
+    SECTION("shared ROM is read in place") {
+        memory.mapRom(0x0000, rom, sizeof(rom));
+        REQUIRE(memory.read16(0x0000) == 0x423E);
+        memory.write(0x0001, 0);
+        REQUIRE(memory.read(0x0001) == 0x42);
+
+        // The partial page is a copy
+        memory.write(0x0100, 0x77);
+        REQUIRE(memory.read(0x0100) == 0);
+        REQUIRE(memory.read(0x0180) == 0);
+    }
+
+    SECTION("mirrors") {
+        memory.mirror(0x8000, 0x200, 0x2000);
+        memory.write(0x2001, 0x55);
+        REQUIRE(memory.read(0x8001) == 0x55);
+        memory.write(0x8101, 0x66);
+        REQUIRE(memory.read(0x2101) == 0x66);
+
+        // Code watched at one address is invalidated through the other
+        memory.watchCode(0x2000);
+        memory.write(0x8010, 0);
+        REQUIRE(memory.codeWrites() == std::vector<uint8_t>{0x20, 0x80});
+
+        // and through a mirror made after it was watched
+        memory.codeWrites().clear();
+        memory.watchCode(0x2000);
+        memory.mirror(0xC000, 0x100, 0x2000);
+        memory.write(0xC010, 0);
+        REQUIRE(memory.codeWrites() == std::vector<uint8_t>{0x20, 0x80, 0xC0});
+    }
+
+    SECTION("I/O") {
+        Device device;
+        memory.mapIo(0x6000, Memory::PAGE_SIZE, {Device::read, Device::write, &device});
+        memory.write(0x6012, 0xF0);
+        REQUIRE(device.lastAddress == 0x6012);
+        REQUIRE(memory.read(0x6003) == 0xF3);
+        REQUIRE(memory.read(0x6103) == 0); // the next page is still RAM
+    }
+
+    SECTION("copies own their RAM and share the ROM") {
+        memory.mapRom(0x0000, rom, sizeof(rom));
+        memory.mirror(0x4000, 0x100, 0x2000);
+        Memory copy = memory;
+        copy.write(0x2000, 0x99);
+        REQUIRE(memory.read(0x2000) == 0);
+        REQUIRE(copy.read(0x4000) == 0x99);
+        REQUIRE(copy.read(0x0001) == 0x42);
+
+        memory = copy;
+        REQUIRE(memory.read(0x4000) == 0x99);
+        memory.write(0x4000, 0);
+        REQUIRE(copy.read(0x2000) == 0x99);
+    }
+}
+
+TEST_CASE("Memory hash") {
+    Memory memory;
+    REQUIRE(memory.hash() == 0); // blank
+
+    memory.mapRom(0x0000, Memory::PAGE_SIZE);
+    memory.mirror(0x4000, 0x100, 0x2000);
+    Memory other = memory;
+
+    SECTION("follows the contents, not how they got there") {
+        memory.write(0x2010, 0xAB);
+        REQUIRE(memory.hash() != other.hash());
+        REQUIRE(memory.pageHash(0x20) != other.pageHash(0x20));
+        REQUIRE(memory.pageHash(0x21) == other.pageHash(0x21));
+
+        const uint8_t byte = 0xAB;
+        other.load(&byte, 1, 0x4010); // through the mirror
+        REQUIRE(memory.hash() == other.hash());
+        REQUIRE(memory.pageHash(0x40) == memory.pageHash(0x20));
+
+        memory.write(0x2010, 0);
+        memory.write(0x2011, 0xAB); // same bytes, another address
+        REQUIRE(memory.hash() != other.hash());
+    }
+
+    SECTION("ignores writes to ROM") {
+        const uint64_t before = memory.hash();
+        memory.write(0x0005, 0x77);
+        REQUIRE(memory.hash() == before);
+    }
+
+    SECTION("is restored with the pages") {
+        Memory snapshot = memory;
+        memory.clearDirty();
+        memory.write(0x3000, 1);
+        memory.write(0x4001, 2);
+        memory.restore(snapshot);
+        REQUIRE(memory.hash() == snapshot.hash());
+        REQUIRE(memory.pageHash(0x20) == snapshot.pageHash(0x20));
+    }
+}
+
+TEST_CASE("Memory line tracking") {
+    Memory memory;
+    memory.mirror(0x6400, 0x400, 0x2400);
+    memory.watchLines(0x2400, 0x400);
+    auto written = [&](uint16_t from, uint16_t to) {
+        uint32_t lines = 0;
+        for (uint32_t address = from; address < to; address += Memory::LINE_SIZE) {
+            lines += memory.lineWritten(address);
+        }
+        return lines;
+    };
+    REQUIRE(written(0x2400, 0x2800) == 0x400 / Memory::LINE_SIZE); // all to begin with
+    memory.clearLines(0x2400, 0x400);
+    REQUIRE(written(0x2400, 0x2800) == 0);
+
+    SECTION("writes mark their line") {
+        memory.write(0x2421, 1);
+        memory.write(0x6440, 1); // through the mirror, line 2
+        memory.write(0x2800, 1); // not watched
+        REQUIRE(written(0x2400, 0x2800) == 2);
+        REQUIRE(memory.lineWritten(0x2420));
+        REQUIRE(memory.lineWritten(0x2440));
+        REQUIRE(memory.lineWritten(0x6420)); // the same storage
+        REQUIRE_FALSE(memory.lineWritten(0x2800));
+
+        memory.clearLines(0x6420, 1);
+        REQUIRE_FALSE(memory.lineWritten(0x2420));
+        REQUIRE(memory.lineWritten(0x2440));
+    }
+
+    SECTION("loads and restores mark the lines they copy") {
+        const Memory before = memory;
+        const uint8_t bytes[40] = {};
+        memory.load(bytes, sizeof(bytes), 0x25F0); // across 2 lines and 2 pages
+        REQUIRE(written(0x2400, 0x2800) == 2);
+        memory.clearLines(0x2400, 0x400);
+
+        memory.restore(before);
+        REQUIRE(written(0x2500, 0x2700) == 0x200 / Memory::LINE_SIZE); // the pages the load dirtied
+        REQUIRE(written(0x2400, 0x2500) == 0);
+        REQUIRE(written(0x2700, 0x2800) == 0);
+    }
+
+    SECTION("mirrors made later watch too") {
+        memory.mirror(0xA400, 0x400, 0x2400);
+        memory.write(0xA460, 1);
+        REQUIRE(memory.lineWritten(0x2460));
+        REQUIRE(written(0x2400, 0x2800) == 1);
+    }
+
+    SECTION("copies keep watching") {
+        Memory copy = memory;
+        copy.write(0x27FF, 1);
+        REQUIRE(copy.lineWritten(0x27E0));
+        REQUIRE_FALSE(memory.lineWritten(0x27E0));
+    }
+}
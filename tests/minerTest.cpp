@@ -0,0 +1,28 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+
+#include "miner.hpp"
+
+TEST_CASE("Sequence miner") {
+    SequenceMiner miner;
+    // DCR B; JNZ three times, with a store that ends every sequence it is in
+    for (int i = 0; i < 3; i++) {
+        miner.record(0x05); // DCR B
+        miner.record(0xC2); // JNZ
+    }
+    miner.record(0x77); // MOV M,A
+    miner.record(0x23); // INX H
+
+    const std::vector<SequenceMiner::Candidate> candidates = miner.candidates(10);
+    REQUIRE(candidates.front().opcodes == std::vector<uint8_t>{0x05, 0xC2});
+    REQUIRE(candidates.front().count == 3);
+    for (const SequenceMiner::Candidate& candidate : candidates) {
+        REQUIRE(candidate.opcodes != std::vector<uint8_t>{0xC2, 0x05}); // JNZ leaves the sequence
+        REQUIRE(candidate.opcodes != std::vector<uint8_t>{0x77, 0x23}); // so does a store
+    }
+    REQUIRE(miner.candidates(10, 2).size() == 1);
+
+    std::ostringstream text;
+    SequenceMiner::write(text, miner.candidates(1));
+    REQUIRE(text.str() == "FUSE(0x05, 0xC2) // DCR B; JNZ a16; 3 times\n");
+}
@@ -0,0 +1,132 @@
+#include <catch2/catch_test_macros.hpp>
+#include <vector>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+
+namespace {
+    struct Latch : PortDevice<Latch> {
+        uint8_t lastPort = 0, lastValue = 0;
+
+        uint8_t read(uint8_t port) { return port + 1; }
+        void write(uint8_t port, uint8_t value) {
+            lastPort = port;
+            lastValue = value;
+        }
+    };
+}
+
+TEST_CASE("Ports") {
+    Ports ports;
+    Latch latch;
+
+    SECTION("unattached ports read 0 and ignore writes") {
+        REQUIRE(ports.in(0x42) == 0);
+        ports.out(0x42, 1);
+    }
+
+    SECTION("devices get the ports they attach to") {
+        latch.attach(ports, {7, 9}, {9});
+        REQUIRE(ports.in(7) == 8);
+        REQUIRE(ports.in(9) == 10);
+        REQUIRE(ports.in(8) == 0);
+        ports.out(9, 0x55);
+        ports.out(7, 0x66);
+        REQUIRE(latch.lastPort == 9);
+        REQUIRE(latch.lastValue == 0x55);
+
+        ports.detach(9);
+        REQUIRE(ports.in(9) == 0);
+    }
+
+    SECTION("IN and OUT go through the bus") {
+        Cpu cpu;
+        latch.attach(cpu.getPorts(), {0x10}, {0x20});
+        const uint8_t program[] = {
+            0xDB, 0x10, // IN 0x10
+            0x3C,       // INR A
+            0xD3, 0x20, // OUT 0x20
+        };
+        cpu.getMemory().load(program, sizeof(program));
+        cpu.run(10 + 5 + 10);
+        REQUIRE(latch.lastPort == 0x20);
+        REQUIRE(latch.lastValue == 0x12);
+    }
+}
+
+TEST_CASE("Invaders shift register") {
+    Ports ports;
+    invaders::Shifter shifter;
+    shifter.attach(ports);
+
+    ports.out(invaders::SHIFT_DATA, 0xAB);
+    ports.out(invaders::SHIFT_DATA, 0xCD); // 0xCDAB
+    ports.out(invaders::SHIFT_OFFSET, 0);
+    REQUIRE(ports.in(invaders::SHIFT_RESULT) == 0xCD);
+    ports.out(invaders::SHIFT_OFFSET, 4);
+    REQUIRE(ports.in(invaders::SHIFT_RESULT) == 0xDA);
+    ports.out(invaders::SHIFT_OFFSET, 7 | 0xF8); // only the low 3 bits count
+    REQUIRE(ports.in(invaders::SHIFT_RESULT) == 0xD5);
+
+    ports.out(invaders::SHIFT_DATA, 0x01); // 0x01CD
+    ports.out(invaders::SHIFT_OFFSET, 2);
+    REQUIRE(ports.in(invaders::SHIFT_RESULT) == 0x07);
+}
+
+TEST_CASE("Copies of a Cpu rebind their ports to their own devices") {
+    Cpu boot;
+    invaders::Shifter shifter;
+    shifter.attach(boot.getPorts());
+    const uint8_t program[] = {
+        0xD3, invaders::SHIFT_DATA,  // OUT SHIFT_DATA
+        0xDB, invaders::SHIFT_RESULT, // IN SHIFT_RESULT
+    };
+    boot.getMemory().load(program, sizeof(program));
+
+    Cpu first = boot, second = boot;
+    invaders::Shifter shifters[2] = {shifter, shifter};
+    first.getPorts().rebind(&shifter, &shifters[0]);
+    second.getPorts().rebind(&shifter, &shifters[1]);
+    CpuTestWrapper::getRegs(first).A = 0x12;
+    CpuTestWrapper::getRegs(second).A = 0x34;
+    first.run(10 + 10);
+    second.run(10 + 10);
+
+    REQUIRE(CpuTestWrapper::getRegs(first).A == 0x12);
+    REQUIRE(CpuTestWrapper::getRegs(second).A == 0x34);
+    REQUIRE(boot.getPorts().in(invaders::SHIFT_RESULT) == 0); // the original never shifted
+    REQUIRE(first.getPorts().input(invaders::SHIFT_RESULT).context == &shifters[0]);
+    REQUIRE(second.getPorts().output(invaders::SHIFT_OFFSET).context == &shifters[1]);
+}
+
+TEST_CASE("Devices see the cycle IN and OUT run at") {
+    struct Clock : PortDevice<Clock> {
+        const Cpu* cpu = nullptr;
+        std::vector<uint64_t> reads, writes;
+
+        uint8_t read(uint8_t) { reads.push_back(cpu->getCycles()); return 0; }
+        void write(uint8_t, uint8_t) { writes.push_back(cpu->getCycles()); }
+    };
+    Cpu cpu;
+    Clock clock;
+    clock.cpu = &cpu;
+    clock.attach(cpu.getPorts(), {0x10}, {0x20});
+    const uint8_t program[] = {
+        0x00,             // NOP
+        0xDB, 0x10,       // IN 0x10
+        0x00,             // NOP
+        0xD3, 0x20,       // OUT 0x20
+        0xC3, 0x00, 0x00, // JMP 0
+    };
+    cpu.getMemory().load(program, sizeof(program));
+
+    // Enough times around for the block and JIT engines to compile the loop, in one run
+    constexpr uint64_t PERIOD = 4 + 10 + 4 + 10 + 10, LOOPS = 500;
+    cpu.run(PERIOD * LOOPS);
+    REQUIRE(clock.reads.size() == LOOPS);
+    REQUIRE(clock.writes.size() == LOOPS);
+    for (uint64_t i = 0; i < LOOPS; i++) {
+        REQUIRE(clock.reads[i] == PERIOD * i + 4);
+        REQUIRE(clock.writes[i] == PERIOD * i + 4 + 10 + 4);
+    }
+}
@@ -0,0 +1,78 @@
+#include <catch2/catch_test_macros.hpp>
+#include <sstream>
+
+#include "cpu.hpp"
+#include "recompiler.hpp"
+#include "sameState.hpp"
+
+extern const recompiled::Rom recompiledInvaders; // generated at build time, see tools/CMakeLists.txt
+
+TEST_CASE("Recompiler follows the control flow") {
+    Memory rom;
+    const uint8_t program[] = {
+        0xC3, 0x40, 0x00, // 0x00 JMP 0x0040
+    };
+    const uint8_t code[] = {
+        0x3E, 0x01, // 0x40 MVI A, 1
+        0xCD, 0x50, 0x00, // 0x42 CALL 0x0050
+        0xCA, 0x40, 0x00, // 0x45 JZ 0x0040
+        0xE9, // 0x48 PCHL
+    };
+    const uint8_t subroutine[] = {
+        0xD3, 0x01, // 0x50 OUT 1
+        0xC9, // 0x52 RET
+    };
+    for (uint16_t i = 0; i < sizeof(program); i++) rom.write(i, program[i]);
+    for (uint16_t vector = 0x08; vector <= 0x38; vector += 8) rom.write(vector, 0xC9); // RET
+    for (uint16_t i = 0; i < sizeof(code); i++) rom.write(0x40 + i, code[i]);
+    for (uint16_t i = 0; i < sizeof(subroutine); i++) rom.write(0x50 + i, subroutine[i]);
+    rom.write(0x60, 0x06); // MVI B, never reached
+
+    const Recompiler recompiler(rom, 0x80);
+    const std::set<uint16_t> expected = {
+        0x00, 0x08, 0x10, 0x18, 0x20, 0x28, 0x30, 0x38, // reset and RST vectors
+        0x40, 0x50, // jump and call targets
+        0x45, 0x48, 0x52, // after a CALL, a conditional jump, and an interpreted OUT
+    };
+    REQUIRE(recompiler.blocks() == expected);
+    REQUIRE(recompiler.isCode(0x48));
+    REQUIRE_FALSE(recompiler.isCode(0x41)); // operand
+    REQUIRE_FALSE(recompiler.isCode(0x60));
+
+    std::ostringstream source;
+    recompiler.emit(source, "rom");
+    REQUIRE(source.str().find("blocks[0x0040] = block_0040;") != std::string::npos);
+    REQUIRE(source.str().find("block_0050") == std::string::npos); // starts with OUT, left to the interpreter
+}
+
+TEST_CASE("Recompiled DAA adjusts BCD sums") {
+    // a + b in BCD: the sum and the carry out of the second digit, as the interpreter's test has them
+    const struct { uint8_t a, b, sum; bool carry; } sums[] = {
+        {0x09, 0x08, 0x17, false},
+        {0x38, 0x45, 0x83, false},
+        {0x50, 0x60, 0x10, true},
+        {0x99, 0x01, 0x00, true},
+        {0x99, 0x99, 0x98, true},
+        {0x12, 0x34, 0x46, false},
+    };
+    for (const auto& [a, b, sum, carry] : sums) {
+        CAPTURE(a, b);
+        Registers regs;
+        regs.A = a + b; // ADI b
+        regs.setFlagsADD(a + b, a, b);
+        recompiled::daa(regs);
+        REQUIRE(regs.A == sum);
+        REQUIRE(regs.getCarry() == carry);
+    }
+}
+
+TEST_CASE("Recompiled invaders boot runs like the interpreter") {
+    Cpu recompiled, reference;
+    REQUIRE(recompiled.loadRom(ROM_PATH) == 0);
+    REQUIRE(reference.loadRom(ROM_PATH) == 0);
+
+    const uint64_t cycles = 250'000 + recompiled.runRecompiled(recompiledInvaders, 250'000);
+    REQUIRE(recompiled.getCycles() == cycles);
+    reference.runUntil([&] { return reference.getCycles() >= cycles; }); // one instruction at a time, counting them
+    requireSameState(recompiled, reference);
+}
@@ -3,6 +3,8 @@
 #include <catch2/generators/catch_generators_adapters.hpp>
 #include <catch2/generators/catch_generators_random.hpp>
 
+#include <bit>
+
 #include "state.hpp"
 
 TEST_CASE_METHOD(Registers, "Registers") {
@@ -72,4 +74,88 @@ TEST_CASE_METHOD(Registers, "Registers") {
             REQUIRE(expected_value == this->readHL());
         }
     }
+
+    SECTION("Flags") {
+        uint8_t a = GENERATE(take(4, random(0, 0xFF)));
+        uint8_t b = GENERATE(take(4, random(0, 0xFF)));
+
+        SECTION("setFlagsADD") {
+            uint16_t result = a + b;
+            this->setFlagsADD(result, a, b);
+            REQUIRE(this->getZero() == ((uint8_t)result == 0));
+            REQUIRE(this->getSign() == ((uint8_t)result >> 7));
+            REQUIRE(this->getParity() == (std::popcount((uint8_t)result) % 2 == 0));
+            REQUIRE(this->getCarry() == (result > 0xFF));
+            REQUIRE(this->getAuxCarry() == ((a & 0x0F) + (b & 0x0F) > 0x0F));
+        }
+
+        SECTION("setFlagsSUB") {
+            uint16_t result = a - b;
+            this->setFlagsSUB(result, a, b);
+            REQUIRE(this->getZero() == (a == b));
+            REQUIRE(this->getSign() == ((uint8_t)result >> 7));
+            REQUIRE(this->getParity() == (std::popcount((uint8_t)result) % 2 == 0));
+            REQUIRE(this->getCarry() == (a < b));
+            REQUIRE(this->getAuxCarry() == ((a & 0x0F) < (b & 0x0F)));
+        }
+    }
+
+    SECTION("Flag tables match the flag definitions") {
+        // every operand pair, with and without carry going in
+        int mismatches = 0;
+        for (int a = 0; a <= 0xFF; a++) {
+            for (int b = 0; b <= 0xFF; b++) {
+                for (int carry = 0; carry <= 1; carry++) {
+                    uint16_t sum = a + b + carry;
+                    this->setFlagsADD(sum, a, b);
+                    uint8_t expected = ((uint8_t)sum == 0) << 6 | ((uint8_t)sum >> 7) << 7
+                                     | (std::popcount((uint8_t)sum) % 2 == 0) << 2 | (sum > 0xFF)
+                                     | ((a & 0x0F) + (b & 0x0F) + carry > 0x0F) << 4;
+                    mismatches += this->getF() != expected;
+
+                    uint16_t difference = a - b - carry;
+                    this->setFlagsSUB(difference, a, b);
+                    expected = ((uint8_t)difference == 0) << 6 | ((uint8_t)difference >> 7) << 7
+                             | (std::popcount((uint8_t)difference) % 2 == 0) << 2 | (a < b + carry)
+                             | ((a & 0x0F) < (b & 0x0F) + carry) << 4;
+                    mismatches += this->getF() != expected;
+                }
+            }
+        }
+        REQUIRE(mismatches == 0);
+    }
+
+    SECTION("setFlags keeps aux carry") {
+        this->setFlagsADD(0x0F + 0x01, 0x0F, 0x01);
+        this->setFlags(0x00, 1, 1, 1, 0);
+        REQUIRE(this->getAuxCarry() == 1);
+        REQUIRE(this->getZero() == 1);
+        REQUIRE(this->getCarry() == 0);
+    }
+
+    SECTION("Disabled flags keep their value") {
+        this->setCarry();
+        this->setFlagsADD(0xFF + 1, 0xFF, 1, KEEP_CARRY); // INR
+        REQUIRE(this->getCarry() == 1);
+        REQUIRE(this->getZero() == 1);
+        REQUIRE(this->getAuxCarry() == 1);
+    }
+
+    SECTION("setFlagsLogic") {
+        this->setFlagsADD(0xFF + 0xFF, 0xFF, 0xFF);
+        this->setFlagsLogic(0b10000001, 1);
+        REQUIRE(this->getF() == 0b10010100); // sign, aux carry, parity, carry unset
+        this->setFlagsLogic(0, 0);
+        REQUIRE(this->getF() == 0b01000100); // zero, parity
+    }
+
+    SECTION("getF") {
+        this->setFlagsSUB(0x00 - 0x01, 0x00, 0x01);
+        REQUIRE(this->getF() == 0b10010101); // sign, aux carry, parity, carry
+        this->clearCarry();
+        REQUIRE(this->getF() == 0b10010100);
+        this->setF(0b01000000);
+        REQUIRE(this->getZero() == 1);
+        REQUIRE(this->getSign() == 0);
+    }
 }
@@ -0,0 +1,139 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cpu.hpp"
+#include "replay.hpp"
+
+namespace {
+    // Stores what port 1 reads to 0x2000-0x3FFF in a loop, and counts the RST 1 interrupts in B
+    const std::vector<uint8_t> PROGRAM = {
+        0xC3, 0x40, 0x00,   // 0x00 JMP 0x40
+        0, 0, 0, 0, 0,
+        0x04,               // 0x08 INR B
+        0xFB,               //      EI
+        0xC9,               //      RET
+    };
+    const std::vector<uint8_t> MAIN = {
+        0x31, 0x00, 0xFF,   // 0x40 LXI SP,0xFF00
+        0x21, 0x00, 0x20,   //      LXI H,0x2000
+        0xFB,               //      EI
+        0xDB, 0x01,         // 0x47 IN 1
+        0x77,               //      MOV M,A
+        0x23,               //      INX H
+        0x7C,               //      MOV A,H
+        0xE6, 0x3F,         //      ANI 0x3F
+        0xF6, 0x20,         //      ORI 0x20
+        0x67,               //      MOV H,A
+        0xC3, 0x47, 0x00,   //      JMP 0x47
+    };
+
+    constexpr uint64_t CYCLES_PER_FRAME = 2'000;
+    constexpr int FRAMES = 50;
+
+    void boot(Cpu& cpu) {
+        cpu.getMemory().load(PROGRAM.data(), PROGRAM.size());
+        cpu.getMemory().load(MAIN.data(), MAIN.size(), 0x40);
+    }
+
+    uint8_t randomByte(void* context, uint8_t) {
+        return (*static_cast<std::mt19937*>(context))();
+    }
+}
+
+TEST_CASE("Input replay") {
+    Cpu live;
+    boot(live);
+    Cpu replayed = live;
+    std::mt19937 random(8080);
+    live.getPorts().attach(1, Ports::Input{randomByte, &random});
+
+    // A frame is half a frame of cycles, an interrupt, the other half and the end of frame check
+    std::vector<uint8_t> log;
+    {
+        SaveWriter out(log);
+        InputRecorder recorder(out, live);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            live.run(CYCLES_PER_FRAME / 2);
+            recorder.interrupt(1);
+            live.run(CYCLES_PER_FRAME / 2);
+            recorder.frame();
+        }
+    }
+    REQUIRE(live.getPorts().input(1).read == randomByte); // attached again when the recording ended
+    REQUIRE(CpuTestWrapper::getRegs(live).B == FRAMES);
+
+    SECTION("reproduces the run") {
+        SaveReader in(log.data(), log.size());
+        InputReplay replay(in, replayed);
+        REQUIRE(replay.run() == FRAMES);
+        REQUIRE(replayed.getCycles() == live.getCycles());
+        REQUIRE(replayed.stateHash() == live.stateHash());
+        REQUIRE(CpuTestWrapper::getRegs(replayed).B == FRAMES);
+        REQUIRE(replayed.getPorts().input(1).read == Ports().input(1).read); // unattached again
+    }
+
+    SECTION("detects a changed input") {
+        // The last PORT event before the first frame, its value is the byte before the next event
+        size_t value = 0;
+        for (size_t i = sizeof(replay::MAGIC) + 2 + 8; log[i] != static_cast<uint8_t>(replay::Kind::FRAME); ) {
+            const auto kind = static_cast<replay::Kind>(log[i++]);
+            while (log[i++] & 0x80) {}
+            if (kind == replay::Kind::PORT) {
+                value = i + 1;
+            }
+            i += kind == replay::Kind::PORT ? 2 : 1;
+        }
+        REQUIRE(value != 0);
+        log[value] ^= 0x01;
+        SaveReader in(log.data(), log.size());
+        InputReplay replay(in, replayed);
+        REQUIRE(replay.run() == -1);
+    }
+
+    SECTION("rejects a log from another start") {
+        replayed.run(1); // the JMP at 0
+        SaveReader in(log.data(), log.size());
+        InputReplay replay(in, replayed);
+        REQUIRE(replay.run() == -1);
+    }
+
+    SECTION("rejects a truncated log") {
+        SaveReader in(log.data(), log.size() / 2);
+        InputReplay replay(in, replayed);
+        REQUIRE(replay.run() == -1);
+    }
+}
+
+TEST_CASE("Input replay does not depend on how the recording sliced its runs") {
+    Cpu live;
+    boot(live);
+    Cpu replayed = live;
+    std::mt19937 random(8080);
+    live.getPorts().attach(1, Ports::Input{randomByte, &random});
+
+    // Runs of a few instructions, where the replay runs from one interrupt or frame to the next in one go
+    auto runTo = [&](uint64_t cycle) {
+        while (live.getCycles() < cycle) {
+            live.run(std::min<uint64_t>(37, cycle - live.getCycles()));
+        }
+    };
+    std::vector<uint8_t> log;
+    {
+        SaveWriter out(log);
+        InputRecorder recorder(out, live);
+        for (int frame = 0; frame < FRAMES; frame++) {
+            runTo(live.getCycles() + CYCLES_PER_FRAME / 2);
+            recorder.interrupt(1);
+            runTo(live.getCycles() + CYCLES_PER_FRAME / 2);
+            recorder.frame();
+        }
+    }
+
+    SaveReader in(log.data(), log.size());
+    InputReplay replay(in, replayed);
+    REQUIRE(replay.run() == FRAMES);
+    REQUIRE(replayed.getCycles() == live.getCycles());
+    REQUIRE(replayed.stateHash() == live.stateHash());
+}
@@ -0,0 +1,95 @@
+#include <catch2/catch_test_macros.hpp>
+#include <random>
+
+#include "invaders.hpp"
+#include "pacer.hpp"
+#include "rewind.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("Rewind") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+
+    // The boot frame by frame, keeping a copy of every state to compare with
+    constexpr size_t FRAMES = 8;
+    Rewind rewind(cpu, 6);
+    std::vector<Cpu> states = {cpu};
+    for (size_t frame = 0; frame < FRAMES; frame++) {
+        cpu.run(Pacer::CYCLES_PER_FRAME);
+        rewind.record();
+        states.push_back(cpu);
+    }
+    REQUIRE(rewind.available() == 6);
+    REQUIRE(rewind.used() > 0);
+
+    SECTION("one frame at a time") {
+        for (size_t back = 1; back <= 6; back++) {
+            REQUIRE(rewind.rewind(1));
+            requireSameState(cpu, states[FRAMES - back]);
+        }
+        REQUIRE_FALSE(rewind.rewind(1));
+    }
+
+    SECTION("several frames, from the middle of one") {
+        cpu.run(1'000);
+        cpu.getMemory().write(invaders::MIRROR + invaders::RAM + 5, 0xEE); // through a mirror
+        REQUIRE_FALSE(rewind.rewind(7));
+        REQUIRE(rewind.rewind(4));
+        requireSameState(cpu, states[FRAMES - 4]);
+        REQUIRE(rewind.available() == 2);
+
+        // Recording goes on from the rewound state
+        cpu.run(Pacer::CYCLES_PER_FRAME);
+        rewind.record();
+        REQUIRE(rewind.rewind(1));
+        requireSameState(cpu, states[FRAMES - 4]);
+    }
+
+    SECTION("a small ring keeps fewer frames") {
+        // Every way the frames can wrap around rings that hold a few of them
+        for (size_t bytes : {1500, 5000}) {
+            for (size_t recorded = 1; recorded <= 28; recorded++) {
+                CAPTURE(bytes, recorded);
+                Cpu other;
+                invaders::map(other.getMemory(), rom);
+                Rewind small(other, 60, bytes);
+                std::vector<Cpu> kept = {other};
+                for (size_t frame = 0; frame < recorded; frame++) {
+                    other.run(Pacer::CYCLES_PER_FRAME);
+                    small.record();
+                    kept.push_back(other);
+                    REQUIRE(small.used() <= bytes);
+                }
+                REQUIRE(small.available() <= recorded);
+                const size_t back = small.available();
+                REQUIRE(small.rewind(back));
+                requireSameState(other, kept[recorded - back]);
+            }
+        }
+    }
+
+    SECTION("frames of every size wrap around the ring") {
+        // A big frame that does not fit after the newest one while old small ones are still left at the end
+        for (uint32_t seed = 1; seed <= 40; seed++) {
+            CAPTURE(seed);
+            Cpu other;
+            std::mt19937 random(seed);
+            Rewind small(other, 60, 1500);
+            std::vector<Cpu> kept = {other};
+            for (size_t frame = 0; frame < 40; frame++) {
+                const uint16_t address = 0x2000 + random() % 0x1000;
+                for (uint32_t length = random() % 700; length > 0; length--) {
+                    other.getMemory().write(address + length, random());
+                }
+                other.run(4);
+                small.record();
+                kept.push_back(other);
+            }
+            const size_t back = small.available();
+            REQUIRE(small.rewind(back));
+            requireSameState(other, kept[kept.size() - 1 - back]);
+        }
+    }
+}
@@ -0,0 +1,86 @@
+#include <catch2/catch_test_macros.hpp>
+#include <fstream>
+#include <sstream>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "romImage.hpp"
+
+TEST_CASE("ROM image") {
+    std::ifstream file(ROM_PATH, std::ios::binary);
+    const std::string expected((std::istreambuf_iterator<char>(file)), std::istreambuf_iterator<char>());
+
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    REQUIRE(rom.size() == expected.size());
+    REQUIRE(std::string(reinterpret_cast<const char*>(rom.data()), rom.size()) == expected);
+#if defined(__unix__)
+    REQUIRE(rom.mapped());
+#endif
+
+    SECTION("every way of loading agrees") {
+        Cpu fromImage, fromPath, fromStream;
+        std::istringstream stream(expected);
+        REQUIRE(fromImage.loadRom(rom) == 0);
+        REQUIRE(fromPath.loadRom(ROM_PATH) == 0);
+        REQUIRE(fromStream.loadRom(stream) == 0);
+
+        Memory& image = CpuTestWrapper::getMemory(fromImage);
+        for (uint32_t address = 0; address < 0x10000; address++) {
+            CAPTURE(address);
+            const uint8_t byte = address < expected.size() ? expected[address] : 0;
+            REQUIRE(image.read(address) == byte);
+            REQUIRE(CpuTestWrapper::getMemory(fromPath).read(address) == byte);
+            REQUIRE(CpuTestWrapper::getMemory(fromStream).read(address) == byte);
+        }
+    }
+
+    SECTION("missing file") {
+        REQUIRE(rom.open(ROM_PATH ".missing") == -1);
+        REQUIRE(rom.data() == nullptr);
+        REQUIRE(rom.size() == 0);
+        Cpu cpu;
+        REQUIRE(cpu.loadRom(ROM_PATH ".missing") == -1);
+    }
+}
+
+TEST_CASE("Memory bulk load") {
+    Memory memory;
+    const uint8_t bytes[] = {1, 2, 3, 4};
+    memory.watchCode(0x1200);
+
+    memory.load(bytes, sizeof(bytes), 0x11FE); // straddles into the watched page
+    REQUIRE(memory.read16(0x11FE) == 0x0201);
+    REQUIRE(memory.read16(0x1200) == 0x0403);
+    REQUIRE(memory.codeWrites() == std::vector<uint8_t>{0x12});
+
+    memory.load(bytes, sizeof(bytes), 0xFFFE); // cut off at the top
+    REQUIRE(memory.read16(0xFFFE) == 0x0201);
+    REQUIRE(memory.read(0x0000) == 0);
+}
+
+TEST_CASE("Invaders memory map") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu flat, mapped;
+    REQUIRE(flat.loadRom(rom) == 0);
+    invaders::map(mapped.getMemory(), rom);
+
+    Memory& memory = mapped.getMemory();
+    REQUIRE(memory.read(0x0000) == rom.data()[0]);
+    REQUIRE(memory.read(invaders::MIRROR + 0x10) == rom.data()[0x10]);
+    memory.write(0x0000, ~rom.data()[0]);
+    REQUIRE(memory.read(0x0000) == rom.data()[0]);
+    memory.write(invaders::VRAM, 0x81);
+    REQUIRE(memory.read(invaders::VRAM + 3 * invaders::MIRROR) == 0x81);
+    memory.write(invaders::VRAM, 0);
+
+    // The boot never leaves RAM, so the map changes nothing
+    flat.run(200'000);
+    mapped.run(200'000);
+    REQUIRE(CpuTestWrapper::getRegs(flat).PC == CpuTestWrapper::getRegs(mapped).PC);
+    REQUIRE(flat.getCycles() == mapped.getCycles());
+    for (uint32_t address = invaders::RAM; address < invaders::VRAM + invaders::VRAM_SIZE; address++) {
+        REQUIRE(flat.getMemory().read(address) == memory.read(address));
+    }
+}
@@ -0,0 +1,30 @@
+#pragma once
+
+#include <catch2/catch_test_macros.hpp>
+
+#include "cpu.hpp"
+
+// Registers, interrupt state, cycles and the 64 KiB of memory of actual against expected. The memory is only compared
+// byte by byte when the hashes differ, a different memory map can hash differently with the same bytes.
+inline void requireSameState(const Cpu& actualCpu, const Cpu& expectedCpu) {
+    Cpu& actual = const_cast<Cpu&>(actualCpu); // reading the flags resolves lazy ones
+    Cpu& expected = const_cast<Cpu&>(expectedCpu);
+    Registers& a = CpuTestWrapper::getRegs(actual);
+    Registers& e = CpuTestWrapper::getRegs(expected);
+    REQUIRE(a.PC == e.PC);
+    REQUIRE(a.SP == e.SP);
+    REQUIRE(a.A == e.A);
+    REQUIRE(a.getF() == e.getF());
+    REQUIRE(a.readBC() == e.readBC());
+    REQUIRE(a.readDE() == e.readDE());
+    REQUIRE(a.readHL() == e.readHL());
+    REQUIRE(a.interruptState() == e.interruptState());
+    REQUIRE(actual.getCycles() == expected.getCycles());
+    if (actual.getMemory().hash() != expected.getMemory().hash()) {
+        for (uint32_t address = 0; address <= 0xFFFF; address++) {
+            if (actual.getMemory().read(address) != expected.getMemory().read(address)) {
+                FAIL("memory differs at " << address);
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <cstring>
+#include <random>
+#include <sstream>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "sameState.hpp"
+#include "savestate.hpp"
+
+TEST_CASE("Savestate page encoding") {
+    std::mt19937 random(GENERATE(1, 2, 3));
+    uint8_t base[Memory::PAGE_SIZE], page[Memory::PAGE_SIZE];
+    for (uint8_t& byte : base) {
+        byte = random();
+    }
+    std::memcpy(page, base, sizeof(page));
+
+    const int changes = GENERATE(0, 1, 7, 64, 256);
+    for (int i = 0; i < changes; i++) {
+        page[random() % sizeof(page)] ^= 1 + random() % 0xFF;
+    }
+
+    uint8_t encoded[savestate::MAX_ENCODED];
+    const size_t length = savestate::encode(page, base, encoded);
+    REQUIRE(length <= savestate::MAX_ENCODED);
+    if (changes == 0) {
+        REQUIRE(length == 2); // two runs of 128
+    }
+
+    uint8_t decoded[Memory::PAGE_SIZE];
+    std::memcpy(decoded, base, sizeof(decoded));
+    REQUIRE(savestate::decode(encoded, length, decoded));
+    REQUIRE(std::memcmp(decoded, page, sizeof(page)) == 0);
+
+    REQUIRE_FALSE(savestate::decode(encoded, length - 1, decoded)); // too short to cover the page
+}
+
+TEST_CASE("Savestates") {
+    Cpu cpu;
+    REQUIRE(cpu.loadRom(ROM_PATH) == 0);
+    cpu.run(100'000);
+
+    SECTION("full, in memory") {
+        std::vector<uint8_t> buffer;
+        SaveWriter out(buffer);
+        cpu.save(out);
+        REQUIRE(out.size() == buffer.size());
+
+        Cpu loaded;
+        loaded.getMemory().write(0x9000, 1); // gets cleared
+        SaveReader in(buffer.data(), buffer.size());
+        REQUIRE(loaded.load(in) == 0);
+        requireSameState(loaded, cpu);
+
+        // and it runs the same way
+        cpu.run(50'000);
+        loaded.run(50'000);
+        requireSameState(loaded, cpu);
+    }
+
+    SECTION("delta, through a stream") {
+        auto base = cpu.snapshot();
+        Cpu other = cpu;
+        auto otherBase = std::make_shared<const Cpu::Snapshot>(*base);
+        cpu.run(30'000);
+
+        std::stringstream stream;
+        SaveWriter out(stream);
+        cpu.save(out, base.get());
+        std::vector<uint8_t> full;
+        SaveWriter fullOut(full);
+        cpu.save(fullOut);
+        REQUIRE(out.size() < full.size() / 4);
+
+        // Any Cpu holding the same base can load it
+        other.run(1'000);
+        SaveReader in(stream);
+        REQUIRE(other.load(in, otherBase) == 0);
+        requireSameState(other, cpu);
+    }
+
+    SECTION("errors") {
+        std::vector<uint8_t> buffer;
+        SaveWriter out(buffer);
+        auto base = cpu.snapshot();
+        cpu.run(1'000);
+        cpu.save(out, base.get());
+
+        Cpu other;
+        SaveReader noBase(buffer.data(), buffer.size());
+        REQUIRE(other.load(noBase) == -1);
+
+        auto wrongBase = std::make_shared<const Cpu::Snapshot>(Cpu::Snapshot{Registers(), Memory(), 1});
+        SaveReader wrong(buffer.data(), buffer.size());
+        REQUIRE(other.load(wrong, wrongBase) == -1);
+
+        SaveReader truncated(buffer.data(), buffer.size() - 1);
+        REQUIRE(other.load(truncated, base) == -1);
+
+        buffer[0] = 'X';
+        SaveReader magic(buffer.data(), buffer.size());
+        REQUIRE(other.load(magic, base) == -1);
+    }
+}
+
+TEST_CASE("Savestates leave shared ROM out") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    cpu.run(100'000);
+
+    std::vector<uint8_t> buffer;
+    SaveWriter out(buffer);
+    cpu.save(out);
+    REQUIRE(buffer.size() < invaders::RAM_SIZE + invaders::VRAM_SIZE);
+
+    Cpu loaded;
+    invaders::map(loaded.getMemory(), rom);
+    SaveReader in(buffer.data(), buffer.size());
+    REQUIRE(loaded.load(in) == 0);
+    requireSameState(loaded, cpu);
+
+    // Writes through a mirror end up in the delta too
+    auto base = cpu.snapshot();
+    cpu.getMemory().write(invaders::MIRROR + invaders::RAM, 0x5A);
+    cpu.run(20'000);
+    std::vector<uint8_t> delta;
+    SaveWriter deltaOut(delta);
+    cpu.save(deltaOut, base.get());
+    loaded.snapshot();
+    SaveReader deltaIn(delta.data(), delta.size());
+    REQUIRE(loaded.load(deltaIn, base) == 0);
+    requireSameState(loaded, cpu);
+}
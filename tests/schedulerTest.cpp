@@ -0,0 +1,230 @@
+#include <catch2/catch_test_macros.hpp>
+#include <catch2/generators/catch_generators.hpp>
+#include <map>
+#include <random>
+#include <vector>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+
+namespace {
+    // Logs the events it fires as (event, cycle the Cpu was at)
+    struct Log {
+        std::vector<std::pair<uint32_t, uint64_t>> fired;
+        uint64_t period = 0; // 0 fires once
+        std::vector<Scheduler::Event> ids;
+
+        static uint64_t callback(void* context, Cpu& cpu, uint64_t cycle) {
+            Log& log = *static_cast<Log*>(context);
+            log.fired.push_back({uint32_t(log.fired.size()), cpu.getCycles()});
+            REQUIRE(cpu.getCycles() >= cycle);
+            return log.period ? cycle + log.period : Scheduler::NEVER;
+        }
+    };
+
+    uint64_t record(void* context, Cpu&, uint64_t cycle) {
+        static_cast<std::vector<uint64_t>*>(context)->push_back(cycle);
+        return Scheduler::NEVER;
+    }
+}
+
+TEST_CASE("Scheduler") {
+    Scheduler scheduler;
+    std::vector<uint64_t> fired;
+    Cpu cpu;
+
+    SECTION("fires in deadline order, ties in the order the events were added") {
+        std::vector<Scheduler::Event> events;
+        for (int i = 0; i < 5; i++) {
+            events.push_back(scheduler.add(record, &fired));
+        }
+        scheduler.schedule(events[0], 50);
+        scheduler.schedule(events[1], 10);
+        scheduler.schedule(events[2], 30);
+        scheduler.schedule(events[3], 30);
+        scheduler.schedule(events[4], 70);
+        REQUIRE(scheduler.next() == 10);
+
+        scheduler.schedule(events[4], 20); // moved up
+        scheduler.schedule(events[1], 60); // moved down
+        scheduler.cancel(events[0]);
+        REQUIRE_FALSE(scheduler.scheduled(events[0]));
+        scheduler.run(cpu, 59);
+        REQUIRE(fired == std::vector<uint64_t>{20, 30, 30});
+        REQUIRE(scheduler.next() == 60);
+    }
+
+    SECTION("agrees with a sorted map under random changes") {
+        std::mt19937 random(GENERATE(1, 2, 3));
+        std::vector<Scheduler::Event> events;
+        for (int i = 0; i < 64; i++) {
+            events.push_back(scheduler.add(record, &fired));
+        }
+        std::map<Scheduler::Event, uint64_t> expected;
+        for (int step = 0; step < 2000; step++) {
+            const Scheduler::Event event = events[random() % events.size()];
+            if (random() % 4 == 0) {
+                scheduler.cancel(event);
+                expected.erase(event);
+            } else {
+                const uint64_t cycle = random() % 1000;
+                scheduler.schedule(event, cycle);
+                expected[event] = cycle;
+            }
+
+            uint64_t earliest = Scheduler::NEVER;
+            for (const auto& [id, cycle] : expected) {
+                earliest = std::min(earliest, cycle);
+                REQUIRE(scheduler.deadline(id) == cycle);
+            }
+            REQUIRE(scheduler.next() == earliest);
+        }
+
+        // Saved and set again they fire the same
+        const std::vector<uint64_t> deadlines = scheduler.deadlines();
+        std::vector<uint64_t> buffer(3 * events.size(), 7);
+        scheduler.deadlines(buffer);
+        REQUIRE(buffer == deadlines);
+        Scheduler copy;
+        for (size_t i = 0; i < events.size(); i++) {
+            copy.add(record, &fired);
+        }
+        copy.setDeadlines(deadlines);
+        REQUIRE(copy.next() == scheduler.next());
+        scheduler.run(cpu, 1000);
+        const std::vector<uint64_t> order = fired;
+        fired.clear();
+        copy.run(cpu, 1000);
+        REQUIRE(fired == order);
+        REQUIRE(std::is_sorted(order.begin(), order.end()));
+        REQUIRE(order.size() == expected.size());
+    }
+}
+
+TEST_CASE("Events in Cpu::run") {
+    Cpu cpu; // all NOPs, 4 cycles each
+    Log log;
+    Scheduler::Event event = cpu.getScheduler().add(Log::callback, &log);
+
+    SECTION("fire at the first instruction boundary from their deadline") {
+        cpu.getScheduler().schedule(event, 101);
+        cpu.run(100);
+        REQUIRE(log.fired.empty());
+        cpu.run(100);
+        REQUIRE(log.fired.size() == 1);
+        REQUIRE(log.fired[0].second == 104);
+    }
+
+    SECTION("periodic events rescheduled from their deadline keep their rate") {
+        log.period = 1000;
+        cpu.getScheduler().schedule(event, 1000);
+        cpu.run(10'001);
+        REQUIRE(log.fired.size() == 10);
+        REQUIRE(log.fired.back().second == 10'000);
+    }
+
+    SECTION("are part of snapshots") {
+        cpu.getScheduler().schedule(event, 500);
+        auto start = cpu.snapshot();
+        cpu.run(1000);
+        REQUIRE(log.fired.size() == 1);
+        cpu.restore(start);
+        REQUIRE(cpu.getScheduler().deadline(event) == 500);
+        cpu.run(1000);
+        REQUIRE(log.fired.size() == 2);
+    }
+
+    SECTION("fire in runUntil and trace at the same boundaries as in run") {
+        cpu.getScheduler().schedule(event, 101);
+        cpu.runUntil([&] { return !log.fired.empty(); });
+        REQUIRE(log.fired[0].second == 104);
+        REQUIRE(cpu.getCycles() == 104);
+
+        cpu.getScheduler().schedule(event, 201);
+        cpu.trace(200, [](uint16_t, uint8_t) {});
+        REQUIRE(log.fired.size() == 2);
+        REQUIRE(log.fired[1].second == 204);
+    }
+}
+
+TEST_CASE("Interrupts") {
+    Cpu cpu;
+    const uint8_t program[] = {
+        0x31, 0x00, 0x30,   // 0x00 LXI SP,0x3000
+        0xFB,               //      EI
+        0x76,               // 0x04 HLT
+        0x3C,               //      INR A
+        0xC3, 0x04, 0x00,   //      JMP 0x04
+        0x00, 0x00, 0x00, 0x00, 0x00, 0x00, 0x00,
+        0x04,               // 0x10 INR B, RST 2
+        0xFB,               //      EI
+        0xC9,               //      RET
+    };
+    cpu.getMemory().load(program, sizeof(program));
+    Registers& regs = CpuTestWrapper::getRegs(cpu);
+
+    cpu.run(4);
+    REQUIRE_FALSE(cpu.interrupt(2)); // before EI
+    cpu.run(10);
+    REQUIRE(regs.halted);
+    REQUIRE(regs.PC == 0x04);
+    cpu.run(100); // still waiting
+    REQUIRE(regs.PC == 0x04);
+
+    REQUIRE(cpu.interrupt(2));
+    REQUIRE_FALSE(regs.halted);
+    REQUIRE_FALSE(regs.interruptsEnabled);
+    REQUIRE(regs.PC == 0x10);
+    REQUIRE(cpu.getMemory().read16(regs.SP) == 0x05); // returns past the HLT
+    REQUIRE_FALSE(cpu.interrupt(2)); // disabled until the handler enables them
+
+    cpu.run(5 + 4 + 10 + 5 + 10 + 7); // the handler, INR A, JMP, then HLT again
+    REQUIRE(regs.B == 1);
+    REQUIRE(regs.A == 1);
+    REQUIRE(regs.halted);
+
+    SECTION("DI") {
+        const uint8_t di = 0xF3;
+        cpu.getMemory().load(&di, 1, 0x05);
+        REQUIRE(cpu.interrupt(2));
+        cpu.run(30);
+        REQUIRE_FALSE(regs.interruptsEnabled);
+        REQUIRE_FALSE(cpu.interrupt(2));
+    }
+
+    SECTION("RST") {
+        const uint8_t rst = 0xD7; // RST 2
+        cpu.getMemory().load(&rst, 1, 0x05);
+        regs.interruptsEnabled = false;
+        regs.halted = false;
+        regs.PC = 0x05;
+        cpu.run(1);
+        REQUIRE(regs.PC == 0x10);
+        REQUIRE(cpu.getMemory().read16(regs.SP) == 0x06);
+    }
+}
+
+TEST_CASE("Invaders screen interrupts") {
+    REQUIRE(invaders::Screen::next(0) == invaders::Screen::MIDDLE);
+    REQUIRE(invaders::Screen::next(invaders::Screen::MIDDLE) == Pacer::CYCLES_PER_FRAME);
+    REQUIRE(invaders::Screen::next(Pacer::CYCLES_PER_FRAME) == Pacer::CYCLES_PER_FRAME + invaders::Screen::MIDDLE);
+
+    // The attract mode runs on the interrupts and draws to VRAM
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    for (int frame = 0; frame < 120; frame++) {
+        cpu.run(Pacer::CYCLES_PER_FRAME);
+    }
+    REQUIRE(cpu.getScheduler().scheduled(screen.getEvent()));
+    REQUIRE(cpu.getScheduler().deadline(screen.getEvent()) > cpu.getCycles());
+    uint32_t lit = 0;
+    for (uint32_t address = invaders::VRAM; address < invaders::VRAM + invaders::VRAM_SIZE; address++) {
+        lit += std::popcount(cpu.getMemory().read(address));
+    }
+    REQUIRE(lit > 0);
+}
@@ -0,0 +1,118 @@
+#include <catch2/catch_test_macros.hpp>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "sameState.hpp"
+
+TEST_CASE("Dirty pages") {
+    Memory memory;
+    REQUIRE(memory.dirtyPages().empty());
+    memory.write(0x2000, 1);
+    memory.write(0x20FF, 2);
+    memory.write(0xFF00, 3);
+    REQUIRE(memory.dirtyPages() == std::vector<uint8_t>{0x20, 0xFF});
+    REQUIRE(memory.dirty(0x20));
+    REQUIRE_FALSE(memory.dirty(0x21));
+
+    const Memory snapshot;
+    memory.restore(snapshot);
+    REQUIRE(memory.dirtyPages().empty());
+    REQUIRE(memory.read(0x20FF) == 0);
+    REQUIRE(memory.read(0xFF00) == 0);
+}
+
+TEST_CASE("Snapshots") {
+    Cpu boot;
+    REQUIRE(boot.loadRom(ROM_PATH) == 0);
+    boot.run(50'000);
+
+    Cpu cpu = boot;
+    auto start = cpu.snapshot();
+    cpu.run(100'000);
+
+    // Only the stack and the variables the boot wrote are dirty
+    const std::vector<uint8_t> written = cpu.getMemory().dirtyPages();
+    REQUIRE_FALSE(written.empty());
+    REQUIRE(written.size() < 0x20);
+
+    SECTION("restore") {
+        Cpu later = cpu;
+        cpu.restore(start);
+        REQUIRE(cpu.getMemory().dirtyPages().empty());
+        requireSameState(cpu, boot);
+
+        // and it runs the same way again
+        cpu.run(100'000);
+        requireSameState(cpu, later);
+    }
+
+    SECTION("reset goes back to the last snapshot") {
+        auto middle = cpu.snapshot();
+        Cpu expected = cpu;
+        cpu.run(20'000);
+        cpu.reset();
+        requireSameState(cpu, expected);
+
+        cpu.restore(start); // not the reset point, copies every page
+        requireSameState(cpu, boot);
+        cpu.restore(middle);
+        requireSameState(cpu, expected);
+    }
+
+    SECTION("copies reset to the snapshot too") {
+        cpu.getMemory().write(0x2300, 0x11);
+        cpu.snapshot();
+        cpu.getMemory().write(0x2300, 0x22);
+
+        Cpu copy = cpu;
+        copy.reset();
+        REQUIRE(copy.getMemory().read(0x2300) == 0x11);
+        Cpu assigned;
+        assigned = cpu;
+        assigned.reset();
+        REQUIRE(assigned.getMemory().read(0x2300) == 0x11);
+        cpu.reset();
+        REQUIRE(cpu.getMemory().read(0x2300) == 0x11);
+    }
+
+    SECTION("reset without a snapshot") {
+        Cpu fresh;
+        Cpu loaded;
+        REQUIRE(loaded.loadRom(ROM_PATH) == 0);
+        loaded.run(10'000);
+        loaded.reset();
+        requireSameState(loaded, fresh);
+    }
+
+    SECTION("restored code is translated again") {
+        Cpu program;
+        const uint8_t code[] = {0x3E, 0x01, 0x32, 0x00, 0x01, 0xC3, 0x00, 0x00}; // MVI A,1; STA 0x0100; JMP 0
+        program.getMemory().load(code, sizeof(code));
+        auto original = program.snapshot();
+        program.decodeBlock();
+
+        const uint8_t patched = 0x02; // MVI A,2
+        program.getMemory().write(0x0001, patched);
+        program.decodeBlock();
+        REQUIRE(program.getMemory().read(0x0100) == 2);
+
+        program.restore(original);
+        program.decodeBlock();
+        REQUIRE(program.getMemory().read(0x0100) == 1);
+    }
+}
+
+TEST_CASE("Snapshots keep shared ROM shared") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    auto start = cpu.snapshot();
+    cpu.run(100'000);
+    for (uint8_t page : cpu.getMemory().dirtyPages()) {
+        REQUIRE(page >= invaders::RAM >> 8);
+    }
+    cpu.reset();
+    REQUIRE(cpu.getCycles() == 0);
+    REQUIRE(cpu.getMemory().read(0) == rom.data()[0]);
+}
@@ -0,0 +1,156 @@
+#include <catch2/catch_test_macros.hpp>
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "video.hpp"
+
+TEST_CASE("Video geometry and overlay") {
+    const Video video(video::OVERLAY, video::Isa::SCALAR);
+    std::vector<uint8_t> vram(invaders::VRAM_SIZE);
+    std::vector<uint32_t> image(video::WIDTH * video::HEIGHT);
+    auto pixel = [&](uint32_t x, uint32_t y) { return image[y * video::WIDTH + x]; };
+
+    // Bit 0 of the first byte is the bottom left corner, the last bit of the last byte the top right one
+    vram.front() = 0b00000001;
+    vram.back() = 0b10000000;
+    // Line 20 in the green strip over the lives
+    vram[20 * video::LINE] = 0b00000001;
+    // The second line 1 pixel from the bottom
+    vram[video::LINE] = 0b00000010;
+    // Bytes 4 to 7 of every line cover rows 192 to 223, in the green band
+    vram[10 * video::LINE + 4] = 0b00000001; // row 223
+    // Byte 25 of line 0 is rows 48 to 55, in the red band
+    vram[25] = 0b00010000; // row 51
+    video.rgba(vram.data(), image.data());
+
+    REQUIRE(pixel(0, video::HEIGHT - 1) == video::WHITE); // left of the strip
+    REQUIRE(pixel(20, video::HEIGHT - 1) == video::rgba(0x20, 0xFF, 0x20));
+    REQUIRE(pixel(video::WIDTH - 1, 0) == video::WHITE);
+    REQUIRE(pixel(1, video::HEIGHT - 2) == video::WHITE);
+    REQUIRE(pixel(10, 223) == video::rgba(0x20, 0xFF, 0x20));
+    REQUIRE(pixel(0, 51) == video::rgba(0xFF, 0x20, 0x20));
+    REQUIRE(pixel(1, 0) == video::BLACK);
+    uint32_t lit = 0;
+    for (const uint32_t color : image) {
+        lit += color != video::BLACK;
+    }
+    REQUIRE(lit == 6);
+
+    // Right of it too
+    std::fill(vram.begin(), vram.end(), 0);
+    vram[200 * video::LINE] = 1;
+    video.rgba(vram.data(), image.data());
+    REQUIRE(pixel(200, video::HEIGHT - 1) == video::WHITE);
+
+    std::vector<uint8_t> gray(video::WIDTH * video::HEIGHT);
+    video.gray(vram.data(), gray.data());
+    REQUIRE(gray[(video::HEIGHT - 1) * video::WIDTH + 200] == 0xFF);
+    REQUIRE(gray[(video::HEIGHT - 1) * video::WIDTH + 199] == 0);
+}
+
+TEST_CASE("Video kernels agree with the scalar one") {
+    const Video reference(video::OVERLAY, video::Isa::SCALAR);
+    std::mt19937 random(1);
+    std::vector<uint8_t> vram(invaders::VRAM_SIZE);
+    for (video::Isa isa : {video::Isa::SSE, video::Isa::AVX2}) {
+        if (!Video::available(isa)) {
+            continue;
+        }
+        const Video simd(video::OVERLAY, isa);
+        REQUIRE(simd.getIsa() == isa);
+
+        for (int pattern = 0; pattern < 4; pattern++) {
+            CAPTURE(int(isa), pattern);
+            for (uint8_t& byte : vram) {
+                byte = pattern == 0 ? 0xFF : pattern == 1 ? 0 : random();
+            }
+            std::vector<uint32_t> expected(video::WIDTH * video::HEIGHT), image(expected.size());
+            reference.rgba(vram.data(), expected.data());
+            simd.rgba(vram.data(), image.data());
+            REQUIRE(image == expected);
+
+            std::vector<uint8_t> expectedGray(expected.size()), gray(expected.size());
+            reference.gray(vram.data(), expectedGray.data());
+            simd.gray(vram.data(), gray.data());
+            REQUIRE(gray == expectedGray);
+        }
+    }
+}
+
+TEST_CASE("Video from the invaders memory") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    cpu.run(120 * Pacer::CYCLES_PER_FRAME);
+
+    // In place, and through the mirror the same as a copy
+    std::vector<uint8_t> vram(invaders::VRAM_SIZE);
+    for (uint32_t i = 0; i < invaders::VRAM_SIZE; i++) {
+        vram[i] = cpu.getMemory().read(invaders::VRAM + i);
+    }
+    const Video video;
+    std::vector<uint32_t> expected(video::WIDTH * video::HEIGHT), image(expected.size());
+    video.rgba(vram.data(), expected.data());
+    video.rgba(cpu.getMemory(), image.data());
+    REQUIRE(image == expected);
+
+    Memory mirrored;
+    mirrored.mirror(invaders::VRAM, invaders::VRAM_SIZE, invaders::VRAM + invaders::MIRROR);
+    mirrored.load(vram.data(), vram.size(), invaders::VRAM + invaders::MIRROR);
+    video.rgba(mirrored, image.data());
+    REQUIRE(image == expected);
+}
+
+TEST_CASE("Video updates the written columns only") {
+    RomImage rom;
+    REQUIRE(rom.open(ROM_PATH) == 0);
+    Cpu cpu;
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    Video::watch(cpu.getMemory());
+
+    const Video video;
+    std::vector<uint32_t> image(video::WIDTH * video::HEIGHT), expected(image.size()), before(image.size());
+    std::vector<uint8_t> gray(image.size()), expectedGray(image.size());
+    REQUIRE(video.update(cpu.getMemory(), image.data()) == std::vector<video::Rect>{{0, 0, video::WIDTH, video::HEIGHT}});
+    REQUIRE(video.update(cpu.getMemory(), image.data()).empty());
+    Video::watch(cpu.getMemory()); // again, marks every line
+    video.update(cpu.getMemory(), gray.data());
+    video.gray(cpu.getMemory(), expectedGray.data());
+    REQUIRE(gray == expectedGray);
+
+    uint32_t partial = 0;
+    for (int frame = 0; frame < 300; frame++) {
+        cpu.run(Pacer::CYCLES_PER_FRAME);
+        before = image;
+        const std::vector<video::Rect> rects = video.update(cpu.getMemory(), image.data());
+        video.rgba(cpu.getMemory(), expected.data());
+        REQUIRE(image == expected);
+
+        // Nothing changed outside the rectangles
+        std::vector<bool> inside(video::WIDTH);
+        for (const video::Rect& rect : rects) {
+            REQUIRE(rect.y == 0);
+            REQUIRE(rect.height == video::HEIGHT);
+            for (uint32_t x = rect.x; x < rect.x + rect.width; x++) {
+                inside[x] = true;
+            }
+        }
+        for (uint32_t i = 0; i < image.size(); i++) {
+            if (!inside[i % video::WIDTH]) {
+                REQUIRE(image[i] == before[i]);
+            }
+        }
+        partial += std::count(inside.begin(), inside.end(), true) < video::WIDTH;
+    }
+    REQUIRE(partial > 0);
+}
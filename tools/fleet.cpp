@@ -0,0 +1,71 @@
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "fleet.hpp"
+#include "invaders.hpp"
+
+// Runs many copies of a ROM side by side, as fast as the cores allow
+int main(int argc, char* argv[]) {
+    const char* path = "../assets/invaders";
+    size_t instances = 0;
+    unsigned workers = std::max(1u, std::thread::hardware_concurrency()); // 0 when it is not known
+    uint64_t frames = 600; // ten seconds of the attract mode
+    bool pin = true;
+    bool perInstance = false;
+
+    for (int i = 1; i < argc; i++) {
+        auto number = [&](uint64_t& value) {
+            if (i + 1 >= argc) {
+                return false;
+            }
+            char* end;
+            value = std::strtoull(argv[++i], &end, 10);
+            return *end == '\0';
+        };
+        uint64_t value = 0;
+        if (std::strcmp(argv[i], "--instances") == 0 && number(value)) {
+            instances = value;
+        } else if (std::strcmp(argv[i], "--workers") == 0 && number(value) && value > 0) {
+            workers = value;
+        } else if (std::strcmp(argv[i], "--frames") == 0 && number(value)) {
+            frames = value;
+        } else if (std::strcmp(argv[i], "--no-pin") == 0) {
+            pin = false;
+        } else if (std::strcmp(argv[i], "--progress") == 0) {
+            perInstance = true;
+        } else if (argv[i][0] != '-') {
+            path = argv[i];
+        } else {
+            std::cerr << "Usage: " << argv[0] << " [rom] [--instances N] [--workers N] [--frames N] [--no-pin] [--progress]\n";
+            return 1;
+        }
+    }
+    if (instances == 0) {
+        instances = 4 * workers; // enough slices in flight to keep every worker busy
+    }
+
+    // Every instance reads the ROM pages of the one mapping
+    RomImage rom;
+    if (rom.open(path) != 0) {
+        return 1;
+    }
+    Cpu boot;
+    invaders::map(boot.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(boot.getPorts());
+    invaders::Screen screen(boot); // keeps no state, the copies share it
+    Fleet fleet(boot, instances);
+    // but every instance shifts on a Shifter of its own, the workers run them at the same time
+    std::vector<invaders::Shifter> shifters(instances, shifter);
+    for (size_t i = 0; i < instances; i++) {
+        fleet.instance(i).getPorts().rebind(&shifter, &shifters[i]);
+    }
+    fleet.run(frames, workers, pin);
+    std::cout << workers << " workers, " << frames << " frames each\n";
+    fleet.report(std::cout, perInstance);
+    return 0;
+}
@@ -0,0 +1,37 @@
+#include <cstdlib>
+#include <iostream>
+
+#include "cpu.hpp"
+#include "invaders.hpp"
+#include "miner.hpp"
+
+// Runs the invaders ROM with its devices and prints the opcode sequences worth a superinstruction, in the format of src/superinstructions.inc
+int main(int argc, char* argv[]) {
+    if (argc < 2 || argc > 5) {
+        std::cerr << "Usage: " << argv[0] << " <rom> [cycles] [count] [minimum]\n";
+        return 1;
+    }
+    const uint64_t cycles = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 60 * Pacer::CYCLES_PER_FRAME; // a second of the attract mode
+    const size_t count = argc > 3 ? std::strtoul(argv[3], nullptr, 10) : 16;
+    const uint64_t minimum = argc > 4 ? std::strtoull(argv[4], nullptr, 10) : 100; // sequences rarer than this are not worth a handler
+
+    Cpu cpu;
+    RomImage rom;
+    if (rom.open(argv[1]) != 0) {
+        return 1;
+    }
+    invaders::map(cpu.getMemory(), rom);
+    invaders::Shifter shifter;
+    shifter.attach(cpu.getPorts());
+    invaders::Screen screen(cpu);
+    SequenceMiner miner;
+    cpu.trace(cycles, [&](uint16_t, uint8_t opcode) { miner.record(opcode); });
+
+    std::cout << "// Mined from " << cycles << " cycles of " << argv[1] << " by tools/mine, regenerate with:\n// mine";
+    for (int i = 1; i < argc; i++) {
+        std::cout << ' ' << argv[i];
+    }
+    std::cout << " > src/superinstructions.inc\n";
+    SequenceMiner::write(std::cout, miner.candidates(count, minimum));
+    return 0;
+}
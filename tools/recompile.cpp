@@ -0,0 +1,34 @@
+#include <fstream>
+#include <iostream>
+
+#include "recompiler.hpp"
+
+// Writes the ROM out as C++ for the static recompiler runtime, see recompiled.hpp
+int main(int argc, char* argv[]) {
+    if (argc != 4) {
+        std::cerr << "Usage: " << argv[0] << " <rom> <output.cpp> <symbol>\n";
+        return 1;
+    }
+
+    std::ifstream file(argv[1], std::ios::binary);
+    if (!file) {
+        std::cerr << "Failed to read rom " << argv[1] << '\n';
+        return 1;
+    }
+    Memory rom;
+    uint32_t size = 0;
+    char byte;
+    while (size < 0x10000 && file.get(byte)) {
+        rom.write(size++, byte);
+    }
+
+    const Recompiler recompiler(rom, size);
+    std::ofstream out(argv[2]);
+    recompiler.emit(out, argv[3]);
+    if (!out) {
+        std::cerr << "Failed to write " << argv[2] << '\n';
+        return 1;
+    }
+    std::cout << recompiler.blocks().size() << " blocks recompiled from " << argv[1] << '\n';
+    return 0;
+}